@@ -0,0 +1,21 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+// Minimal benchmark runner. Each benchmark body is run repeatedly and the
+// best time of all runs is reported.
+
+namespace bench {
+
+typedef std::function<void()> BenchFunc;
+
+int add(const std::string& name, BenchFunc func);
+void runAll();
+
+} // bench
+
+#define BENCHMARK(name)                                                  \
+    static void name();                                                  \
+    static const int name##_registered = bench::add(#name, name);        \
+    static void name()
@@ -0,0 +1,93 @@
+#include "bench.h"
+
+#include <cstdlib>
+
+#include "../src/parser.h"
+#include "../src/evaluator.h"
+
+static const int n_elements = 100000;
+
+// Env holding ints and floats, arrays of n_elements numbers, and the
+// recursive toy-lang versions of the builtins and array operators
+static EnvPtr setup() {
+    std::vector<Value> ints;
+    std::vector<Value> floats;
+
+    for (int i = 0; i < n_elements; i++) {
+        ints.push_back(Value(i % 1000));
+        floats.push_back(Value(i * 0.5));
+    }
+
+    EnvPtr env = makeRef<Env>();
+    env->set("ints", makeObject<Array>(ints));
+    env->set("floats", makeObject<Array>(floats));
+
+    Lexer lexer(
+        "let sumOf = func(arr, i, acc) { if (i == len(arr)) { acc } else { sumOf(arr, i + 1, acc + arr[i]) } };"
+        "let maxOf = func(arr, i, acc) { if (i == len(arr)) { acc } else { maxOf(arr, i + 1, if (arr[i] > acc) { arr[i] } else { acc }) } };"
+        "let dotOf = func(a, b, i, acc) { if (i == len(a)) { acc } else { dotOf(a, b, i + 1, acc + a[i] * b[i]) } };"
+        "let addOf = func(a, b, i, acc) { if (i == len(a)) { acc } else { addOf(a, b, i + 1, push(acc, a[i] + b[i])) } };"
+        "let scaleOf = func(a, x, i, acc) { if (i == len(a)) { acc } else { scaleOf(a, x, i + 1, push(acc, a[i] * x)) } };"
+    );
+    Parser parser(lexer);
+    evaluator::eval(parser.parseProgram(), env);
+
+    return env;
+}
+
+static void run(const std::string& input) {
+    static EnvPtr env = setup();
+    Lexer lexer(input);
+    Parser parser(lexer);
+
+    if (evaluator::isError(evaluator::eval(parser.parseProgram(), env)))
+        std::abort();
+}
+
+BENCHMARK(SumIntsBuiltin100k) {
+    run("sum(ints)");
+}
+
+BENCHMARK(SumIntsRecursive100k) {
+    run("sumOf(ints, 0, 0)");
+}
+
+BENCHMARK(SumFloatsBuiltin100k) {
+    run("sum(floats)");
+}
+
+BENCHMARK(SumFloatsRecursive100k) {
+    run("sumOf(floats, 0, 0.0)");
+}
+
+BENCHMARK(MaxIntsBuiltin100k) {
+    run("max(ints)");
+}
+
+BENCHMARK(MaxIntsRecursive100k) {
+    run("maxOf(ints, 0, 0)");
+}
+
+BENCHMARK(DotFloatsBuiltin100k) {
+    run("dot(floats, floats)");
+}
+
+BENCHMARK(DotFloatsRecursive100k) {
+    run("dotOf(floats, floats, 0, 0.0)");
+}
+
+BENCHMARK(AddIntArrays100k) {
+    run("ints + ints");
+}
+
+BENCHMARK(AddIntArraysRecursive100k) {
+    run("addOf(ints, ints, 0, [])");
+}
+
+BENCHMARK(ScaleFloatArray100k) {
+    run("floats * 1.5");
+}
+
+BENCHMARK(ScaleFloatArrayRecursive100k) {
+    run("scaleOf(floats, 1.5, 0, [])");
+}
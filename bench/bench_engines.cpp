@@ -0,0 +1,123 @@
+#include "bench.h"
+
+#include "../src/parser.h"
+#include "../src/evaluator.h"
+#include "../src/jit.h"
+#include "../src/machine.h"
+#include "../src/optimizer.h"
+#include "../src/thunk.h"
+#include "../src/vm.h"
+
+static const std::string fib_src = "let fib = func(n) { if (n < 2) { n } else { fib(n-1) + fib(n-2) } }; fib(22)";
+
+static const std::string constants_src =
+    "let seconds = func(days) { let day = 60 * 60 * 24; days * day + len(\"id\" + \"-\" + \"x\") }; "
+    "let loop = func(n, acc) { if (n == 0) { acc } else { loop(n - 1, acc + seconds(n)) } }; loop(20000, 0)";
+
+static const std::string helpers_src =
+    "let add = func(a, b) { a + b }; let scale = func(x, k) { x * k - 1 }; "
+    "let loop = func(n, acc) { if (n == 0) { acc } else { loop(n - 1, add(scale(acc, 3), n) / 2) } }; loop(50000, 0)";
+
+static std::shared_ptr<Program> parse(const std::string& input) {
+    Lexer lexer(input);
+    Parser parser(lexer);
+
+    return parser.parseProgram();
+}
+
+BENCHMARK(FibEvaluator) {
+    auto program = parse(fib_src);
+    EnvPtr env = makeRef<Env>();
+
+    jit::setThreshold(0);
+    evaluator::eval(program, env);
+    jit::setThreshold(DEFAULT_JIT_THRESHOLD);
+}
+
+BENCHMARK(FibJit) {
+    auto program = parse(fib_src);
+    EnvPtr env = makeRef<Env>();
+
+    evaluator::eval(program, env);
+}
+
+BENCHMARK(FibVM) {
+    Compiler compiler;
+    compiler.compile(parse(fib_src));
+
+    VM vm;
+    vm.run(compiler.bytecode());
+}
+
+BENCHMARK(FibMachine) {
+    auto program = parse(fib_src);
+    EnvPtr env = makeRef<Env>();
+    Machine machine;
+
+    machine.run(program, env);
+}
+
+BENCHMARK(FibThunk) {
+    auto program = parse(fib_src);
+    EnvPtr env = makeRef<Env>();
+
+    jit::setThreshold(0);
+    thunk::eval(program, env);
+    jit::setThreshold(DEFAULT_JIT_THRESHOLD);
+}
+
+BENCHMARK(FibMemo) {
+    auto program = parse("let fib = memo(func(n) { if (n < 2) { n } else { fib(n-1) + fib(n-2) } }); fib(22)");
+    EnvPtr env = makeRef<Env>();
+
+    jit::setThreshold(0);
+    evaluator::eval(program, env);
+    jit::setThreshold(DEFAULT_JIT_THRESHOLD);
+}
+
+BENCHMARK(ArrayPush100k) {
+    auto program = parse("let build = func(arr, n) { if (n == 0) { arr } else { build(push(arr, n), n - 1) } }; len(build([], 100000))");
+    EnvPtr env = makeRef<Env>();
+
+    evaluator::eval(program, env);
+}
+
+BENCHMARK(ConstantsEvaluator) {
+    auto program = parse(constants_src);
+    EnvPtr env = makeRef<Env>();
+
+    jit::setThreshold(0);
+    evaluator::eval(program, env);
+    jit::setThreshold(DEFAULT_JIT_THRESHOLD);
+}
+
+BENCHMARK(ConstantsOptimized) {
+    auto program = parse(constants_src);
+    EnvPtr env = makeRef<Env>();
+    Optimizer optimizer;
+    optimizer.optimize(program);
+
+    jit::setThreshold(0);
+    evaluator::eval(program, env);
+    jit::setThreshold(DEFAULT_JIT_THRESHOLD);
+}
+
+BENCHMARK(HelpersEvaluator) {
+    auto program = parse(helpers_src);
+    EnvPtr env = makeRef<Env>();
+
+    jit::setThreshold(0);
+    evaluator::eval(program, env);
+    jit::setThreshold(DEFAULT_JIT_THRESHOLD);
+}
+
+BENCHMARK(HelpersInlined) {
+    auto program = parse(helpers_src);
+    EnvPtr env = makeRef<Env>();
+    Optimizer optimizer;
+    optimizer.optimize(program);
+
+    jit::setThreshold(0);
+    evaluator::eval(program, env);
+    jit::setThreshold(DEFAULT_JIT_THRESHOLD);
+}
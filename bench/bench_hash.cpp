@@ -0,0 +1,66 @@
+#include "bench.h"
+
+#include <cstdlib>
+
+#include "../src/object.h"
+
+static const int n_keys = 1000000;
+
+static std::vector<Value> intKeys() {
+    std::vector<Value> keys;
+
+    for (int i = 0; i < n_keys; i++)
+        keys.push_back(Value(i * 7));
+
+    return keys;
+}
+
+static std::vector<Value> stringKeys() {
+    std::vector<Value> keys;
+
+    for (int i = 0; i < n_keys; i++)
+        keys.push_back(makeObject<String>("key_" + std::to_string(i)));
+
+    return keys;
+}
+
+static HashTable build(const std::vector<Value>& keys) {
+    HashTable table;
+
+    for (const auto& key : keys)
+        table.set(key.hashKey(), key, key);
+
+    return table;
+}
+
+static void lookup(const HashTable& table, const std::vector<Value>& keys) {
+    size_t n_found = 0;
+
+    for (const auto& key : keys)
+        n_found += table.get(key.hashKey(), key) != nullptr;
+
+    if (n_found != keys.size())
+        std::abort();
+}
+
+BENCHMARK(HashInsertInts1M) {
+    static const auto keys = intKeys();
+    build(keys);
+}
+
+BENCHMARK(HashLookupInts1M) {
+    static const auto keys = intKeys();
+    static const auto table = build(keys);
+    lookup(table, keys);
+}
+
+BENCHMARK(HashInsertStrings1M) {
+    static const auto keys = stringKeys();
+    build(keys);
+}
+
+BENCHMARK(HashLookupStrings1M) {
+    static const auto keys = stringKeys();
+    static const auto table = build(keys);
+    lookup(table, keys);
+}
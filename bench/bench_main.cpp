@@ -0,0 +1,53 @@
+#include "bench.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace bench {
+
+struct Benchmark {
+    std::string name;
+    BenchFunc func;
+};
+
+static std::vector<Benchmark>& benchmarks() {
+    static std::vector<Benchmark> registered;
+    return registered;
+}
+
+int add(const std::string& name, BenchFunc func) {
+    benchmarks().push_back({name, func});
+
+    return static_cast<int>(benchmarks().size());
+}
+
+void runAll() {
+    const int n_runs = 5;
+
+    for (const auto& benchmark : benchmarks()) {
+        double best_ms = -1;
+
+        for (int i = 0; i < n_runs; i++) {
+            const auto start = std::chrono::steady_clock::now();
+            benchmark.func();
+            const auto end = std::chrono::steady_clock::now();
+
+            const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if (best_ms < 0 || ms < best_ms)
+                best_ms = ms;
+        }
+
+        std::cout << std::left << std::setw(40) << benchmark.name
+                  << std::right << std::setw(12) << std::fixed << std::setprecision(3) << best_ms << " ms\n";
+    }
+}
+
+} // bench
+
+int main() {
+    bench::runAll();
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "bench.h"
+
+#include "../src/parser.h"
+
+// About 3 MB of functions, lets, calls, arrays and hashes
+static std::string generateScript() {
+    std::string src;
+
+    for (int i = 0; i < 10000; i++) {
+        const std::string n = std::to_string(i);
+
+        src += "let function_number_" + n + " = func(first_argument, second_argument) {\n";
+        src += "    let local = [first_argument, second_argument * " + n + ", \"a string literal\"];\n";
+        src += "    if (first_argument < second_argument) { return local[0] + -" + n + "; } else { {\"key\": local[1]}[\"key\"] }\n";
+        src += "};\n";
+        src += "function_number_" + n + "(" + n + ", 2.5 * 4);\n";
+    }
+
+    return src;
+}
+
+static const std::string large_src = generateScript();
+
+static std::string generateIdentifiers() {
+    std::string src;
+
+    for (int i = 0; i < 100000; i++)
+        src += "some_identifier if_not then else_where returning function let_it_be x y z ";
+
+    return src;
+}
+
+static const std::string ident_src = generateIdentifiers();
+
+BENCHMARK(ParseLargeScript) {
+    Lexer lexer(large_src);
+    Parser parser(lexer);
+
+    parser.parseProgram();
+}
+
+BENCHMARK(LexLargeScript) {
+    Lexer lexer(large_src);
+
+    while (lexer.nextToken().type != TOK_EOF) {
+    }
+}
+
+BENCHMARK(LexIdentifiers) {
+    Lexer lexer(ident_src);
+
+    while (lexer.nextToken().type != TOK_EOF) {
+    }
+}
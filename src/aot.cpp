@@ -0,0 +1,615 @@
+#include "aot.h"
+#include "builtin.h"
+#include "evaluator.h"
+#include "heap.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+using namespace evaluator;
+
+// Value for bits whose reference stays with the caller
+class Borrowed {
+    Value m_value;
+
+public:
+    explicit Borrowed(uint64_t bits) : m_value(Value::adoptBits(bits)) {}
+    Borrowed(const Borrowed&) = delete;
+    Borrowed& operator= (const Borrowed&) = delete;
+    ~Borrowed() { m_value.releaseBits(); }
+
+    const Value& operator* () const { return m_value; }
+    const Value* operator-> () const { return &m_value; }
+};
+
+// What modules call back into, in the order of AOT_RUNTIME_FUNCS
+namespace rt {
+
+static void retain(uint64_t value) {
+    Value copy = *Borrowed(value);
+    copy.releaseBits();
+}
+
+static void release(uint64_t value) {
+    Value::adoptBits(value);
+}
+
+static int type(uint64_t value) {
+    return Borrowed(value)->getType();
+}
+
+static bool truthy(uint64_t value) {
+    return isTrue(*Borrowed(value));
+}
+
+static void collect() {
+    gc::maybeCollect();
+}
+
+static uint64_t string(const char* chars, size_t size) {
+    return makeObject<String>(std::string(chars, size)).releaseBits();
+}
+
+static uint64_t prefix(int oprtr, uint64_t right) {
+    return evalPrefixExpr(oprtr, *Borrowed(right)).releaseBits();
+}
+
+static uint64_t infix(int oprtr, uint64_t left, uint64_t right) {
+    return evalInfixExpr(oprtr, *Borrowed(left), *Borrowed(right)).releaseBits();
+}
+
+// Mirrors evaluator::evalIdentifier
+static uint64_t identifier(void* env_in, int depth, int slot, bool is_last_use, const char* name) {
+    Env* env = static_cast<Env*>(env_in);
+
+    if (depth >= 0) {
+        auto value = is_last_use ? env->takeAt(slot) : env->getAt(depth, slot);
+
+        if (value)
+            return value.releaseBits();
+    }
+
+    auto value = env->get(name);
+
+    if (value)
+        return value.releaseBits();
+
+    auto builtin = builtinObject(name);
+    if (builtin)
+        return builtin.releaseBits();
+
+    return makeObject<Error>(("identifier not found: " + std::string(name))).releaseBits();
+}
+
+static uint64_t letAt(void* env, int slot, uint64_t value) {
+    return static_cast<Env*>(env)->setAt(slot, *Borrowed(value)).releaseBits();
+}
+
+static uint64_t letName(void* env, const char* name, uint64_t value) {
+    return static_cast<Env*>(env)->set(name, *Borrowed(value)).releaseBits();
+}
+
+static uint64_t function(void* env, NativeBody body, const char* const* params, size_t n_params, int n_slots, const char* text) {
+    std::vector<Identifier> identifiers;
+
+    for (size_t i = 0; i < n_params; i++)
+        identifiers.emplace_back(Token(TOK_IDENT, params[i]), params[i]);
+
+    auto func = makeObject<Function>(identifiers, nullptr, nullptr, EnvPtr(static_cast<Env*>(env)), n_slots);
+    func.as<Function>()->native = body;
+    func.as<Function>()->native_text = text;
+
+    return func.releaseBits();
+}
+
+static uint64_t call(uint64_t func_bits, const uint64_t* arg_bits, size_t n_args, bool is_tail_call) {
+    Value func = *Borrowed(func_bits);
+    std::vector<Value> args;
+    args.reserve(n_args);
+
+    for (size_t i = 0; i < n_args; i++)
+        args.push_back(*Borrowed(arg_bits[i]));
+
+    if (is_tail_call && func->getType() == OBJ_FUNC)
+        return makeObject<TailCall>(func, args).releaseBits();
+
+    return applyFunction(std::move(func), std::move(args)).releaseBits();
+}
+
+static uint64_t makeReturn(uint64_t value) {
+    return makeObject<Return>(*Borrowed(value)).releaseBits();
+}
+
+static uint64_t returnValue(uint64_t value) {
+    return Borrowed(value)->getObjValue().releaseBits();
+}
+
+static uint64_t array(const uint64_t* element_bits, size_t n_elements) {
+    std::vector<Value> elements;
+    elements.reserve(n_elements);
+
+    for (size_t i = 0; i < n_elements; i++)
+        elements.push_back(*Borrowed(element_bits[i]));
+
+    return makeObject<Array>(elements).releaseBits();
+}
+
+static uint64_t hash() {
+    return makeObject<Hash>(HashTable()).releaseBits();
+}
+
+// Empty bits, or an error when key can't be one
+static uint64_t hashSet(uint64_t hash, uint64_t key_bits, uint64_t value) {
+    Borrowed key(key_bits);
+    auto hashed = key->hashKey();
+
+    if (hashed.type == OBJ_NIL)
+        return makeObject<Error>("unusable as hash key").releaseBits();
+
+    Borrowed(hash)->as<Hash>()->pairs.set(hashed, *key, *Borrowed(value));
+
+    return Value().releaseBits();
+}
+
+static uint64_t index(uint64_t left, uint64_t index) {
+    return evalIndexExpr(*Borrowed(left), *Borrowed(index)).releaseBits();
+}
+
+} // rt
+
+#define AOT_RUNTIME_ENTRY(ret, name, params) rt::name,
+
+static const AotRuntime runtime = {
+    AOT_RUNTIME_FUNCS(AOT_RUNTIME_ENTRY)
+};
+
+#define AOT_RUNTIME_FIELD_TEXT(ret, name, params) "    " #ret " (*" #name ") " #params ";\n"
+
+static std::string hex(uint64_t value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "0x%016llxULL", static_cast<unsigned long long>(value));
+
+    return buffer;
+}
+
+// Quoted C++ string literal of str
+static std::string cString(const std::string& str) {
+    std::string literal = "\"";
+
+    for (const char c : str) {
+        if (c == '"' || c == '\\') {
+            literal += '\\';
+            literal += c;
+        } else if (c == '\n') {
+            literal += "\\n";
+        } else if (c < ' ' || c > '~') {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\%03o", static_cast<unsigned char>(c));
+            literal += buffer;
+        } else {
+            literal += c;
+        }
+    }
+
+    return literal + "\"";
+}
+
+// Emits the C++ of a program. Every expression becomes a lambda called in
+// place, so it can return early on an error just like the evaluator does.
+class CppEmitter {
+    std::vector<std::string> m_declarations;
+    std::vector<std::string> m_definitions;
+
+    std::string block(const std::vector<Statement*>& statements);
+    std::string exprs(const std::vector<ExprPtr>& nodes, const std::string& finish);
+    std::string function(const ASTNodePtr& node);
+
+public:
+    std::string expr(const ASTNodePtr& node);
+    std::string program(const std::shared_ptr<Program>& program);
+};
+
+// Mirrors evaluator::evalBlock
+std::string CppEmitter::block(const std::vector<Statement*>& statements) {
+    if (statements.empty())
+        return "V::nil()";
+
+    std::string out = "[&]() -> V {\nV result;\n";
+
+    for (const auto& statement : statements)
+        out += "result = " + expr(statement) + ";\nrt->collect();\nif (stopsBlock(result))\nreturn result;\n";
+
+    return out + "return result;\n}()";
+}
+
+// Args or elements cut after the first error, like evaluator::evalExprs.
+// finish uses values and n_values.
+std::string CppEmitter::exprs(const std::vector<ExprPtr>& nodes, const std::string& finish) {
+    if (nodes.empty())
+        return "const V* values = nullptr;\nconst size_t n_values = 0;\n" + finish;
+
+    std::string out = "V values[" + std::to_string(nodes.size()) + "];\nsize_t n_values = 0;\ndo {\n";
+
+    for (const auto& node : nodes)
+        out += "values[n_values++] = " + expr(node) + ";\nif (values[n_values - 1].is(OBJ_ERROR))\nbreak;\n";
+
+    return out + "} while (false);\nif (n_values == 1 && values[0].is(OBJ_ERROR))\nreturn values[0];\n" + finish;
+}
+
+std::string CppEmitter::function(const ASTNodePtr& node) {
+    const std::string id = std::to_string(m_declarations.size());
+    const std::string name = "fn_" + id;
+    const auto& params = node->getParams();
+
+    m_declarations.push_back("static uint64_t " + name + "(void* env);\n");
+
+    std::string params_name = "nullptr";
+    if (!params.empty()) {
+        params_name = "params_" + id;
+
+        std::string list;
+        for (const auto& param : params)
+            list += (list.empty() ? "" : ", ") + cString(param.getIdentName());
+
+        m_declarations.push_back("static const char* const " + params_name + "[] = {" + list + "};\n");
+    }
+
+    m_declarations.push_back("static const char text_" + id + "[] = " + cString(node->getBody()->toString()) + ";\n");
+    m_definitions.push_back("static uint64_t " + name + "(void* env) {\nreturn " + block(node->getBody()->getStatements()) + ".take();\n}\n");
+
+    return "V(rt->function(env, " + name + ", " + params_name + ", " + std::to_string(params.size()) + ", " + std::to_string(node->getSlotCount()) + ", text_" + id + "))";
+}
+
+// Mirrors evaluator::eval
+std::string CppEmitter::expr(const ASTNodePtr& node) {
+    if (!node)
+        return "V::nil()";
+
+    switch (node->nodeType())
+    {
+    case NODE_EXPR_STMNT:
+        return expr(node->getExpr());
+    case NODE_IDENT:
+        return "V(rt->identifier(env, " + std::to_string(node->getDepth()) + ", " + std::to_string(node->getSlot()) + ", " +
+               (node->isLastUse() ? "true" : "false") + ", " + cString(node->getIdentName()) + "))";
+    case NODE_INT:
+        return "V::integer(" + std::to_string(node->getIntValue()) + ")";
+    case NODE_FLOAT:
+        return "V(" + hex(Value(node->getFloatValue()).bits()) + ")";
+    case NODE_STR: {
+        const std::string str = node->tokenLiteral();
+        return "V(rt->string(" + cString(str) + ", " + std::to_string(str.size()) + "))";
+    }
+    case NODE_BOOL:
+        return node->getBoolValue() ? "V::boolean(true)" : "V::boolean(false)";
+    case NODE_PREFIX:
+        return "[&]() -> V {\nV right = " + expr(node->getRight()) + ";\nif (right.is(OBJ_ERROR))\nreturn right;\n"
+               "return V(rt->prefix(" + std::to_string(node->getOprtr()) + ", right.get()));\n}()";
+    case NODE_INFIX:
+        return "[&]() -> V {\nV left = " + expr(node->getLeft()) + ";\nif (left.is(OBJ_ERROR))\nreturn left;\n"
+               "V right = " + expr(node->getRight()) + ";\nif (right.is(OBJ_ERROR))\nreturn right;\n"
+               "return infix(" + std::to_string(node->getOprtr()) + ", left, right);\n}()";
+    case NODE_BLOCK_STMNT:
+        return block(node->getStatements());
+    case NODE_IF_EXPR: {
+        auto alt = node->getAlternative();
+
+        return "[&]() -> V {\nV cond = " + expr(node->getCondition()) + ";\nif (cond.is(OBJ_ERROR))\nreturn cond;\n"
+               "if (truthy(cond))\nreturn " + expr(node->getConsequence()) + ";\n"
+               "return " + (alt ? expr(alt) : "V::nil()") + ";\n}()";
+    }
+    case NODE_RETURN_STMNT:
+        return "[&]() -> V {\nV value = " + expr(node->getExpr()) + ";\nif (value.is(OBJ_ERROR))\nreturn value;\n"
+               "return V(rt->makeReturn(value.get()));\n}()";
+    case NODE_LET_STMNT: {
+        const std::string let = node->getSlot() >= 0 ? "rt->letAt(env, " + std::to_string(node->getSlot())
+                                                      : "rt->letName(env, " + cString(node->getIdentName());
+
+        return "[&]() -> V {\nV value = " + expr(node->getExpr()) + ";\nif (value.is(OBJ_ERROR))\nreturn value;\n"
+               "return V(" + let + ", value.get()));\n}()";
+    }
+    case NODE_INLINED_CALL:
+        return expr(node->getCall());
+    case NODE_CALL_EXPR:
+        return "[&]() -> V {\nV func = " + expr(node->getFunc()) + ";\nif (func.is(OBJ_ERROR))\nreturn func;\n" +
+               exprs(node->getArgs(), "return V(rt->call(func.get(), bits(values), n_values, " +
+                                      std::string(node->isTailCall() ? "true" : "false") + "));\n") + "}()";
+    case NODE_FUNC:
+        return function(node);
+    case NODE_ARRAY:
+        return "[&]() -> V {\n" + exprs(node->getElements(), "return V(rt->array(bits(values), n_values));\n") + "}()";
+    case NODE_HASH: {
+        std::string out = "[&]() -> V {\nV hash(rt->hash());\n";
+
+        for (const auto& [key_node, value_node] : node->getPairs()) {
+            out += "{\nV key = " + expr(key_node) + ";\nif (key.is(OBJ_ERROR))\nreturn key;\n"
+                   "V value = " + expr(value_node) + ";\nif (value.is(OBJ_ERROR))\nreturn value;\n"
+                   "V error(rt->hashSet(hash.get(), key.get(), value.get()));\nif (!error.isEmpty())\nreturn error;\n}\n";
+        }
+
+        return out + "return hash;\n}()";
+    }
+    case NODE_INDEX:
+        return "[&]() -> V {\nV left = " + expr(node->getLeft()) + ";\nif (left.is(OBJ_ERROR))\nreturn left;\n"
+               "V index = " + expr(node->getIndex()) + ";\nif (index.is(OBJ_ERROR))\nreturn index;\n"
+               "return V(rt->index(left.get(), index.get()));\n}()";
+    default:
+        return "V::nil()";
+    }
+}
+
+// Mirrors evaluator::evalProgram
+std::string CppEmitter::program(const std::shared_ptr<Program>& program) {
+    std::string main = "extern \"C\" uint64_t toylang_main(const AotRuntime* runtime, void* env) {\nrt = runtime;\nV result;\n";
+
+    for (const auto& statement : program->getStatements()) {
+        main += "result = " + expr(statement) + ";\nrt->collect();\n"
+                "if (result.is(OBJ_RETURN))\nreturn rt->returnValue(result.get());\n"
+                "if (result.is(OBJ_ERROR))\nreturn result.take();\n";
+    }
+
+    main += "return result.take();\n}\n";
+
+    std::string out = "// Generated by toylang --emit-cpp\n#include \"toylang_runtime.h\"\n\n";
+
+    for (const auto& declaration : m_declarations)
+        out += declaration;
+    for (const auto& definition : m_definitions)
+        out += "\n" + definition;
+
+    return out + "\n" + main;
+}
+
+// FNV-1a
+static uint64_t hashOf(const std::string& str) {
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (const char c : str) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
+
+namespace aot {
+
+std::string emitCpp(const std::shared_ptr<Program>& program) {
+    CppEmitter emitter;
+
+    return emitter.program(program);
+}
+
+const std::string& runtimeHeader() {
+    static const std::string header =
+        "// Runtime of modules generated by toylang --emit-cpp, see src/aot.h\n"
+        "#pragma once\n\n"
+        "#include <cstddef>\n"
+        "#include <cstdint>\n\n"
+        "typedef uint64_t (*NativeBody)(void* env);\n\n"
+        "struct AotRuntime {\n"
+        AOT_RUNTIME_FUNCS(AOT_RUNTIME_FIELD_TEXT)
+        "};\n\n"
+        "const uint64_t TAG_MASK = " + hex(Value::TAG_MASK) + ";\n"
+        "const uint64_t TAG_EMPTY = " + hex(Value::TAG_EMPTY) + ";\n"
+        "const uint64_t TAG_NIL = " + hex(Value::TAG_NIL) + ";\n"
+        "const uint64_t TAG_BOOL = " + hex(Value::TAG_BOOL) + ";\n"
+        "const uint64_t TAG_INT = " + hex(Value::TAG_INT) + ";\n"
+        "const uint64_t TAG_OBJ = " + hex(Value::TAG_OBJ) + ";\n\n"
+        "const int OBJ_RETURN = " + std::to_string(OBJ_RETURN) + ";\n"
+        "const int OBJ_ERROR = " + std::to_string(OBJ_ERROR) + ";\n\n"
+        "const int OPRTR_ADD = " + std::to_string(OPRTR_ADD) + ";\n"
+        "const int OPRTR_SUB = " + std::to_string(OPRTR_SUB) + ";\n"
+        "const int OPRTR_MUL = " + std::to_string(OPRTR_MUL) + ";\n"
+        "const int OPRTR_LT = " + std::to_string(OPRTR_LT) + ";\n"
+        "const int OPRTR_GT = " + std::to_string(OPRTR_GT) + ";\n"
+        "const int OPRTR_EQ = " + std::to_string(OPRTR_EQ) + ";\n"
+        "const int OPRTR_NOT_EQ = " + std::to_string(OPRTR_NOT_EQ) + ";\n\n"
+        "static const AotRuntime* rt;\n\n"
+        "// Owned value\n"
+        "class V {\n"
+        "    uint64_t m_bits;\n\n"
+        "public:\n"
+        "    V() : m_bits(TAG_EMPTY) {}\n"
+        "    explicit V(uint64_t bits) : m_bits(bits) {} // takes over the bits\n"
+        "    V(const V& other) : m_bits(other.m_bits) { if (isObject()) rt->retain(m_bits); }\n"
+        "    V(V&& other) noexcept : m_bits(other.m_bits) { other.m_bits = TAG_EMPTY; }\n"
+        "    V& operator= (V other) noexcept { const uint64_t bits = m_bits; m_bits = other.m_bits; other.m_bits = bits; return *this; }\n"
+        "    ~V() { if (isObject()) rt->release(m_bits); }\n\n"
+        "    static V integer(int32_t value) { return V(TAG_INT | static_cast<uint32_t>(value)); }\n"
+        "    static V boolean(bool value) { return V(TAG_BOOL | (value ? 1 : 0)); }\n"
+        "    static V nil() { return V(TAG_NIL); }\n\n"
+        "    uint64_t get() const { return m_bits; }\n"
+        "    uint64_t take() { const uint64_t bits = m_bits; m_bits = TAG_EMPTY; return bits; }\n\n"
+        "    bool isEmpty() const { return m_bits == TAG_EMPTY; }\n"
+        "    bool isObject() const { return (m_bits & TAG_MASK) == TAG_OBJ; }\n"
+        "    bool isInt() const { return (m_bits & TAG_MASK) == TAG_INT; }\n"
+        "    bool is(int type) const { return isObject() && rt->type(m_bits) == type; }\n"
+        "};\n\n"
+        "static_assert(sizeof(V) == sizeof(uint64_t), \"arrays of V are passed as their bits\");\n\n"
+        "static inline const uint64_t* bits(const V* values) { return reinterpret_cast<const uint64_t*>(values); }\n\n"
+        "static inline bool stopsBlock(const V& result) {\n"
+        "    if (!result.isObject())\n"
+        "        return false;\n\n"
+        "    const int type = rt->type(result.get());\n"
+        "    return type == OBJ_RETURN || type == OBJ_ERROR;\n"
+        "}\n\n"
+        "static inline bool truthy(const V& value) {\n"
+        "    if ((value.get() & TAG_MASK) == TAG_BOOL)\n"
+        "        return (value.get() & 1) != 0;\n\n"
+        "    return rt->truthy(value.get());\n"
+        "}\n\n"
+        "// Ints wrap around like in the interpreter. Division and every other case go\n"
+        "// to the interpreter, which gives the errors, like division by zero.\n"
+        "static inline V infix(int oprtr, const V& left, const V& right) {\n"
+        "    if (left.isInt() && right.isInt()) {\n"
+        "        const uint32_t a = static_cast<uint32_t>(left.get());\n"
+        "        const uint32_t b = static_cast<uint32_t>(right.get());\n\n"
+        "        switch (oprtr)\n"
+        "        {\n"
+        "        case OPRTR_ADD: return V(TAG_INT | static_cast<uint32_t>(a + b));\n"
+        "        case OPRTR_SUB: return V(TAG_INT | static_cast<uint32_t>(a - b));\n"
+        "        case OPRTR_MUL: return V(TAG_INT | static_cast<uint32_t>(a * b));\n"
+        "        case OPRTR_LT: return V::boolean(static_cast<int32_t>(a) < static_cast<int32_t>(b));\n"
+        "        case OPRTR_GT: return V::boolean(static_cast<int32_t>(a) > static_cast<int32_t>(b));\n"
+        "        case OPRTR_EQ: return V::boolean(a == b);\n"
+        "        case OPRTR_NOT_EQ: return V::boolean(a != b);\n"
+        "        default: break;\n"
+        "        }\n"
+        "    }\n\n"
+        "    return V(rt->infix(oprtr, left.get(), right.get()));\n"
+        "}\n";
+
+    return header;
+}
+
+std::string defaultCacheDir() {
+    const char* dir = std::getenv("TOYLANG_CACHE_DIR");
+    if (dir && *dir)
+        return dir;
+
+    const char* home = std::getenv("HOME");
+    if (home && *home)
+        return std::string(home) + "/.cache/toylang";
+
+    return "";
+}
+
+// Why path isn't safe to load modules from, empty if it is: it must belong
+// to the current user and no one else may write to it, or another user
+// could plant a module there. A module itself must be a regular file, not
+// a link to one.
+static std::string notPrivate(const std::string& path, bool is_dir) {
+    struct stat info;
+    if ((is_dir ? stat(path.c_str(), &info) : lstat(path.c_str(), &info)) != 0)
+        return "can't stat " + path;
+
+    if (is_dir ? !S_ISDIR(info.st_mode) : !S_ISREG(info.st_mode))
+        return path + (is_dir ? " isn't a directory" : " isn't a regular file");
+    if (info.st_uid != getuid())
+        return path + " belongs to another user";
+    if (info.st_mode & (S_IWGRP | S_IWOTH))
+        return path + " can be written by other users";
+
+    return "";
+}
+
+ModuleCache::ModuleCache(const std::string& dir, const std::string& compiler)
+    : m_dir(dir), m_compiler(compiler) {
+    if (m_compiler.empty()) {
+        const char* cxx = std::getenv("CXX");
+        m_compiler = (cxx && *cxx) ? cxx : "c++";
+    }
+}
+
+// Builds in a directory of its own and renames the result into place, so
+// other processes never see a half written module
+bool ModuleCache::compile(const std::string& cpp_source, const std::string& command, const std::string& so_path) {
+    const fs::path build_dir = so_path + ".build" + std::to_string(getpid());
+    std::error_code error_code;
+
+    fs::create_directories(build_dir, error_code);
+    if (error_code) {
+        m_errors.push_back("can't create " + build_dir.string() + ": " + error_code.message());
+        return false;
+    }
+
+    std::ofstream(build_dir / "toylang_runtime.h") << runtimeHeader();
+    std::ofstream(build_dir / "module.cpp") << cpp_source;
+
+    const fs::path module = build_dir / "module.so";
+    const fs::path log = build_dir / "log";
+    const std::string full_command = command + " -o \"" + module.string() + "\" \"" + (build_dir / "module.cpp").string() + "\" > \"" + log.string() + "\" 2>&1";
+
+    const bool is_compiled = std::system(full_command.c_str()) == 0 && fs::exists(module);
+
+    if (is_compiled) {
+        fs::rename(module, so_path, error_code);
+        if (error_code)
+            m_errors.push_back("can't move module to " + so_path + ": " + error_code.message());
+    } else {
+        std::stringstream output;
+        output << std::ifstream(log).rdbuf();
+        m_errors.push_back("compiling failed: " + command + "\n" + output.str());
+    }
+
+    fs::remove_all(build_dir, error_code);
+
+    return is_compiled && fs::exists(so_path);
+}
+
+ModuleMain ModuleCache::load(const std::string& cpp_source) {
+    const std::string command = m_compiler + " -std=c++17 -O2 -shared -fPIC";
+    const uint64_t key = hashOf(command + "\n" + runtimeHeader() + cpp_source);
+
+    auto loaded = m_loaded.find(key);
+    if (loaded != m_loaded.end())
+        return loaded->second;
+
+    if (m_dir.empty()) {
+        m_errors.push_back("no private cache dir for modules, set HOME or TOYLANG_CACHE_DIR");
+        return nullptr;
+    }
+
+    std::error_code error_code;
+    const fs::path parent = fs::path(m_dir).parent_path();
+    if (!parent.empty())
+        fs::create_directories(parent, error_code);
+    if (error_code || (mkdir(m_dir.c_str(), 0700) != 0 && errno != EEXIST)) {
+        m_errors.push_back("can't create cache dir " + m_dir + ": " + (error_code ? error_code.message() : std::strerror(errno)));
+        return nullptr;
+    }
+
+    auto reason = notPrivate(m_dir, true);
+    if (!reason.empty()) {
+        m_errors.push_back("won't use cache dir: " + reason);
+        return nullptr;
+    }
+
+    const std::string so_path = (fs::path(m_dir) / (hex(key).substr(2, 16) + ".so")).string();
+
+    if (!fs::exists(so_path) && !compile(cpp_source, command, so_path))
+        return nullptr;
+
+    reason = notPrivate(so_path, false);
+    if (!reason.empty()) {
+        m_errors.push_back("won't load module: " + reason);
+        return nullptr;
+    }
+
+    void* handle = dlopen(so_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        m_errors.push_back(std::string("can't load module: ") + dlerror());
+        return nullptr;
+    }
+
+    auto main = reinterpret_cast<ModuleMain>(dlsym(handle, "toylang_main"));
+    if (!main) {
+        m_errors.push_back("no toylang_main in " + so_path);
+        return nullptr;
+    }
+
+    m_loaded[key] = main;
+
+    return main;
+}
+
+Value ModuleCache::run(const std::shared_ptr<Program>& program, EnvPtr env) {
+    auto main = load(emitCpp(program));
+    if (!main)
+        return nullptr;
+
+    return Value::adoptBits(main(&runtime, env.get()));
+}
+
+} // aot
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "env.h"
+#include "object.h"
+
+// Functions of the interpreter that native modules call, as
+// X(return type, name, params). Values go through as their raw bits: the
+// ones passed in are borrowed, the ones returned are owned by the caller.
+#define AOT_RUNTIME_FUNCS(X) \
+    X(void, retain, (uint64_t value)) \
+    X(void, release, (uint64_t value)) \
+    X(int, type, (uint64_t value)) \
+    X(bool, truthy, (uint64_t value)) \
+    X(void, collect, ()) \
+    X(uint64_t, string, (const char* chars, size_t size)) \
+    X(uint64_t, prefix, (int oprtr, uint64_t right)) \
+    X(uint64_t, infix, (int oprtr, uint64_t left, uint64_t right)) \
+    X(uint64_t, identifier, (void* env, int depth, int slot, bool is_last_use, const char* name)) \
+    X(uint64_t, letAt, (void* env, int slot, uint64_t value)) \
+    X(uint64_t, letName, (void* env, const char* name, uint64_t value)) \
+    X(uint64_t, function, (void* env, NativeBody body, const char* const* params, size_t n_params, int n_slots, const char* text)) \
+    X(uint64_t, call, (uint64_t func, const uint64_t* args, size_t n_args, bool is_tail_call)) \
+    X(uint64_t, makeReturn, (uint64_t value)) \
+    X(uint64_t, returnValue, (uint64_t value)) \
+    X(uint64_t, array, (const uint64_t* elements, size_t n_elements)) \
+    X(uint64_t, hash, ()) \
+    X(uint64_t, hashSet, (uint64_t hash, uint64_t key, uint64_t value)) \
+    X(uint64_t, index, (uint64_t left, uint64_t index))
+
+#define AOT_RUNTIME_FIELD(ret, name, params) ret (*name) params;
+
+struct AotRuntime {
+    AOT_RUNTIME_FUNCS(AOT_RUNTIME_FIELD)
+};
+
+// Entry point of a module: runs the program in env, returns the bits of its
+// result like evaluator::eval would
+typedef uint64_t (*ModuleMain)(const AotRuntime* rt, void* env);
+
+// Ahead-of-time backend: programs are transpiled to C++ against a small
+// runtime header, compiled by the system compiler into a shared object and
+// loaded with dlopen. Functions made by a module are Functions with a native
+// body, so they can be called from, and call into, the other engines.
+namespace aot {
+
+// C++ source of program, which includes "toylang_runtime.h"
+std::string emitCpp(const std::shared_ptr<Program>& program);
+
+// Text of toylang_runtime.h
+const std::string& runtimeHeader();
+
+// $TOYLANG_CACHE_DIR, else ~/.cache/toylang, empty if neither is set since
+// a shared dir like /tmp isn't safe to load modules from
+std::string defaultCacheDir();
+
+// Compiled modules, kept in dir by the hash of their source and compiler
+// command, so a program is only compiled once. Modules are never unloaded.
+// A new dir is made private to the user, and modules are only loaded while
+// the dir and they belong to the user and no one else can write to them.
+class ModuleCache {
+    std::string m_dir;
+    std::string m_compiler;
+    std::map<uint64_t, ModuleMain> m_loaded;
+    std::vector<std::string> m_errors;
+
+    bool compile(const std::string& cpp_source, const std::string& command, const std::string& so_path);
+
+public:
+    ModuleCache(const std::string& dir = defaultCacheDir(), const std::string& compiler = "");
+
+    // nullptr, with the reason in errors(), if it can't be compiled or loaded
+    ModuleMain load(const std::string& cpp_source);
+
+    // Compiles program unless it's cached and runs it, empty on failure
+    Value run(const std::shared_ptr<Program>& program, EnvPtr env);
+
+    const std::string& dir() const { return m_dir; }
+    const std::vector<std::string>& errors() const { return m_errors; }
+};
+
+} // aot
@@ -0,0 +1,27 @@
+#include "arena.h"
+
+Arena::~Arena() {
+    for (auto it = m_destructors.rbegin(); it != m_destructors.rend(); it++)
+        it->destroy(it->obj);
+}
+
+void* Arena::allocate(size_t size, size_t align) {
+    size_t padding = (align - reinterpret_cast<uintptr_t>(m_cur) % align) % align;
+
+    if (!m_cur || padding + size > m_left) {
+        // Oversized requests get a block of their own
+        const size_t block_size = size + align > BLOCK_SIZE ? size + align : BLOCK_SIZE;
+
+        m_blocks.push_back(std::unique_ptr<char[]>(new char[block_size]));
+        m_cur = m_blocks.back().get();
+        m_left = block_size;
+        padding = (align - reinterpret_cast<uintptr_t>(m_cur) % align) % align;
+    }
+
+    void* ptr = m_cur + padding;
+    m_cur += padding + size;
+    m_left -= padding + size;
+    m_used += size;
+
+    return ptr;
+}
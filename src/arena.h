@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator the parser builds the AST in. Nodes are never freed one by
+// one: all destructors run and all blocks are released with the arena.
+class Arena: public std::enable_shared_from_this<Arena> {
+    struct Destructor {
+        void (*destroy)(void*);
+        void* obj;
+    };
+
+    static constexpr size_t BLOCK_SIZE = 1 << 16;
+
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    std::vector<Destructor> m_destructors;
+    std::vector<std::shared_ptr<const void>> m_retained;
+    char* m_cur {nullptr};
+    size_t m_left {0};
+    size_t m_used {0};
+
+    void* allocate(size_t size, size_t align);
+
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator= (const Arena&) = delete;
+
+    ~Arena();
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        T* obj = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+        if constexpr (!std::is_trivially_destructible_v<T>)
+            m_destructors.push_back({[](void* ptr) { static_cast<T*>(ptr)->~T(); }, obj});
+
+        return obj;
+    }
+
+    // Keeps something the nodes point into alive as long as the arena
+    void retain(std::shared_ptr<const void> owner) { m_retained.push_back(owner); }
+
+    size_t bytesUsed() const { return m_used; }
+};
@@ -6,6 +6,31 @@ std::ostream& operator<< (std::ostream& out, ASTNode& node) {
     return out;
 }
 
+const std::vector<Identifier>& ASTNode::getParams() const {
+    static const std::vector<Identifier> none;
+    return none;
+}
+
+const std::vector<Statement*>& ASTNode::getStatements() const {
+    static const std::vector<Statement*> none;
+    return none;
+}
+
+const std::vector<ExprPtr>& ASTNode::getArgs() const {
+    static const std::vector<ExprPtr> none;
+    return none;
+}
+
+const std::vector<ExprPtr>& ASTNode::getElements() const {
+    static const std::vector<ExprPtr> none;
+    return none;
+}
+
+const std::map<ExprPtr, ExprPtr>& ASTNode::getPairs() const {
+    static const std::map<ExprPtr, ExprPtr> none;
+    return none;
+}
+
 const std::string Program::tokenLiteral() const {
     if (static_cast<int>(m_statements.size()) > 0)
         return m_statements[0]->tokenLiteral();
@@ -13,7 +38,7 @@ const std::string Program::tokenLiteral() const {
     return "";
 }
 
-void Program::pushStatement(std::shared_ptr<Statement> statement) {
+void Program::pushStatement(Statement* statement) {
     m_statements.push_back(statement);
 }
 
@@ -25,7 +50,7 @@ std::string Program::toString() const  {
     return statement_str;
 }
 
-std::shared_ptr<Statement> Program::getStatementAt(unsigned int index) {
+Statement* Program::getStatementAt(unsigned int index) {
     if (m_statements.size() == 0)
         return nullptr;
 
@@ -47,27 +72,53 @@ StringLiteral::StringLiteral(const Token& tok, const std::string& value)
     : m_tok(tok), m_value(value) {
 }
 
-PrefixExpr::PrefixExpr(const Token& tok, const std::string& oprtr)
+oprtr_type toOprtr(int tok_type) {
+    switch (tok_type)
+    {
+    case TOK_PLUS:
+        return OPRTR_ADD;
+    case TOK_MINUS:
+        return OPRTR_SUB;
+    case TOK_MUL:
+        return OPRTR_MUL;
+    case TOK_DIV:
+        return OPRTR_DIV;
+    case TOK_LT:
+        return OPRTR_LT;
+    case TOK_GT:
+        return OPRTR_GT;
+    case TOK_EQ:
+        return OPRTR_EQ;
+    case TOK_NOT_EQ:
+        return OPRTR_NOT_EQ;
+    case TOK_BANG:
+        return OPRTR_BANG;
+    default:
+        return OPRTR_UNKNOWN;
+    }
+}
+
+PrefixExpr::PrefixExpr(const Token& tok, oprtr_type oprtr)
     : m_tok(tok), m_oprtr(oprtr) {
 }
 
 std::string PrefixExpr::toString() const {
     std::string prefix_str = "(";
-    prefix_str += m_oprtr;
+    prefix_str += oprtr_lut[m_oprtr];
     prefix_str += m_right->toString();
     prefix_str += ")";
 
     return prefix_str;
 }
 
-InfixExpr::InfixExpr(const Token& tok, ExprPtr left, const std::string& oprtr)
+InfixExpr::InfixExpr(const Token& tok, ExprPtr left, oprtr_type oprtr)
     : m_tok(tok), m_left((left)), m_oprtr(oprtr) {
 }
 
 std::string InfixExpr::toString() const {
     std::string infix_str = "(";
     infix_str += m_left->toString();
-    infix_str += " " + m_oprtr + " ";
+    infix_str += " " + oprtr_lut[m_oprtr] + " ";
     infix_str += m_right->toString();
     infix_str += ")";
 
@@ -89,12 +140,12 @@ std::string IfExpr::toString() const {
     return if_str;
 }
 
-FuncLiteral::FuncLiteral(const Token& tok)
-    : m_tok(tok) {
+FuncLiteral::FuncLiteral(const Token& tok, Arena* arena)
+    : m_tok(tok), m_arena(arena) {
 }
 
 std::string FuncLiteral::toString() const {
-    std::string func_literal_str = m_tok.literal + "(";
+    std::string func_literal_str = std::string(m_tok.literal) + "(";
 
     for (const auto& param : m_params)
         func_literal_str += param.toString();
@@ -242,7 +293,7 @@ BlockStatement::BlockStatement(const Token& tok)
     : m_tok(tok) {
 }
 
-void BlockStatement::pushStatement(std::shared_ptr<Statement> statement) {
+void BlockStatement::pushStatement(Statement* statement) {
     m_statements.push_back(statement);
 }
 
@@ -254,7 +305,7 @@ std::string BlockStatement::toString() const {
     return out;
 }
 
-std::shared_ptr<Statement> BlockStatement::getStatementAt(unsigned int index) {
+Statement* BlockStatement::getStatementAt(unsigned int index) {
     if (m_statements.size() == 0)
         return nullptr;
 
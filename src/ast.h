@@ -4,6 +4,7 @@
 #include <vector>
 #include <memory>
 
+#include "arena.h"
 #include "token.h"
 
 enum node_type {
@@ -25,7 +26,8 @@ enum node_type {
     NODE_IDENT,
     NODE_BOOL,
     NODE_PREFIX,
-    NODE_INFIX
+    NODE_INFIX,
+    NODE_INLINED_CALL
 };
 
 const std::vector<std::string> node_lut = {
@@ -46,17 +48,52 @@ const std::vector<std::string> node_lut = {
     "NODE_IDENT",
     "NODE_BOOL",
     "NODE_PREFIX",
-    "NODE_INFIX"
+    "NODE_INFIX",
+    "NODE_INLINED_CALL"
 };
 
+// Operators of prefix and infix expressions, resolved by the parser so
+// that evaluating them compares no strings. Prefix - is OPRTR_SUB.
+enum oprtr_type {
+    OPRTR_UNKNOWN,
+    OPRTR_ADD,
+    OPRTR_SUB,
+    OPRTR_MUL,
+    OPRTR_DIV,
+    OPRTR_LT,
+    OPRTR_GT,
+    OPRTR_EQ,
+    OPRTR_NOT_EQ,
+    OPRTR_BANG
+};
+
+const int N_OPRTRS = OPRTR_BANG + 1;
+
+const std::vector<std::string> oprtr_lut = {
+    "",
+    "+",
+    "-",
+    "*",
+    "/",
+    "<",
+    ">",
+    "==",
+    "!=",
+    "!"
+};
+
+oprtr_type toOprtr(int tok_type);
+
 class ASTNode;
 class Expr;
 class Identifier;
 class Statement;
 class BlockStatement;
 
-typedef std::shared_ptr<ASTNode> ASTNodePtr;
-typedef std::shared_ptr<Expr> ExprPtr;
+// Nodes live in the arena of the Program they were parsed into and refer to
+// each other with plain pointers
+typedef ASTNode* ASTNodePtr;
+typedef Expr* ExprPtr;
 
 class ASTNode {
 public:
@@ -72,24 +109,45 @@ public:
     virtual ExprPtr getIndex() { return nullptr; }
     virtual ExprPtr getCondition() { return nullptr; }
     virtual ExprPtr getFunc() { return nullptr; }
-    virtual std::shared_ptr<BlockStatement> getConsequence() { return nullptr; }
-    virtual std::shared_ptr<BlockStatement> getAlternative() { return nullptr; }
-    virtual std::shared_ptr<BlockStatement> getBody() { return nullptr; }
+    virtual ExprPtr getCall() { return nullptr; }
+    virtual BlockStatement* getConsequence() { return nullptr; }
+    virtual BlockStatement* getAlternative() { return nullptr; }
+    virtual BlockStatement* getBody() { return nullptr; }
+
+    // Function values hold on to this so their body outlives the Program
+    virtual std::shared_ptr<Arena> getArena() const { return nullptr; }
 
-    virtual std::vector<Identifier> getParams() const { return {}; }
-    virtual std::vector<std::shared_ptr<Statement>> getStatements() { return {}; }
-    virtual std::vector<ExprPtr> getArgs() { return {}; }
-    virtual std::vector<ExprPtr> getElements() { return {}; }
+    // Children are returned by reference, nodes without them return an
+    // empty container
+    virtual const std::vector<Identifier>& getParams() const;
+    virtual const std::vector<Statement*>& getStatements() const;
+    virtual Statement* getStatementAt(unsigned int index) { (void)index; return nullptr; }
+    virtual const std::vector<ExprPtr>& getArgs() const;
+    virtual const std::vector<ExprPtr>& getElements() const;
 
-    virtual std::map<ExprPtr, ExprPtr> getPairs() { return {}; }
+    virtual const std::map<ExprPtr, ExprPtr>& getPairs() const;
 
     virtual int nodeType() const { return NODE_BASIC; }
     virtual int getIntValue() const { return -1; }
 
+    // Lexical address set by the resolver, -1 when unresolved
+    virtual int getDepth() const { return -1; }
+    virtual int getSlot() const { return -1; }
+    virtual int getSlotCount() const { return 0; }
+
     virtual double getFloatValue() const { return -1; }
 
     virtual bool getBoolValue() const { return false; }
 
+    // oprtr_type of a prefix or infix expression
+    virtual int getOprtr() const { return OPRTR_UNKNOWN; }
+
+    // Set by the resolver on calls whose value is returned as is
+    virtual bool isTailCall() const { return false; }
+
+    // Set by the resolver on reads of a local that nothing reads after them
+    virtual bool isLastUse() const { return false; }
+
     friend std::ostream& operator<< (std::ostream& out, ASTNode& node);
 };
 
@@ -107,12 +165,17 @@ public:
     virtual ~Statement() = default;
 };
 
-// Root node of AST
+// Root node of AST, owns the arena the rest of the tree is allocated in
 class Program: public ASTNode {
-    std::vector<std::shared_ptr<Statement>> m_statements;
+    std::shared_ptr<Arena> m_arena;
+    std::vector<Statement*> m_statements;
 
 public:
-    void pushStatement(std::shared_ptr<Statement> statement);
+    Program(std::shared_ptr<Arena> arena = std::make_shared<Arena>()) : m_arena(arena) {}
+
+    void pushStatement(Statement* statement);
+
+    Arena& arena() { return *m_arena; }
 
     const std::string tokenLiteral() const override;
     std::string toString() const override;
@@ -120,25 +183,35 @@ public:
     unsigned int nStatements() const { return static_cast<unsigned int>(m_statements.size()); } 
     int nodeType() const override { return NODE_PROGRAM; }
 
-    std::shared_ptr<Statement> getStatementAt(unsigned int index);
+    Statement* getStatementAt(unsigned int index) override;
 
-    std::vector<std::shared_ptr<Statement>> getStatements() override { return (m_statements); }
+    const std::vector<Statement*>& getStatements() const override { return m_statements; }
 };
 
 class Identifier: public Expr {
     Token m_tok; // Move this to parent?
     std::string m_value;
+    int m_depth {-1};
+    int m_slot {-1};
+    bool m_last_use {false};
 
 public:
     Identifier(const Token& tok, const std::string& value);
     Identifier() = default;
 
+    void setAddress(int depth, int slot) { m_depth = depth; m_slot = slot; }
+    void setLastUse(bool last_use) { m_last_use = last_use; }
+
     std::string toString() const override;
 
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
     const std::string getIdentName() const override { return m_value; }
 
     int nodeType() const override { return NODE_IDENT; }
+    int getDepth() const override { return m_depth; }
+    int getSlot() const override { return m_slot; }
+
+    bool isLastUse() const override { return m_last_use; }
 };
 
 class IntegerLiteral: public Expr {
@@ -150,8 +223,8 @@ public:
 
     void setValue(int value) { m_value = value; }
 
-    std::string toString() const override { return m_tok.literal; }
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    std::string toString() const override { return std::string(m_tok.literal); }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
     int nodeType() const override { return NODE_INT; }
     int getIntValue() const override { return m_value; }
@@ -166,8 +239,8 @@ public:
 
     void setValue(double value) { m_value = value; }
 
-    std::string toString() const override { return m_tok.literal; }
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    std::string toString() const override { return std::string(m_tok.literal); }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
     int nodeType() const override { return NODE_FLOAT; }
     double getFloatValue() const override { return m_value; }
@@ -180,8 +253,8 @@ class StringLiteral: public Expr {
 public:
     StringLiteral(const Token& tok, const std::string& value);
 
-    std::string toString() const override { return m_tok.literal; }
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    std::string toString() const override { return std::string(m_tok.literal); }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
      int nodeType() const override { return NODE_STR; }
 };
@@ -193,8 +266,8 @@ class BoolExpr: public Expr {
 public:
     BoolExpr(const Token& tok, bool value);
 
-    std::string toString() const override { return m_tok.literal; }
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    std::string toString() const override { return std::string(m_tok.literal); }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
     int nodeType() const override { return NODE_BOOL; }
 
@@ -211,9 +284,9 @@ public:
     void setElements(std::vector<ExprPtr> elements) { m_elements = elements; }
 
     std::string toString() const override;
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
-    std::vector<ExprPtr> getElements() override { return m_elements; }
+    const std::vector<ExprPtr>& getElements() const override { return m_elements; }
 
     int nodeType() const override { return NODE_ARRAY; }
 };
@@ -221,16 +294,17 @@ public:
 class IndexExpr: public Expr {
     Token m_tok;
     // <expr>[<expr>]
-    ExprPtr m_left;
-    ExprPtr m_index;
+    ExprPtr m_left {nullptr};
+    ExprPtr m_index {nullptr};
 
 public:
     IndexExpr(const Token& tok, ExprPtr left);
 
+    void setLeft(ExprPtr left) { m_left = left; }
     void setIndex(ExprPtr index) { m_index = index; }
 
     std::string toString() const override;
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
     ExprPtr getLeft() override { return m_left; }
     ExprPtr getIndex() override { return m_index; }
@@ -248,70 +322,73 @@ public:
     void setPairs(std::map<ExprPtr, ExprPtr> pairs) { m_pairs = pairs; }
 
     std::string toString() const override;
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
-    std::map<ExprPtr, ExprPtr> getPairs() override { return m_pairs; }
+    const std::map<ExprPtr, ExprPtr>& getPairs() const override { return m_pairs; }
 
     int nodeType() const override { return NODE_HASH; }
 };
 
 class PrefixExpr: public Expr {
     Token m_tok;
-    std::string m_oprtr;
-    ExprPtr m_right;
+    oprtr_type m_oprtr;
+    ExprPtr m_right {nullptr};
 
 public:
-    PrefixExpr(const Token& tok, const std::string& oprtr);
+    PrefixExpr(const Token& tok, oprtr_type oprtr);
 
     void setRight(ExprPtr right) { m_right = right; }
 
     std::string toString() const override;
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
     ExprPtr getRight() override { return m_right; }
 
     int nodeType() const override { return NODE_PREFIX; }
+    int getOprtr() const override { return m_oprtr; }
 };
 
 class InfixExpr: public Expr {
     Token m_tok;
-    ExprPtr m_left;
-    ExprPtr m_right;
-    std::string m_oprtr;
+    ExprPtr m_left {nullptr};
+    ExprPtr m_right {nullptr};
+    oprtr_type m_oprtr;
 
 public:
-    InfixExpr(const Token& tok, ExprPtr left, const std::string& oprtr);
+    InfixExpr(const Token& tok, ExprPtr left, oprtr_type oprtr);
 
+    void setLeft(ExprPtr left) { m_left = left; }
     void setRight(ExprPtr right) { m_right = right; }
 
     std::string toString() const override;
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
     ExprPtr getLeft() override { return m_left; }
     ExprPtr getRight() override { return m_right; }
 
     int nodeType() const override { return NODE_INFIX; }
+    int getOprtr() const override { return m_oprtr; }
 };
 
 class IfExpr: public Expr {
     Token m_tok;
-    ExprPtr m_condition;
-    std::shared_ptr<BlockStatement> m_consequence;
-    std::shared_ptr<BlockStatement> m_alternative;
+    ExprPtr m_condition {nullptr};
+    BlockStatement* m_consequence {nullptr};
+    BlockStatement* m_alternative {nullptr};
 
 public:
     IfExpr(Token tok);
 
     void setCondition(ExprPtr condition) { m_condition = condition; }
-    void setConsequence(std::shared_ptr<BlockStatement> consequence) { m_consequence = consequence; }
-    void setAlternative(std::shared_ptr<BlockStatement> alternative) { m_alternative = alternative; }
+    void setConsequence(BlockStatement* consequence) { m_consequence = consequence; }
+    void setAlternative(BlockStatement* alternative) { m_alternative = alternative; }
 
     std::string toString() const override;
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
     ExprPtr getCondition() override { return m_condition; }
-    std::shared_ptr<BlockStatement> getConsequence() override { return m_consequence; }
-    std::shared_ptr<BlockStatement> getAlternative() override { return m_alternative; }
+    BlockStatement* getConsequence() override { return m_consequence; }
+    BlockStatement* getAlternative() override { return m_alternative; }
 
     int nodeType() const override { return NODE_IF_EXPR; }
 };
@@ -319,70 +396,104 @@ public:
 class FuncLiteral: public Expr {
     Token m_tok;
     std::vector<Identifier> m_params;
-    std::shared_ptr<BlockStatement> m_body;
+    BlockStatement* m_body {nullptr};
+    Arena* m_arena {nullptr};
+    int m_n_slots {0}; // params first, then locals
 
 public:
-    FuncLiteral(const Token& tok);
+    FuncLiteral(const Token& tok, Arena* arena);
 
     void setParams(const std::vector<Identifier>& params) { m_params = params; }
-    void setBody(std::shared_ptr<BlockStatement> body) { m_body = body; }
+    void setBody(BlockStatement* body) { m_body = body; }
+    void setSlotCount(int n_slots) { m_n_slots = n_slots; }
 
     std::string toString() const override;
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
-    std::shared_ptr<BlockStatement> getBody() override { return m_body; }
+    BlockStatement* getBody() override { return m_body; }
+    std::shared_ptr<Arena> getArena() const override { return m_arena->shared_from_this(); }
 
-    std::vector<Identifier> getParams() const override { return m_params; }
+    const std::vector<Identifier>& getParams() const override { return m_params; }
 
     int nodeType() const override { return NODE_FUNC; }
+    int getSlotCount() const override { return m_n_slots; }
 };
 
 class CallExpr: public Expr {
     Token m_tok;
-    ExprPtr m_func;
+    ExprPtr m_func {nullptr};
     std::vector<ExprPtr> m_args;
+    bool m_tail {false};
 
 public:
     CallExpr(const Token& tok, ExprPtr func);
 
+    void setFunc(ExprPtr func) { m_func = func; }
     void setArgs(std::vector<ExprPtr> args) { m_args = args; }
+    void setTailCall(bool tail) { m_tail = tail; }
 
     std::string toString() const override;
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
     ExprPtr getFunc() override { return m_func; }
     ExprPtr getArgAt(unsigned int index) override;
 
     size_t getArgSize() const override { return m_args.size(); }
 
-    std::vector<ExprPtr> getArgs() override { return m_args; }
+    const std::vector<ExprPtr>& getArgs() const override { return m_args; }
 
     int nodeType() const override { return NODE_CALL_EXPR; }
+    bool isTailCall() const override { return m_tail; }
+};
+
+// Call of a small function literal with the body expression copied in and
+// the args in place of the params. Made by the Optimizer. The call itself is
+// still made when the callee turns out not to be a function of that literal.
+class InlinedCall: public Expr {
+    CallExpr* m_call;
+    BlockStatement* m_body; // of the literal
+    ExprPtr m_inlined;
+
+public:
+    InlinedCall(CallExpr* call, BlockStatement* body, ExprPtr inlined)
+        : m_call(call), m_body(body), m_inlined(inlined) {}
+
+    const std::string tokenLiteral() const override { return m_call->tokenLiteral(); }
+    std::string toString() const override { return m_call->toString(); }
+
+    ExprPtr getExpr() override { return m_inlined; }
+    ExprPtr getFunc() override { return m_call->getFunc(); }
+    ExprPtr getCall() override { return m_call; }
+    BlockStatement* getBody() override { return m_body; }
+
+    int nodeType() const override { return NODE_INLINED_CALL; }
 };
 
 class LetStatement: public Statement {
     Token m_tok;
     Identifier m_name;
-    ExprPtr m_value;
+    ExprPtr m_value {nullptr};
 
 public:
     LetStatement(const Token& tok);
 
     std::string toString() const override;
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
     const std::string getIdentName() const override { return m_name.getIdentName(); }
 
     void setName(const Identifier ident) { m_name = ident; }
     void setValue(ExprPtr expr) { m_value = expr; }
+    void setSlot(int slot) { m_name.setAddress(0, slot); }
 
     ExprPtr getExpr() override { return m_value; }
 
     int nodeType() const override { return NODE_LET_STMNT; }
+    int getSlot() const override { return m_name.getSlot(); }
 };
 
 class ReturnStatement: public Statement {
     Token m_tok;
-    ExprPtr m_value;
+    ExprPtr m_value {nullptr};
 
 public:
     ReturnStatement(const Token& tok);
@@ -390,7 +501,7 @@ public:
     void setValue(ExprPtr expr) { m_value = expr; }
     
     std::string toString() const override;
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
     ExprPtr getExpr() override { return m_value; }
 
@@ -399,7 +510,7 @@ public:
 
 class ExprStatement: public Statement {
     Token m_tok;
-    ExprPtr m_expr;
+    ExprPtr m_expr {nullptr};
 
 public:
     ExprStatement(const Token& tok);
@@ -408,7 +519,7 @@ public:
 
     std::string toString() const override;
 
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
     ExprPtr getExpr() override { return m_expr; }
 
@@ -417,19 +528,19 @@ public:
 
 class BlockStatement: public Statement {
     Token m_tok;
-    std::vector<std::shared_ptr<Statement>> m_statements;
+    std::vector<Statement*> m_statements;
 
 public:
     BlockStatement(const Token& tok);
 
-    void pushStatement(std::shared_ptr<Statement> statement);
+    void pushStatement(Statement* statement);
 
     std::string toString() const override;
-    const std::string tokenLiteral() const override { return m_tok.literal; }
+    const std::string tokenLiteral() const override { return std::string(m_tok.literal); }
 
-    std::shared_ptr<Statement> getStatementAt(unsigned int index);
+    Statement* getStatementAt(unsigned int index) override;
 
     int nodeType() const override { return NODE_BLOCK_STMNT; }
 
-    std::vector<std::shared_ptr<Statement>> getStatements() override { return m_statements; }
+    const std::vector<Statement*>& getStatements() const override { return m_statements; }
 };
@@ -1,105 +1,321 @@
 #include "builtin.h"
+#include "env.h"
+#include "kernels.h"
+#include "purity.h"
 
-ObjectPtr getBuiltin(const std::string& func_name, const std::vector<ObjectPtr>& args) {
-    if (func_name == "len")
-        return len(args);
-    else if (func_name == "first")
-        return first(args);
-    else if (func_name == "last")
-        return last(args);
-    else if (func_name == "push")
-        return push(args);
-    else if (func_name == "type")
-        return type(args);
-    else if (func_name == "print")
-        return print(args);
+#include <map>
+#include <unordered_map>
 
-    return std::make_shared<Error>("identifier not found: " + func_name);
+// Immortal string holding str, made once per distinct str
+static Value internString(const std::string& str) {
+    static std::map<std::string, Value> strings;
+    auto& interned = strings[str];
+
+    if (!interned) {
+        interned = makeObject<String>(str);
+        gc::makeImmortal(interned.asObject());
+    }
+
+    return interned;
 }
 
-ObjectPtr len(const std::vector<ObjectPtr>& args) {
+Value len(const std::vector<Value>& args) {
     const size_t n_args = args.size();
 
     if (n_args != 1)
-        return std::make_shared<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
     
     switch (args[0]->getType())
     {
     case OBJ_STR:
-        return std::make_shared<Integer>(static_cast<int>(args[0]->getStrVal().length()));
+        return Value(static_cast<int>(args[0]->getStrVal().length()));
     case OBJ_ARRAY:
-        return std::make_shared<Integer>(static_cast<int>(args[0]->getElements().size()));
+        return Value(static_cast<int>(args[0]->getElements().size()));
     default:
-        return std::make_shared<Error>("argument 'len' not supported, got=" + args[0]->typeString());
+        return makeObject<Error>("argument 'len' not supported, got=" + args[0]->typeString());
     }
 }
 
-ObjectPtr first(const std::vector<ObjectPtr>& args) {
+Value first(const std::vector<Value>& args) {
     const size_t n_args = args.size();
 
     if (n_args != 1)
-        return std::make_shared<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
     if (args[0]->getType() != OBJ_ARRAY)
-        return std::make_shared<Error>(("argument to 'first' must be ARRAY, got=" + args[0]->typeString()));
+        return makeObject<Error>(("argument to 'first' must be ARRAY, got=" + args[0]->typeString()));
 
-    auto arr = args[0];
-    if (arr->getElements().size() > 0)
-        return arr->getElements()[0];
+    const auto& elements = args[0]->getElements();
+    if (!elements.empty())
+        return elements.front();
 
-    return std::make_shared<NIL>();
+    return Value::nil();
 }
 
-ObjectPtr last(const std::vector<ObjectPtr>& args) {
+Value last(const std::vector<Value>& args) {
     const size_t n_args = args.size();
 
     if (n_args != 1)
-        return std::make_shared<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
     if (args[0]->getType() != OBJ_ARRAY)
-        return std::make_shared<Error>(("argument to 'last' must be ARRAY, got=" + args[0]->typeString()));
+        return makeObject<Error>(("argument to 'last' must be ARRAY, got=" + args[0]->typeString()));
 
-    auto arr = args[0];
-    const size_t len = arr->getElements().size();
-    if (len > 0)
-        return arr->getElements()[len-1];
+    const auto& elements = args[0]->getElements();
+    if (!elements.empty())
+        return elements.back();
 
-    return std::make_shared<NIL>();
+    return Value::nil();
 }
 
-// Arrays are immutable (currently at least...)
-ObjectPtr push(const std::vector<ObjectPtr>& args) {
+// Arrays are immutable, the new one shares its nodes with the old one. An
+// array only args holds can't be seen by anyone else, so it grows in place.
+Value push(const std::vector<Value>& args) {
     const size_t n_args = args.size();
 
     if (n_args != 2)
-        return std::make_shared<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=2");
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=2");
     if (args[0]->getType() != OBJ_ARRAY)
-        return std::make_shared<Error>(("argument to 'push' must be ARRAY, got=" + args[0]->typeString()));
+        return makeObject<Error>(("argument to 'push' must be ARRAY, got=" + args[0]->typeString()));
+
+    const auto& arr = args[0];
+
+    if (arr.asObject()->refs == 1) {
+        arr.as<Array>()->elements.append(args[1]);
+        return arr;
+    }
+
+    return makeObject<Array>(arr->getElements().push(args[1]));
+}
+
+// nullptr when arr is an array of ints and floats, an error otherwise
+static Value checkNumbers(const std::string& func_name, const Value& arr) {
+    if (arr->getType() != OBJ_ARRAY)
+        return makeObject<Error>(("argument to '" + func_name + "' must be ARRAY, got=" + arr->typeString()));
+
+    Value error = nullptr;
+
+    arr->getElements().forEachLeaf([&](const VectorNode& leaf) {
+        if (error || leaf.kind != LEAF_BOXED)
+            return;
+
+        for (const auto& value : leaf.values) {
+            if (!value.isInt() && !value.isFloat()) {
+                error = makeObject<Error>(("argument to '" + func_name + "' must be ARRAY of numbers, got element=" + value->typeString()));
+                return;
+            }
+        }
+    });
+
+    return error;
+}
+
+// Sums of the ints and of the floats of an array, kept apart so that an
+// array of ints sums to an int
+struct Totals {
+    int64_t ints {0};
+    double floats {0};
+    bool has_float {false};
+};
+
+static Totals totals(const PersistentVector& elements) {
+    Totals result;
+    double buffer[VECTOR_WIDTH];
+
+    elements.forEachLeaf([&](const VectorNode& leaf) {
+        switch (leaf.kind)
+        {
+        case LEAF_INT:
+            result.ints += kernels::sumInts(leaf.ints.data(), leaf.size());
+            break;
+        case LEAF_FLOAT:
+            result.floats += kernels::sumFloats(leaf.floats(buffer), leaf.size());
+            result.has_float = true;
+            break;
+        case LEAF_BOXED:
+            for (const auto& value : leaf.values) {
+                if (value.isInt()) {
+                    result.ints += value.asInt();
+                } else {
+                    result.floats += value.asFloat();
+                    result.has_float = true;
+                }
+            }
+            break;
+        }
+    });
+
+    return result;
+}
+
+static bool lessThan(const Value& a, const Value& b) {
+    if (a.isInt() && b.isInt())
+        return a.asInt() < b.asInt();
+
+    return a.getFloatVal() < b.getFloatVal();
+}
+
+// Smallest or largest element, the first one of equal elements
+static Value extremum(const PersistentVector& elements, bool is_max) {
+    Value best = Value::nil();
+    double buffer[VECTOR_WIDTH];
+
+    elements.forEachLeaf([&](const VectorNode& leaf) {
+        Value candidate;
+
+        switch (leaf.kind)
+        {
+        case LEAF_INT:
+            candidate = Value(is_max ? kernels::maxInts(leaf.ints.data(), leaf.size()) : kernels::minInts(leaf.ints.data(), leaf.size()));
+            break;
+        case LEAF_FLOAT: {
+            const double* floats = leaf.floats(buffer);
+            candidate = Value(is_max ? kernels::maxFloats(floats, leaf.size()) : kernels::minFloats(floats, leaf.size()));
+            break;
+        }
+        case LEAF_BOXED:
+            candidate = leaf.values[0];
+            for (const auto& value : leaf.values) {
+                if (is_max ? lessThan(candidate, value) : lessThan(value, candidate))
+                    candidate = value;
+            }
+            break;
+        }
+
+        if (best.isNil() || (is_max ? lessThan(best, candidate) : lessThan(candidate, best)))
+            best = candidate;
+    });
+
+    return best;
+}
+
+// Ints sum to an int that wraps around like int addition does, with any
+// float in the array everything is added up as floats
+Value sum(const std::vector<Value>& args) {
+    const size_t n_args = args.size();
+
+    if (n_args != 1)
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
+    if (auto error = checkNumbers("sum", args[0]))
+        return error;
+
+    const Totals result = totals(args[0]->getElements());
+
+    if (result.has_float)
+        return Value(static_cast<double>(result.ints) + result.floats);
+
+    return Value(static_cast<int>(static_cast<uint32_t>(result.ints)));
+}
+
+Value min(const std::vector<Value>& args) {
+    const size_t n_args = args.size();
+
+    if (n_args != 1)
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
+    if (auto error = checkNumbers("min", args[0]))
+        return error;
+
+    return extremum(args[0]->getElements(), false);
+}
+
+Value max(const std::vector<Value>& args) {
+    const size_t n_args = args.size();
+
+    if (n_args != 1)
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
+    if (auto error = checkNumbers("max", args[0]))
+        return error;
+
+    return extremum(args[0]->getElements(), true);
+}
+
+Value mean(const std::vector<Value>& args) {
+    const size_t n_args = args.size();
+
+    if (n_args != 1)
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
+    if (auto error = checkNumbers("mean", args[0]))
+        return error;
+
+    const auto& elements = args[0]->getElements();
+    if (elements.empty())
+        return Value::nil();
+
+    const Totals result = totals(elements);
+
+    return Value((static_cast<double>(result.ints) + result.floats) / static_cast<double>(elements.size()));
+}
 
-    auto arr = args[0];
-    std::vector<ObjectPtr> new_arr;
+// Products of two ints wrap around like int multiplication does and add up
+// to an int, products with a float add up to a float
+Value dot(const std::vector<Value>& args) {
+    const size_t n_args = args.size();
+
+    if (n_args != 2)
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=2");
+    if (auto error = checkNumbers("dot", args[0]))
+        return error;
+    if (auto error = checkNumbers("dot", args[1]))
+        return error;
+
+    const auto& a = args[0]->getElements();
+    const auto& b = args[1]->getElements();
+
+    if (a.size() != b.size())
+        return makeObject<Error>("arguments to 'dot' must have the same length, got=" + std::to_string(a.size()) + " and " + std::to_string(b.size()));
+
+    uint32_t ints = 0;
+    double floats = 0;
+    bool has_float = false;
+    double buffer_a[VECTOR_WIDTH];
+    double buffer_b[VECTOR_WIDTH];
+
+    // Both vectors break into leaves at the same indexes
+    for (size_t index = 0; index < a.size(); index += VECTOR_WIDTH) {
+        const VectorNode& leaf_a = *a.leafFor(index);
+        const VectorNode& leaf_b = *b.leafFor(index);
+        const size_t n = leaf_a.size();
 
-    for (const auto& element : arr->getElements())
-        new_arr.push_back(element->clone());
+        if (leaf_a.kind == LEAF_INT && leaf_b.kind == LEAF_INT) {
+            ints += static_cast<uint32_t>(kernels::dotInts(leaf_a.ints.data(), leaf_b.ints.data(), n));
+        } else if (leaf_a.kind == LEAF_FLOAT && leaf_b.kind == LEAF_FLOAT) {
+            floats += kernels::dotFloats(leaf_a.floats(buffer_a), leaf_b.floats(buffer_b), n);
+            has_float = true;
+        } else {
+            for (size_t i = 0; i < n; i++) {
+                const Value x = leaf_a.at(i);
+                const Value y = leaf_b.at(i);
 
-    new_arr.push_back(args[1]);
+                if (x.isInt() && y.isInt()) {
+                    ints += static_cast<uint32_t>(x.asInt()) * static_cast<uint32_t>(y.asInt());
+                } else {
+                    floats += x.getFloatVal() * y.getFloatVal();
+                    has_float = true;
+                }
+            }
+        }
+    }
+
+    if (has_float)
+        return Value(static_cast<double>(static_cast<int>(ints)) + floats);
 
-    return std::make_shared<Array>(new_arr);
+    return Value(static_cast<int>(ints));
 }
 
-ObjectPtr type(const std::vector<ObjectPtr>& args) {
+Value type(const std::vector<Value>& args) {
     const size_t n_args = args.size();
 
     if (n_args != 1)
-        return std::make_shared<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
     
-    return std::make_shared<String>((args[0]->typeString()));
+    // Only a handful of type names exist
+    return internString(args[0]->typeString());
 }
 
-ObjectPtr print(const std::vector<ObjectPtr>& args) {
+Value print(const std::vector<Value>& args) {
     std::string str_out = "";
 
     for (const auto& arg : args) {
         if (!isPrintable(arg->getType()))
-            return std::make_shared<Error>("can't print object of type=" + arg->typeString());
+            return makeObject<Error>("can't print object of type=" + arg->typeString());
     
         if (arg->getType() == OBJ_STR)
             str_out += arg->getStrVal();
@@ -107,24 +323,146 @@ ObjectPtr print(const std::vector<ObjectPtr>& args) {
             str_out += arg->inspect();
     }
 
-    return std::make_shared<String>(str_out);
+    return makeObject<String>(str_out);
+}
+
+// Function that keeps its results, if func is pure. The optional second
+// argument is how many results it keeps at most.
+Value memo(const std::vector<Value>& args) {
+    const size_t n_args = args.size();
+
+    if (n_args != 1 && n_args != 2)
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1 or 2");
+    if (args[0]->getType() == OBJ_CLOSURE)
+        return makeObject<Error>("memo isn't supported by the bytecode VM");
+    if (args[0]->getType() != OBJ_FUNC && args[0]->getType() != OBJ_MEMO)
+        return makeObject<Error>(("argument to 'memo' must be FUNC, got=" + args[0]->typeString()));
+    if (n_args == 2 && (args[1]->getType() != OBJ_INT || args[1]->getIntVal() < 0))
+        return makeObject<Error>(("capacity of 'memo' must be a non-negative INT, got=" + args[1]->inspect()));
+
+    auto func = args[0];
+    if (func->getType() == OBJ_MEMO)
+        func = func.as<Memoized>()->func;
+
+    std::vector<MemoBinding> bindings;
+    const auto reason = purity::impurity(func, &bindings);
+    if (!reason.empty())
+        return makeObject<Error>("can't memoize impure function: it " + reason);
+
+    const size_t capacity = n_args == 2 ? static_cast<size_t>(args[1]->getIntVal()) : DEFAULT_MEMO_CAPACITY;
+
+    return makeObject<Memoized>(func, capacity, std::move(bindings));
+}
+
+static void setCount(HashTable& pairs, const std::string& name, size_t count) {
+    const auto key = internString(name);
+    pairs.set(key->hashKey(), key, Value(static_cast<int>(count)));
+}
+
+// Counters of a memoized function: hits, misses, size and capacity
+Value memostats(const std::vector<Value>& args) {
+    const size_t n_args = args.size();
+
+    if (n_args != 1)
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=1");
+    if (args[0]->getType() != OBJ_MEMO)
+        return makeObject<Error>(("argument to 'memostats' must be a memoized FUNC, got=" + args[0]->typeString()));
+
+    const auto& table = args[0].as<Memoized>()->table;
+    HashTable pairs;
+
+    setCount(pairs, "hits", table.hits());
+    setCount(pairs, "misses", table.misses());
+    setCount(pairs, "size", table.size());
+    setCount(pairs, "capacity", table.capacity());
+
+    return makeObject<Hash>(std::move(pairs));
+}
+
+static Value makeBuiltin(const std::string& func_name, BuiltinFunc func, int arity, bool is_pure = true) {
+    auto builtin = makeObject<Builtin>(func_name, func, arity, is_pure);
+    gc::makeImmortal(builtin.asObject());
+
+    return builtin;
+}
+
+// Builtins by name, each an immortal Builtin object. Starts out with the
+// ones every program has.
+static std::unordered_map<std::string, Value>& registry() {
+    static std::unordered_map<std::string, Value> builtins = {
+        {"len", makeBuiltin("len", len, 1)},
+        {"first", makeBuiltin("first", first, 1)},
+        {"last", makeBuiltin("last", last, 1)},
+        {"push", makeBuiltin("push", push, 2)},
+        {"sum", makeBuiltin("sum", sum, 1)},
+        {"min", makeBuiltin("min", min, 1)},
+        {"max", makeBuiltin("max", max, 1)},
+        {"mean", makeBuiltin("mean", mean, 1)},
+        {"dot", makeBuiltin("dot", dot, 2)},
+        {"type", makeBuiltin("type", type, 1)},
+        {"print", makeBuiltin("print", print, ANY_ARITY, false)},
+        {"memo", makeBuiltin("memo", memo, ANY_ARITY)},
+        {"memostats", makeBuiltin("memostats", memostats, 1, false)}
+    };
+
+    return builtins;
+}
+
+void registerBuiltin(const std::string& func_name, BuiltinFunc func, int arity, bool is_pure) {
+    auto& builtin = registry()[func_name];
+
+    if (!builtin) {
+        builtin = makeBuiltin(func_name, func, arity, is_pure);
+        return;
+    }
+
+    // Replaced in place, so the code holding the old one calls the new one
+    auto native = builtin.as<Builtin>();
+    native->func = func;
+    native->arity = arity;
+    native->is_pure = is_pure;
+}
+
+Value builtinObject(const std::string& func_name) {
+    auto search = registry().find(func_name);
+    if (search == registry().end())
+        return nullptr;
+
+    return search->second;
+}
+
+Value callBuiltin(const Value& builtin, const std::vector<Value>& args) {
+    const auto native = builtin.as<Builtin>();
+
+    if (native->arity != ANY_ARITY && args.size() != static_cast<size_t>(native->arity))
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=" + std::to_string(native->arity));
+
+    return native->func(args);
+}
+
+Value callMemoized(const Value& memoized, const std::vector<Value>& args, Value (*apply)(Value, std::vector<Value>)) {
+    auto& table = memoized.as<Memoized>()->table;
+    uint64_t hash = 0;
+
+    // Once a name the purity check relied on is bound to something else,
+    // the kept results may no longer be what the function gives
+    if (!purity::stillHold(memoized.as<Memoized>()->bindings, memoized) || !MemoTable::hashArgs(args, hash)) {
+        table.countMiss();
+        return apply(memoized.as<Memoized>()->func, args);
+    }
+
+    if (const auto result = table.get(hash, args))
+        return *result;
+
+    auto result = apply(memoized.as<Memoized>()->func, args);
+    if (result->getType() != OBJ_ERROR)
+        table.set(hash, args, result);
+
+    return result;
 }
 
 bool isBuiltIn(const std::string& func_name) {
-    if (func_name == "len")
-        return true;
-    if (func_name == "first")
-        return true;
-    if (func_name == "last")
-        return true;
-    if (func_name == "push")
-        return true;
-    if (func_name == "type")
-        return true;
-    if (func_name == "print")
-        return true;
-
-    return false;
+    return static_cast<bool>(builtinObject(func_name));
 }
 
 bool isPrintable(int obj_type) {
@@ -132,8 +470,16 @@ bool isPrintable(int obj_type) {
         return false;
     if (obj_type == OBJ_FUNC)
         return false;
+    if (obj_type == OBJ_COMPILED_FUNC)
+        return false;
+    if (obj_type == OBJ_CLOSURE)
+        return false;
     if (obj_type == OBJ_RETURN)
         return false;
+    if (obj_type == OBJ_TAIL_CALL)
+        return false;
+    if (obj_type == OBJ_MEMO)
+        return false;
     if (obj_type == OBJ_ERROR)
         return false;
     
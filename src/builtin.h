@@ -2,19 +2,49 @@
 
 #include "object.h"
 
-ObjectPtr getBuiltin(const std::string& func_name, const std::vector<ObjectPtr>& args);
-ObjectPtr len(const std::vector<ObjectPtr>& args);
-ObjectPtr first(const std::vector<ObjectPtr>& args);
-ObjectPtr last(const std::vector<ObjectPtr>& args);
-ObjectPtr push(const std::vector<ObjectPtr>& args);
-ObjectPtr type(const std::vector<ObjectPtr>& args);
-ObjectPtr print(const std::vector<ObjectPtr>& args);
+// Results kept by a memoized function unless memo is given another number
+const size_t DEFAULT_MEMO_CAPACITY = 4096;
+
+// Makes func callable as func_name from every engine. Arguments are
+// checked against arity before func runs, unless it's ANY_ARITY. A builtin
+// of the same name is replaced, also in the code already holding it. Only a
+// builtin registered as pure can be called by a memoized function.
+void registerBuiltin(const std::string& func_name, BuiltinFunc func, int arity = ANY_ARITY, bool is_pure = false);
+
+// Calls a Builtin object, as cheap as calling its function directly once
+// the arity is checked
+Value callBuiltin(const Value& builtin, const std::vector<Value>& args);
+
+// Calls a Memoized object: answers from its table when it has the args,
+// otherwise calls its function with apply, the applyFunction of the engine
+// making the call, and keeps the result unless it's an error. The table is
+// left alone while a name its purity was checked against holds something
+// else than it did then.
+Value callMemoized(const Value& memoized, const std::vector<Value>& args, Value (*apply)(Value, std::vector<Value>));
+
+Value len(const std::vector<Value>& args);
+Value first(const std::vector<Value>& args);
+Value last(const std::vector<Value>& args);
+Value push(const std::vector<Value>& args);
+Value sum(const std::vector<Value>& args);
+Value min(const std::vector<Value>& args);
+Value max(const std::vector<Value>& args);
+Value mean(const std::vector<Value>& args);
+Value dot(const std::vector<Value>& args);
+Value type(const std::vector<Value>& args);
+Value print(const std::vector<Value>& args);
+Value memo(const std::vector<Value>& args);
+Value memostats(const std::vector<Value>& args);
+
+// Immortal Builtin object for func_name, shared by every lookup. nullptr
+// if there is no builtin called func_name.
+Value builtinObject(const std::string& func_name);
 
 bool isBuiltIn(const std::string& func_name);
 bool isPrintable(int obj_type);
 
 // TODO: Add math functions etc.
-// ObjectPtr sin(const std::vector<ObjectPtr>& args);
-// ObjectPtr cos(const std::vector<ObjectPtr>& args);
-// ObjectPtr tan(const std::vector<ObjectPtr>& args);
-// ObjectPtr pow(const std::vector<ObjectPtr>& args);
+// Value sin(const std::vector<Value>& args);
+// Value cos(const std::vector<Value>& args);
+// Value tan(const std::vector<Value>& args);
+// Value pow(const std::vector<Value>& args);
@@ -0,0 +1,98 @@
+#include "code.h"
+
+namespace code {
+
+// Indexed by op_code
+const std::vector<Definition> definitions = {
+    {"OP_CONSTANT", {2}},
+    {"OP_POP", {}},
+    {"OP_ADD", {}},
+    {"OP_SUB", {}},
+    {"OP_MUL", {}},
+    {"OP_DIV", {}},
+    {"OP_EQ", {}},
+    {"OP_NOT_EQ", {}},
+    {"OP_LT", {}},
+    {"OP_GT", {}},
+    {"OP_MINUS", {}},
+    {"OP_BANG", {}},
+    {"OP_TRUE", {}},
+    {"OP_FALSE", {}},
+    {"OP_NIL", {}},
+    {"OP_JUMP", {2}},
+    {"OP_JUMP_NOT_TRUTHY", {2}},
+    {"OP_GET_GLOBAL", {2}},
+    {"OP_SET_GLOBAL", {2}},
+    {"OP_GET_LOCAL", {1}},
+    {"OP_SET_LOCAL", {1}},
+    {"OP_GET_FREE", {1}},
+    {"OP_CURRENT_CLOSURE", {}},
+    {"OP_ARRAY", {2}},
+    {"OP_HASH", {2}},
+    {"OP_INDEX", {}},
+    {"OP_CALL", {1}},
+    {"OP_RETURN_VALUE", {}},
+    {"OP_CLOSURE", {2, 1}}
+};
+
+const Definition& lookup(uint8_t op) {
+    return definitions[op];
+}
+
+Instructions make(op_code op, const std::vector<int>& operands) {
+    const auto& def = lookup(static_cast<uint8_t>(op));
+    Instructions ins;
+
+    ins.push_back(static_cast<uint8_t>(op));
+
+    for (size_t i = 0; i < def.operand_widths.size(); i++) {
+        const int operand = i < operands.size() ? operands[i] : 0;
+
+        switch (def.operand_widths[i])
+        {
+        case 2:
+            ins.push_back(static_cast<uint8_t>((operand >> 8) & 0xff));
+            ins.push_back(static_cast<uint8_t>(operand & 0xff));
+            break;
+        case 1:
+            ins.push_back(static_cast<uint8_t>(operand & 0xff));
+            break;
+        default:
+            break;
+        }
+    }
+
+    return ins;
+}
+
+int readUint16(const Instructions& ins, size_t offset) {
+    return (ins[offset] << 8) | ins[offset + 1];
+}
+
+int readUint8(const Instructions& ins, size_t offset) {
+    return ins[offset];
+}
+
+std::string toString(const Instructions& ins) {
+    std::string out;
+    size_t i = 0;
+
+    while (i < ins.size()) {
+        const auto& def = lookup(ins[i]);
+        out += std::to_string(i) + " " + def.name;
+
+        size_t offset = i + 1;
+        for (const int width : def.operand_widths) {
+            const int operand = width == 2 ? readUint16(ins, offset) : readUint8(ins, offset);
+            out += " " + std::to_string(operand);
+            offset += static_cast<size_t>(width);
+        }
+        out += "\n";
+
+        i = offset;
+    }
+
+    return out;
+}
+
+} // code
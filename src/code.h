@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bytecode used by the compiler and the VM. Every instruction is a one byte
+// opcode followed by its operands in big-endian order.
+
+enum op_code {
+    OP_CONSTANT,        // u16 constant index
+    OP_POP,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_EQ,
+    OP_NOT_EQ,
+    OP_LT,
+    OP_GT,
+    OP_MINUS,
+    OP_BANG,
+    OP_TRUE,
+    OP_FALSE,
+    OP_NIL,
+    OP_JUMP,            // u16 target
+    OP_JUMP_NOT_TRUTHY, // u16 target
+    OP_GET_GLOBAL,      // u16 global index
+    OP_SET_GLOBAL,      // u16 global index
+    OP_GET_LOCAL,       // u8 local index
+    OP_SET_LOCAL,       // u8 local index
+    OP_GET_FREE,        // u8 free variable index
+    OP_CURRENT_CLOSURE,
+    OP_ARRAY,           // u16 number of elements
+    OP_HASH,            // u16 number of keys + values
+    OP_INDEX,
+    OP_CALL,            // u8 number of arguments
+    OP_RETURN_VALUE,
+    OP_CLOSURE          // u16 constant index, u8 number of free variables
+};
+
+typedef std::vector<uint8_t> Instructions;
+
+struct Definition {
+    std::string name;
+    std::vector<int> operand_widths;
+};
+
+namespace code {
+
+const Definition& lookup(uint8_t op);
+
+Instructions make(op_code op, const std::vector<int>& operands = {});
+
+int readUint16(const Instructions& ins, size_t offset);
+int readUint8(const Instructions& ins, size_t offset);
+
+std::string toString(const Instructions& ins);
+
+} // code
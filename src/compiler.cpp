@@ -0,0 +1,357 @@
+#include "compiler.h"
+#include "builtin.h"
+
+Compiler::Compiler()
+    : m_symbol_table(std::make_shared<SymbolTable>()) {
+}
+
+bool Compiler::compile(const std::shared_ptr<Program>& program) {
+    m_errors.clear();
+    m_scopes.clear();
+    m_scopes.push_back({});
+
+    const auto& statements = program->getStatements();
+    for (const auto& statement : statements)
+        compileStatement(statement);
+
+    // A program ending with a let statement evaluates to nil
+    if (!statements.empty() && statements.back()->nodeType() == NODE_LET_STMNT) {
+        emit(OP_NIL);
+        emit(OP_POP);
+    }
+
+    return m_errors.empty();
+}
+
+Bytecode Compiler::bytecode() const {
+    return {m_scopes.back(), m_constants, m_symbol_table->names()};
+}
+
+void Compiler::compileNode(const ASTNodePtr& node) {
+    switch (node->nodeType())
+    {
+    case NODE_EXPR_STMNT:
+        compileNode(node->getExpr());
+        break;
+    case NODE_IDENT:
+        compileIdentifier(node);
+        break;
+    case NODE_INT:
+        emit(OP_CONSTANT, {addConstant(Value(node->getIntValue()))});
+        break;
+    case NODE_FLOAT:
+        emit(OP_CONSTANT, {addConstant(Value(node->getFloatValue()))});
+        break;
+    case NODE_STR:
+        emit(OP_CONSTANT, {addConstant(makeObject<String>(node->tokenLiteral()))});
+        break;
+    case NODE_BOOL:
+        emit(node->getBoolValue() ? OP_TRUE : OP_FALSE);
+        break;
+    case NODE_PREFIX: {
+        compileNode(node->getRight());
+
+        if (node->getOprtr() == OPRTR_BANG)
+            emit(OP_BANG);
+        else if (node->getOprtr() == OPRTR_SUB)
+            emit(OP_MINUS);
+        else
+            m_errors.push_back("unknown operator: " + node->tokenLiteral());
+        break;
+    }
+    case NODE_INFIX:
+        compileInfixExpr(node);
+        break;
+    case NODE_BLOCK_STMNT:
+        compileBlock(static_cast<BlockStatement*>(node));
+        break;
+    case NODE_IF_EXPR:
+        compileIfExpr(node);
+        break;
+    case NODE_FUNC:
+        compileFuncLiteral(node, "");
+        break;
+    case NODE_CALL_EXPR: {
+        compileNode(node->getFunc());
+
+        const auto& args = node->getArgs();
+        for (const auto& arg : args)
+            compileNode(arg);
+
+        emit(OP_CALL, {static_cast<int>(args.size())});
+        break;
+    }
+    case NODE_ARRAY: {
+        const auto& elements = node->getElements();
+        for (const auto& element : elements)
+            compileNode(element);
+
+        emit(OP_ARRAY, {static_cast<int>(elements.size())});
+        break;
+    }
+    case NODE_HASH: {
+        const auto& pairs = node->getPairs();
+        for (const auto& [key, value] : pairs) {
+            compileNode(key);
+            compileNode(value);
+        }
+
+        emit(OP_HASH, {static_cast<int>(pairs.size() * 2)});
+        break;
+    }
+    case NODE_INDEX:
+        compileNode(node->getLeft());
+        compileNode(node->getIndex());
+        emit(OP_INDEX);
+        break;
+    case NODE_INLINED_CALL:
+        // Functions made by the VM are never the ones inlined
+        compileNode(node->getCall());
+        break;
+    default:
+        m_errors.push_back("can't compile node: " + node_lut[static_cast<size_t>(node->nodeType())]);
+        break;
+    }
+}
+
+// Compiles a statement so that it leaves nothing on the stack
+void Compiler::compileStatement(Statement* statement) {
+    switch (statement->nodeType())
+    {
+    case NODE_LET_STMNT:
+        compileLetStatement(statement);
+        break;
+    case NODE_RETURN_STMNT:
+        compileNode(statement->getExpr());
+        emit(OP_RETURN_VALUE);
+        break;
+    default:
+        compileNode(statement);
+        emit(OP_POP);
+        break;
+    }
+}
+
+// Compiles a block so that it leaves exactly its value on the stack
+void Compiler::compileBlock(BlockStatement* block) {
+    const auto& statements = block->getStatements();
+
+    if (statements.empty()) {
+        emit(OP_NIL);
+        return;
+    }
+
+    const size_t n = statements.size();
+    for (size_t i = 0; i < n - 1; i++)
+        compileStatement(statements[i]);
+
+    auto last = statements[n - 1];
+    if (last->nodeType() == NODE_EXPR_STMNT) {
+        compileNode(last);
+    } else {
+        compileStatement(last);
+        emit(OP_NIL);
+    }
+}
+
+void Compiler::compileLetStatement(const ASTNodePtr& node) {
+    const std::string name = node->getIdentName();
+    auto value = node->getExpr();
+    const bool is_global = m_symbol_table->getOuter() == nullptr;
+
+    // Local functions refer to themselves through OP_CURRENT_CLOSURE, global
+    // ones simply through the global they are bound to.
+    if (!is_global && value->nodeType() == NODE_FUNC)
+        compileFuncLiteral(value, name);
+    else
+        compileNode(value);
+
+    const auto symbol = m_symbol_table->define(name);
+
+    if (symbol.scope == SCOPE_GLOBAL)
+        emit(OP_SET_GLOBAL, {symbol.index});
+    else
+        emit(OP_SET_LOCAL, {symbol.index});
+}
+
+void Compiler::compileIdentifier(const ASTNodePtr& node) {
+    const std::string name = node->getIdentName();
+    Symbol symbol;
+
+    if (m_symbol_table->resolve(name, symbol)) {
+        loadSymbol(symbol);
+        return;
+    }
+
+    auto builtin = builtinObject(name);
+    if (builtin) {
+        emit(OP_CONSTANT, {addConstant(builtin)});
+        return;
+    }
+
+    // Unknown names become globals that may be defined later. Reading one
+    // that is still undefined results in "identifier not found".
+    auto global_table = m_symbol_table;
+    while (global_table->getOuter())
+        global_table = global_table->getOuter();
+
+    loadSymbol(global_table->define(name));
+}
+
+void Compiler::compileInfixExpr(const ASTNodePtr& node) {
+    compileNode(node->getLeft());
+    compileNode(node->getRight());
+
+    switch (node->getOprtr())
+    {
+    case OPRTR_ADD:
+        emit(OP_ADD);
+        break;
+    case OPRTR_SUB:
+        emit(OP_SUB);
+        break;
+    case OPRTR_MUL:
+        emit(OP_MUL);
+        break;
+    case OPRTR_DIV:
+        emit(OP_DIV);
+        break;
+    case OPRTR_LT:
+        emit(OP_LT);
+        break;
+    case OPRTR_GT:
+        emit(OP_GT);
+        break;
+    case OPRTR_EQ:
+        emit(OP_EQ);
+        break;
+    case OPRTR_NOT_EQ:
+        emit(OP_NOT_EQ);
+        break;
+    default:
+        m_errors.push_back("unknown operator: " + node->tokenLiteral());
+        break;
+    }
+}
+
+void Compiler::compileIfExpr(const ASTNodePtr& node) {
+    compileNode(node->getCondition());
+
+    const size_t jump_not_truthy_pos = emit(OP_JUMP_NOT_TRUTHY, {0});
+    compileBlock(node->getConsequence());
+
+    const size_t jump_pos = emit(OP_JUMP, {0});
+    changeOperand(jump_not_truthy_pos, static_cast<int>(currentInstructions().size()));
+
+    auto alt = node->getAlternative();
+    if (alt)
+        compileBlock(alt);
+    else
+        emit(OP_NIL);
+
+    changeOperand(jump_pos, static_cast<int>(currentInstructions().size()));
+}
+
+void Compiler::compileFuncLiteral(const ASTNodePtr& node, const std::string& name) {
+    enterScope();
+
+    if (!name.empty())
+        m_symbol_table->defineFunctionName(name);
+
+    const auto& params = node->getParams();
+    for (const auto& param : params)
+        m_symbol_table->define(param.getIdentName());
+
+    compileBlock(node->getBody());
+    emit(OP_RETURN_VALUE);
+
+    const auto free_symbols = m_symbol_table->getFreeSymbols();
+    const int n_locals = m_symbol_table->nDefinitions();
+    auto instructions = leaveScope();
+
+    if (n_locals > 255 || free_symbols.size() > 255)
+        m_errors.push_back("too many local variables in function");
+
+    for (const auto& symbol : free_symbols)
+        loadSymbol(symbol);
+
+    auto func = makeObject<CompiledFunction>(instructions, n_locals, params, node->getBody(), node->getArena());
+
+    emit(OP_CLOSURE, {addConstant(func), static_cast<int>(free_symbols.size())});
+}
+
+void Compiler::loadSymbol(const Symbol& symbol) {
+    switch (symbol.scope)
+    {
+    case SCOPE_GLOBAL:
+        emit(OP_GET_GLOBAL, {symbol.index}); break;
+    case SCOPE_LOCAL:
+        emit(OP_GET_LOCAL, {symbol.index}); break;
+    case SCOPE_FREE:
+        emit(OP_GET_FREE, {symbol.index}); break;
+    case SCOPE_FUNCTION:
+        emit(OP_CURRENT_CLOSURE); break;
+    }
+}
+
+void Compiler::enterScope() {
+    m_scopes.push_back({});
+    m_symbol_table = std::make_shared<SymbolTable>(m_symbol_table);
+}
+
+Instructions Compiler::leaveScope() {
+    auto instructions = currentInstructions();
+
+    m_scopes.pop_back();
+    m_symbol_table = m_symbol_table->getOuter();
+
+    return instructions;
+}
+
+// Records an error for every operand too big for its width, which would
+// otherwise wrap around, like a jump past 65535 bytes or a 65536th global
+void Compiler::checkOperands(op_code op, const std::vector<int>& operands) {
+    const auto& definition = code::lookup(static_cast<uint8_t>(op));
+
+    for (size_t i = 0; i < operands.size() && i < definition.operand_widths.size(); i++) {
+        const long max_operand = (1L << (8 * definition.operand_widths[i])) - 1;
+
+        if (operands[i] < 0 || operands[i] > max_operand)
+            m_errors.push_back("operand of " + definition.name + " out of range: " + std::to_string(operands[i]));
+    }
+}
+
+void Compiler::changeOperand(size_t pos, int operand) {
+    auto& ins = currentInstructions();
+    checkOperands(static_cast<op_code>(ins[pos]), {operand});
+
+    const auto new_ins = code::make(static_cast<op_code>(ins[pos]), {operand});
+
+    for (size_t i = 0; i < new_ins.size(); i++)
+        ins[pos + i] = new_ins[i];
+}
+
+size_t Compiler::emit(op_code op, const std::vector<int>& operands) {
+    auto& instructions = currentInstructions();
+    const size_t pos = instructions.size();
+    checkOperands(op, operands);
+
+    const auto ins = code::make(op, operands);
+
+    instructions.insert(instructions.end(), ins.begin(), ins.end());
+
+    return pos;
+}
+
+int Compiler::addConstant(Value obj) {
+    if (m_constants.size() > 0xffff)
+        m_errors.push_back("too many constants");
+
+    m_constants.push_back(obj);
+
+    return static_cast<int>(m_constants.size()) - 1;
+}
+
+Instructions& Compiler::currentInstructions() {
+    return m_scopes.back();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ast.h"
+#include "code.h"
+#include "object.h"
+#include "symbol_table.h"
+
+struct Bytecode {
+    Instructions instructions;
+    std::vector<Value> constants;
+    std::vector<std::string> global_names;
+};
+
+// Compiles the AST into bytecode for the VM. The compiler keeps its constants
+// and global symbols between calls to compile(), so it can be fed one REPL
+// line at a time.
+class Compiler {
+    std::vector<Value> m_constants;
+    std::vector<Instructions> m_scopes;
+    SymbolTablePtr m_symbol_table;
+
+    std::vector<std::string> m_errors;
+
+public:
+    Compiler();
+
+    const std::vector<std::string> errors() const { return m_errors; }
+
+    bool compile(const std::shared_ptr<Program>& program);
+
+    Bytecode bytecode() const;
+
+    void compileNode(const ASTNodePtr& node);
+    void compileStatement(Statement* statement);
+    void compileBlock(BlockStatement* block);
+    void compileLetStatement(const ASTNodePtr& node);
+    void compileIdentifier(const ASTNodePtr& node);
+    void compileInfixExpr(const ASTNodePtr& node);
+    void compileIfExpr(const ASTNodePtr& node);
+    void compileFuncLiteral(const ASTNodePtr& node, const std::string& name);
+
+    void loadSymbol(const Symbol& symbol);
+    void enterScope();
+    void checkOperands(op_code op, const std::vector<int>& operands);
+    void changeOperand(size_t pos, int operand);
+
+    size_t emit(op_code op, const std::vector<int>& operands = {});
+    int addConstant(Value obj);
+
+    Instructions leaveScope();
+    Instructions& currentInstructions();
+};
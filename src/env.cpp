@@ -1,10 +1,10 @@
 #include "env.h"
 
-Env::Env(EnvPtr outer_env) 
-    : m_outer_env(outer_env) {
+Env::Env(EnvPtr outer_env, size_t n_slots) 
+    : m_slots(n_slots), m_outer_env(outer_env) {
 }
 
-ObjectPtr Env::get(const std::string& name) {
+Value Env::get(const std::string& name) {
     auto search = m_store.find(name);
 
     if (search != m_store.end())
@@ -15,8 +15,59 @@ ObjectPtr Env::get(const std::string& name) {
     return nullptr;
 }
 
-ObjectPtr Env::set(const std::string& name, ObjectPtr value) {
+Value Env::set(const std::string& name, Value value) {
     m_store[name] = value;
 
-    return std::make_shared<NIL>();
+    return Value::nil();
+}
+
+Value Env::getAt(int depth, int slot) {
+    Env* env = this;
+
+    for (int i = 0; i < depth && env; i++)
+        env = env->m_outer_env.get();
+
+    if (!env || static_cast<size_t>(slot) >= env->m_slots.size())
+        return nullptr;
+
+    return env->m_slots[static_cast<size_t>(slot)];
+}
+
+Value Env::setAt(int slot, Value value) {
+    if (static_cast<size_t>(slot) >= m_slots.size())
+        m_slots.resize(static_cast<size_t>(slot) + 1);
+
+    m_slots[static_cast<size_t>(slot)] = value;
+
+    return Value::nil();
+}
+
+Value Env::takeAt(int slot) {
+    if (static_cast<size_t>(slot) >= m_slots.size())
+        return nullptr;
+
+    return std::move(m_slots[static_cast<size_t>(slot)]);
+}
+
+void Env::reset() {
+    m_store.clear();
+
+    for (auto& value : m_slots)
+        value = nullptr;
+}
+
+void Env::trace(void (*visit)(HeapCell*)) const {
+    for (const auto& pair : m_store)
+        pair.second.trace(visit);
+    for (const auto& value : m_slots)
+        value.trace(visit);
+
+    if (m_outer_env)
+        visit(m_outer_env.get());
+}
+
+void Env::clearRefs() {
+    m_store.clear();
+    m_slots.clear();
+    m_outer_env = nullptr;
 }
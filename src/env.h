@@ -3,21 +3,38 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "object.h"
 
-typedef std::shared_ptr<Env> EnvPtr;
-
-class Env {
-    std::map<std::string, ObjectPtr> m_store;
+// Names not resolved to a lexical address live in m_store, resolved ones in
+// the flat m_slots vector of the function env that declares them.
+class Env: public HeapCell {
+    std::map<std::string, Value> m_store;
+    std::vector<Value> m_slots;
     EnvPtr m_outer_env;
 
 public:
     Env() = default;
-    Env(EnvPtr outer_env);
+    Env(EnvPtr outer_env, size_t n_slots = 0);
+
+    Value get(const std::string& name);
+    Value set(const std::string& name, Value value);
+
+    Value getAt(int depth, int slot);
+    Value setAt(int slot, Value value);
+
+    // Moves the value out of a slot of this env, leaving it empty
+    Value takeAt(int slot);
+
+    const std::map<std::string, Value>& getStore() const { return m_store; }
+
+    const EnvPtr& getOuter() const { return m_outer_env; }
+    size_t getSlotCount() const { return m_slots.size(); }
 
-    ObjectPtr get(const std::string& name);
-    ObjectPtr set(const std::string& name, ObjectPtr value);
+    // Empties the env so a new call of the same function can use it
+    void reset();
 
-    std::map<std::string, ObjectPtr> const getStore() { return m_store; }
+    void trace(void (*visit)(HeapCell*)) const override;
+    void clearRefs() override;
 };
@@ -1,11 +1,14 @@
 #include "evaluator.h"
 #include "builtin.h"
+#include "jit.h"
+#include "kernels.h"
 
+#include <algorithm>
 #include <iostream>
 
 namespace evaluator {
 
-ObjectPtr eval(const ASTNodePtr& node, EnvPtr env) {
+Value eval(const ASTNodePtr& node, EnvPtr env) {
     switch (node->nodeType())
     {
     case NODE_PROGRAM:
@@ -15,19 +18,19 @@ ObjectPtr eval(const ASTNodePtr& node, EnvPtr env) {
     case NODE_IDENT:
         return evalIdentifier(node, env);
     case NODE_INT:   
-        return std::make_shared<Integer>(node->getIntValue());
+        return Value(node->getIntValue());
     case NODE_FLOAT:
-        return std::make_shared<Float>(node->getFloatValue());
+        return Value(node->getFloatValue());
     case NODE_STR:
-        return std::make_shared<String>(node->tokenLiteral());
+        return makeObject<String>(node->tokenLiteral());
     case NODE_BOOL:
-        return std::make_shared<Bool>(node->getBoolValue());
+        return Value(node->getBoolValue());
     case NODE_PREFIX: {
         auto right = eval(node->getRight(), env);
         if (isError(right))
             return right;
 
-        return evalPrefixExpr(node->tokenLiteral(), right);
+        return evalPrefixExpr(node->getOprtr(), right);
     }
     case NODE_INFIX: {
         auto left = eval(node->getLeft(), env);
@@ -38,7 +41,7 @@ ObjectPtr eval(const ASTNodePtr& node, EnvPtr env) {
         if (isError(right))
             return right;
 
-        return evalInfixExpr(node->tokenLiteral(), left, right);
+        return evalInfixExpr(node->getOprtr(), left, right);
     }
     case NODE_BLOCK_STMNT:
         return evalBlock(node->getStatements(), env);
@@ -49,13 +52,16 @@ ObjectPtr eval(const ASTNodePtr& node, EnvPtr env) {
         if (isError(value))
             return value;
 
-        return std::make_shared<Return>(value);
+        return makeObject<Return>(value);
     }
     case NODE_LET_STMNT: {
         auto value = eval(node->getExpr(), env);
         if (isError(value))
             return value;
 
+        if (node->getSlot() >= 0)
+            return env->setAt(node->getSlot(), value);
+
         return env->set(node->getIdentName(), value);
     }
     case NODE_CALL_EXPR: {
@@ -63,23 +69,28 @@ ObjectPtr eval(const ASTNodePtr& node, EnvPtr env) {
         if (isError(func))
             return func;
 
-        auto args = evalExprs(node->getArgs(), env);
-        if (args.size() == 1 && isError(args[0]))
-            return args[0];
-        
-        return applyFunction(func, args);
+        return evalCall(node, func, env);
+    }
+    case NODE_INLINED_CALL: {
+        auto func = eval(node->getFunc(), env);
+        if (isError(func))
+            return func;
+
+        // The name may have been bound to something else since
+        if (isInlined(func, node))
+            return eval(node->getExpr(), env);
+
+        return evalCall(node->getCall(), func, env);
     }
     case NODE_FUNC: {
-        auto params = node->getParams();
-        auto body = node->getBody();
-        return std::make_shared<Function>(params, body, env);
+        return makeObject<Function>(node->getParams(), node->getBody(), node->getArena(), env, node->getSlotCount());
     }
     case NODE_ARRAY: {
         auto elements = evalExprs(node->getElements(), env);
         if (elements.size() == 1 && isError(elements[0]))
             return elements[0];
         
-        return std::make_shared<Array>(elements);
+        return makeObject<Array>(elements);
     }
     case NODE_HASH:
         return evalHashLiteral(node, env);
@@ -95,15 +106,20 @@ ObjectPtr eval(const ASTNodePtr& node, EnvPtr env) {
         return evalIndexExpr(left, index);
     }
     default:
-        return std::make_shared<NIL>();
+        return Value::nil();
     }
 }
 
-ObjectPtr evalProgram(std::vector<std::shared_ptr<Statement>> statements, EnvPtr env) {
-    std::shared_ptr<Object> result = nullptr;
+Value eval(const std::shared_ptr<Program>& program, EnvPtr env) {
+    return eval(program.get(), env);
+}
+
+Value evalProgram(const std::vector<Statement*>& statements, EnvPtr env) {
+    Value result = nullptr;
 
     for (auto& statement: statements) {
         result = eval(statement, env);
+        gc::maybeCollect();
 
         if (result->getType() == OBJ_RETURN)
             return result->getObjValue();
@@ -114,14 +130,15 @@ ObjectPtr evalProgram(std::vector<std::shared_ptr<Statement>> statements, EnvPtr
     return result;
 }
 
-ObjectPtr evalBlock(std::vector<std::shared_ptr<Statement>> statements, EnvPtr env) {
-    std::shared_ptr<Object> result = nullptr;
+Value evalBlock(const std::vector<Statement*>& statements, EnvPtr env) {
+    Value result = nullptr;
 
     if (statements.size() == 0)
-        return std::make_shared<NIL>();
+        return Value::nil();
 
     for (auto& statement: statements) {
         result = eval(statement, env);
+        gc::maybeCollect();
 
         if (result->getType() == OBJ_RETURN || result->getType() == OBJ_ERROR)
             return result;
@@ -130,117 +147,385 @@ ObjectPtr evalBlock(std::vector<std::shared_ptr<Statement>> statements, EnvPtr e
     return result;
 }
 
-ObjectPtr evalPrefixExpr(const std::string& oprtr, const ObjectPtr& right) {
-    if (oprtr == "!")
+Value evalPrefixExpr(int oprtr, const Value& right) {
+    if (oprtr == OPRTR_BANG)
         return evalBangOperator(right);
-    if (oprtr == "-")
+    if (oprtr == OPRTR_SUB)
         return evalMinusOperator(right);
 
-    return std::make_shared<Error>(("unknown operator: " + oprtr + right->typeString()));
+    return makeObject<Error>(("unknown operator: " + oprtr_lut[static_cast<size_t>(oprtr)] + right->typeString()));
+}
+
+bool divideInts(int left, int right, int& quotient) {
+    if (right == 0)
+        return false;
+
+    quotient = (right == -1) ? static_cast<int>(0u - static_cast<unsigned int>(left)) : left / right;
+    return true;
+}
+
+typedef Value (*InfixFunc)(int oprtr, const Value& left, const Value& right);
+
+const int N_OBJ_TYPES = OBJ_MEMO + 1;
+
+static Value unknownInfixOperator(int oprtr, const Value& left, const Value& right) {
+    return makeObject<Error>(("unknown operator: " + left->typeString() + oprtr_lut[static_cast<size_t>(oprtr)] + right->typeString()));
+}
+
+// Any other pair of types only compares truthiness
+static Value evalOtherInfixExpr(int oprtr, const Value& left, const Value& right) {
+    if (oprtr == OPRTR_EQ)
+        return Value(left->getBoolVal() == right->getBoolVal());
+    if (oprtr == OPRTR_NOT_EQ)
+        return Value(left->getBoolVal() != right->getBoolVal());
+
+    return unknownInfixOperator(oprtr, left, right);
 }
 
-ObjectPtr evalInfixExpr(const std::string& oprtr, const ObjectPtr& left, const ObjectPtr& right) {
-    if (left->getType() == OBJ_INT && right->getType() == OBJ_INT)
-        return evalIntInfixExpr(oprtr, left, right);
-    if (left->getType() == OBJ_INT && right->getType() == OBJ_FLOAT)
-        return evalFloatInfixExpr(oprtr, left, right);
-    if (left->getType() == OBJ_FLOAT && right->getType() == OBJ_INT)
-        return evalFloatInfixExpr(oprtr, left, right);
-    if (left->getType() == OBJ_FLOAT && right->getType() == OBJ_FLOAT)
-        return evalFloatInfixExpr(oprtr, left, right);
-    if (left->getType() == OBJ_STR && right->getType() == OBJ_STR)
-        return evalStringInfixExpr(oprtr, left, right);
-    if (oprtr == "==")
-        return std::make_shared<Bool>(left->getBoolVal() == right->getBoolVal());
-    if (oprtr == "!=")
-        return std::make_shared<Bool>(left->getBoolVal() != right->getBoolVal());
+template <int OPRTR>
+static Value evalIntInfixExpr(int oprtr, const Value& left, const Value& right) {
+    (void)oprtr;
+    const int left_value = left.asInt();
+    const int right_value = right.asInt();
 
-    return std::make_shared<Error>(("unknown operator: " + left->typeString() + oprtr + right->typeString()));
+    switch (OPRTR)
+    {
+    case OPRTR_ADD:
+        return Value(left_value + right_value);
+    case OPRTR_SUB:
+        return Value(left_value - right_value);
+    case OPRTR_MUL:
+        return Value(left_value * right_value);
+    case OPRTR_DIV: {
+        int quotient = 0;
+        if (!divideInts(left_value, right_value, quotient))
+            return makeObject<Error>("division by zero");
+
+        return Value(quotient);
+    }
+    case OPRTR_LT:
+        return Value(left_value < right_value);
+    case OPRTR_GT:
+        return Value(left_value > right_value);
+    case OPRTR_EQ:
+        return Value(left_value == right_value);
+    default:
+        return Value(left_value != right_value);
+    }
 }
 
-ObjectPtr evalBangOperator(const ObjectPtr& right) {
+// Ints are promoted when the other side is a float
+template <int OPRTR>
+static Value evalFloatInfixExpr(int oprtr, const Value& left, const Value& right) {
+    (void)oprtr;
+    const double left_value = left.getFloatVal();
+    const double right_value = right.getFloatVal();
+
+    switch (OPRTR)
+    {
+    case OPRTR_ADD:
+        return Value(left_value + right_value);
+    case OPRTR_SUB:
+        return Value(left_value - right_value);
+    case OPRTR_MUL:
+        return Value(left_value * right_value);
+    case OPRTR_DIV:
+        return Value(left_value / right_value);
+    case OPRTR_LT:
+        return Value(left_value < right_value);
+    case OPRTR_GT:
+        return Value(left_value > right_value);
+    case OPRTR_EQ:
+        return Value(left_value == right_value);
+    default:
+        return Value(left_value != right_value);
+    }
+}
+
+// Function for every operator and pair of operand types
+struct InfixTable {
+    InfixFunc funcs[N_OPRTRS][N_OBJ_TYPES][N_OBJ_TYPES];
+
+    template <int OPRTR>
+    void setNumeric() {
+        funcs[OPRTR][OBJ_INT][OBJ_INT] = evalIntInfixExpr<OPRTR>;
+        funcs[OPRTR][OBJ_INT][OBJ_FLOAT] = evalFloatInfixExpr<OPRTR>;
+        funcs[OPRTR][OBJ_FLOAT][OBJ_INT] = evalFloatInfixExpr<OPRTR>;
+        funcs[OPRTR][OBJ_FLOAT][OBJ_FLOAT] = evalFloatInfixExpr<OPRTR>;
+    }
+
+    InfixTable() {
+        for (int oprtr = 0; oprtr < N_OPRTRS; oprtr++) {
+            for (int left = 0; left < N_OBJ_TYPES; left++) {
+                for (int right = 0; right < N_OBJ_TYPES; right++) {
+                    InfixFunc func = evalOtherInfixExpr;
+
+                    if (left == OBJ_STR && right == OBJ_STR)
+                        func = evalStringInfixExpr;
+                    else if (left == OBJ_ARRAY || right == OBJ_ARRAY)
+                        func = evalArrayInfixExpr;
+
+                    funcs[oprtr][left][right] = func;
+                }
+            }
+        }
+
+        setNumeric<OPRTR_ADD>();
+        setNumeric<OPRTR_SUB>();
+        setNumeric<OPRTR_MUL>();
+        setNumeric<OPRTR_DIV>();
+        setNumeric<OPRTR_LT>();
+        setNumeric<OPRTR_GT>();
+        setNumeric<OPRTR_EQ>();
+        setNumeric<OPRTR_NOT_EQ>();
+
+        // ! and unknown operators never take two operands
+        for (int left = 0; left < N_OBJ_TYPES; left++) {
+            for (int right = 0; right < N_OBJ_TYPES; right++) {
+                funcs[OPRTR_UNKNOWN][left][right] = unknownInfixOperator;
+                funcs[OPRTR_BANG][left][right] = unknownInfixOperator;
+            }
+        }
+    }
+};
+
+static const InfixTable infix_table;
+
+Value evalInfixExpr(int oprtr, const Value& left, const Value& right) {
+    const int left_type = left->getType();
+    const int right_type = right->getType();
+
+    // Empty values have type -1
+    if (left_type < 0 || right_type < 0)
+        return evalOtherInfixExpr(oprtr, left, right);
+
+    return infix_table.funcs[oprtr][left_type][right_type](oprtr, left, right);
+}
+
+Value evalBangOperator(const Value& right) {
     switch (right->getType())
     {
     case OBJ_BOOL:
-        return std::make_shared<Bool>(!right->getBoolVal());
+        return Value(!right->getBoolVal());
     case OBJ_NIL:
-        return std::make_shared<Bool>(true);
+        return Value(true);
     default:
-        return std::make_shared<Bool>(false);
+        return Value(false);
     }
 }
 
-ObjectPtr evalMinusOperator(const ObjectPtr& right) {
+Value evalMinusOperator(const Value& right) {
     switch (right->getType())
     {
     case OBJ_INT:
-        return std::make_shared<Integer>(-right->getIntVal());
+        return Value(-right->getIntVal());
     case OBJ_FLOAT:
-        return std::make_shared<Float>(-right->getFloatVal());
+        return Value(-right->getFloatVal());
     default:
-        return std::make_shared<Error>(("unknown operator: -" + right->typeString())); 
+        return makeObject<Error>(("unknown operator: -" + right->typeString())); 
     }
 }
 
-ObjectPtr evalIntInfixExpr(const std::string& oprtr, const ObjectPtr& left, const ObjectPtr& right) {
-    int left_value = left->getIntVal();
-    int right_value = right->getIntVal();
-
-    if (oprtr == "+")
-        return std::make_shared<Integer>(left_value + right_value);
-    if (oprtr == "-")
-        return std::make_shared<Integer>(left_value - right_value);
-    if (oprtr == "*")
-        return std::make_shared<Integer>(left_value * right_value);
-    if (oprtr == "/")
-        return std::make_shared<Integer>(left_value / right_value);
-    if (oprtr == "<")
-        return std::make_shared<Bool>(left_value < right_value);
-    if (oprtr == ">")
-        return std::make_shared<Bool>(left_value > right_value);
-    if (oprtr == "==")
-        return std::make_shared<Bool>(left_value == right_value);
-    if (oprtr == "!=")
-        return std::make_shared<Bool>(left_value != right_value);
-
-    return std::make_shared<Error>(("unknown operator: " + left->typeString() + oprtr + right->typeString()));
-}
-
-ObjectPtr evalFloatInfixExpr(const std::string& oprtr, const ObjectPtr& left, const ObjectPtr& right) {
-    double left_value = left->getFloatVal();
-    double right_value = right->getFloatVal();
-
-    if (oprtr == "+")
-        return std::make_shared<Float>(left_value + right_value);
-    if (oprtr == "-")
-        return std::make_shared<Float>(left_value - right_value);
-    if (oprtr == "*")
-        return std::make_shared<Float>(left_value * right_value);
-    if (oprtr == "/")
-        return std::make_shared<Float>(left_value / right_value);
-    if (oprtr == "<")
-        return std::make_shared<Bool>(left_value < right_value);
-    if (oprtr == ">")
-        return std::make_shared<Bool>(left_value > right_value);
-    if (oprtr == "==")
-        return std::make_shared<Bool>(left_value == right_value);
-    if (oprtr == "!=")
-        return std::make_shared<Bool>(left_value != right_value);
-
-    return std::make_shared<Error>(("unknown operator: " + left->typeString() + oprtr + right->typeString()));
-}
-
-ObjectPtr evalStringInfixExpr(const std::string& oprtr, const ObjectPtr& left, const ObjectPtr& right) {
-    if (oprtr != "+")
-        return std::make_shared<Error>(("unknown operator: " + left->typeString() + oprtr + right->typeString()));
+Value evalStringInfixExpr(int oprtr, const Value& left, const Value& right) {
+    if (oprtr != OPRTR_ADD)
+        return unknownInfixOperator(oprtr, left, right);
     
-    auto left_str = left->getStrVal();
-    auto right_str = right->getStrVal();
+    return makeObject<String>(left->getStrVal() + right->getStrVal());
+}
+
+// One block of up to 32 values taking part in an array operation: a leaf
+// of an array, or a scalar repeated to the length of the block
+struct Operand {
+    const VectorNode* leaf {nullptr};
+    Value scalar;
+    leaf_kind kind {LEAF_BOXED};
+    const int32_t* ints {nullptr};
+    const double* floats {nullptr};
+
+    Value at(size_t index) const { return leaf ? leaf->at(index) : scalar; }
+};
+
+static Operand scalarOperand(const Value& value, int32_t* int_buffer, double* float_buffer) {
+    Operand operand;
+    operand.scalar = value;
+
+    if (value.isInt()) {
+        std::fill(int_buffer, int_buffer + VECTOR_WIDTH, value.asInt());
+        operand.kind = LEAF_INT;
+        operand.ints = int_buffer;
+    } else if (value.isFloat()) {
+        std::fill(float_buffer, float_buffer + VECTOR_WIDTH, value.asFloat());
+        operand.kind = LEAF_FLOAT;
+        operand.floats = float_buffer;
+    }
+
+    return operand;
+}
+
+static Operand leafOperand(const VectorNode& leaf, double* float_buffer) {
+    Operand operand;
+    operand.leaf = &leaf;
+    operand.kind = leaf.kind;
+    operand.ints = leaf.ints.data();
+
+    if (leaf.kind == LEAF_FLOAT)
+        operand.floats = leaf.floats(float_buffer);
 
-    return std::make_shared<String>(left_str + right_str);
+    return operand;
 }
 
-ObjectPtr evalIfExpr(const ASTNodePtr& node, EnvPtr env) {
+// The values of a numeric operand as doubles, ints are converted into buffer
+static const double* operandFloats(const Operand& operand, size_t n, double* buffer) {
+    if (operand.kind == LEAF_FLOAT)
+        return operand.floats;
+
+    for (size_t i = 0; i < n; i++)
+        buffer[i] = operand.ints[i];
+
+    return buffer;
+}
+
+// Applies op to a block of n values. Blocks of numbers go through the
+// kernels, anything else through evalInfixExpr one value at a time.
+static Value evalBlockOp(int oprtr, kernel_op op, const Operand& left, const Operand& right, size_t n, VectorNodePtr& result) {
+    const bool is_compare = op >= KERNEL_LT;
+    const bool both_ints = left.kind == LEAF_INT && right.kind == LEAF_INT;
+    const bool both_numbers = left.kind != LEAF_BOXED && right.kind != LEAF_BOXED;
+
+    if (both_ints && op == KERNEL_DIV) {
+        result->kind = LEAF_INT;
+        result->ints.resize(n);
+
+        // Same division as for two ints, which has no kernel
+        for (size_t i = 0; i < n; i++) {
+            if (!divideInts(left.ints[i], right.ints[i], result->ints[i]))
+                return makeObject<Error>("division by zero");
+        }
+    } else if (both_ints && !is_compare) {
+        result->kind = LEAF_INT;
+        result->ints.resize(n);
+        kernels::mapInts(op, left.ints, right.ints, result->ints.data(), n);
+    } else if (both_numbers) {
+        bool bools[VECTOR_WIDTH];
+        double floats[VECTOR_WIDTH];
+        double left_buffer[VECTOR_WIDTH];
+        double right_buffer[VECTOR_WIDTH];
+
+        if (both_ints) {
+            kernels::compareInts(op, left.ints, right.ints, bools, n);
+        } else {
+            const double* left_floats = operandFloats(left, n, left_buffer);
+            const double* right_floats = operandFloats(right, n, right_buffer);
+
+            if (is_compare)
+                kernels::compareFloats(op, left_floats, right_floats, bools, n);
+            else
+                kernels::mapFloats(op, left_floats, right_floats, floats, n);
+        }
+
+        result->values.reserve(n);
+        for (size_t i = 0; i < n; i++)
+            result->push(is_compare ? Value(bools[i]) : Value(floats[i]));
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            auto value = evalInfixExpr(oprtr, left.at(i), right.at(i));
+            if (isError(value))
+                return value;
+
+            result->push(value);
+        }
+    }
+
+    return nullptr;
+}
+
+// Elementwise op between two arrays of the same length, or an array and a
+// value that is broadcast to every element
+Value evalArrayInfixExpr(int oprtr, const Value& left, const Value& right) {
+    kernel_op op;
+
+    switch (oprtr)
+    {
+    case OPRTR_ADD:
+        op = KERNEL_ADD;
+        break;
+    case OPRTR_SUB:
+        op = KERNEL_SUB;
+        break;
+    case OPRTR_MUL:
+        op = KERNEL_MUL;
+        break;
+    case OPRTR_DIV:
+        op = KERNEL_DIV;
+        break;
+    case OPRTR_LT:
+        op = KERNEL_LT;
+        break;
+    case OPRTR_GT:
+        op = KERNEL_GT;
+        break;
+    case OPRTR_EQ:
+        op = KERNEL_EQ;
+        break;
+    case OPRTR_NOT_EQ:
+        op = KERNEL_NOT_EQ;
+        break;
+    default:
+        return unknownInfixOperator(oprtr, left, right);
+    }
+
+    const bool left_is_array = left->getType() == OBJ_ARRAY;
+    const bool right_is_array = right->getType() == OBJ_ARRAY;
+    const auto& elements = left_is_array ? left->getElements() : right->getElements();
+
+    if (left_is_array && right_is_array && left->getElements().size() != right->getElements().size())
+        return makeObject<Error>("arrays must have the same length, got=" + std::to_string(left->getElements().size()) + " and " + std::to_string(right->getElements().size()));
+
+    int32_t int_buffer[VECTOR_WIDTH];
+    double float_buffer[VECTOR_WIDTH];
+    double left_floats[VECTOR_WIDTH];
+    double right_floats[VECTOR_WIDTH];
+
+    // Scalars look the same in every block
+    const Operand left_scalar = left_is_array ? Operand() : scalarOperand(left, int_buffer, float_buffer);
+    const Operand right_scalar = right_is_array ? Operand() : scalarOperand(right, int_buffer, float_buffer);
+
+    PersistentVector result;
+
+    for (size_t index = 0; index < elements.size(); index += VECTOR_WIDTH) {
+        const Operand left_block = left_is_array ? leafOperand(*left->getElements().leafFor(index), left_floats) : left_scalar;
+        const Operand right_block = right_is_array ? leafOperand(*right->getElements().leafFor(index), right_floats) : right_scalar;
+        const size_t n = std::min(elements.size() - index, VECTOR_WIDTH);
+
+        auto leaf = makeRef<VectorNode>();
+        auto error = evalBlockOp(oprtr, op, left_block, right_block, n, leaf);
+        if (error)
+            return error;
+
+        result.appendLeaf(leaf);
+    }
+
+    return makeObject<Array>(std::move(result));
+}
+
+// Call node of func, which is already evaluated
+Value evalCall(const ASTNodePtr& node, Value func, EnvPtr env) {
+    auto args = evalExprs(node->getArgs(), env);
+    if (args.size() == 1 && isError(args[0]))
+        return args[0];
+
+    // Handed back to the applyFunction loop instead of nesting a call
+    if (node->isTailCall() && func->getType() == OBJ_FUNC)
+        return makeObject<TailCall>(func, args);
+
+    return applyFunction(std::move(func), std::move(args));
+}
+
+bool isInlined(const Value& func, const ASTNodePtr& inlined_call) {
+    return func->getType() == OBJ_FUNC && func->getBody() == inlined_call->getBody();
+}
+
+Value evalIfExpr(const ASTNodePtr& node, EnvPtr env) {
     auto cond = eval(node->getCondition(), env);
     if (isError(cond))
         return cond;
@@ -252,23 +537,34 @@ ObjectPtr evalIfExpr(const ASTNodePtr& node, EnvPtr env) {
     if (alt)
         return eval(alt, env);
 
-    return std::make_shared<NIL>();
+    return Value::nil();
 }
 
-ObjectPtr evalIdentifier(const ASTNodePtr& node, EnvPtr env) {
+Value evalIdentifier(const ASTNodePtr& node, EnvPtr env) {
+    if (node->getDepth() >= 0) {
+        // Nothing reads the slot again, so the env lets go of the value and
+        // whoever gets it next may be its only owner
+        auto value = node->isLastUse() ? env->takeAt(node->getSlot()) : env->getAt(node->getDepth(), node->getSlot());
+
+        if (value)
+            return value;
+    }
+
+    // Unresolved, or resolved to a local whose let hasn't run yet
     auto value = env->get(node->getIdentName());
 
     if (value)
         return value;
     
-    if (isBuiltIn(node->getIdentName()))
-        return std::make_shared<Builtin>(node->getIdentName());
+    auto builtin = builtinObject(node->getIdentName());
+    if (builtin)
+        return builtin;
 
-    return std::make_shared<Error>(("identifier not found: " + node->getIdentName()));
+    return makeObject<Error>(("identifier not found: " + node->getIdentName()));
 }
 
-std::vector<ObjectPtr> evalExprs(std::vector<ExprPtr> args, EnvPtr env) {
-    std::vector<ObjectPtr> result;
+std::vector<Value> evalExprs(const std::vector<ExprPtr>& args, EnvPtr env) {
+    std::vector<Value> result;
 
     for (auto& arg : args) {
         auto evaluated = eval(arg, env);
@@ -281,7 +577,7 @@ std::vector<ObjectPtr> evalExprs(std::vector<ExprPtr> args, EnvPtr env) {
     return result;
 }
 
-ObjectPtr evalIndexExpr(const ObjectPtr& left, const ObjectPtr& index) {
+Value evalIndexExpr(const Value& left, const Value& index) {
     if (left->getType() == OBJ_ARRAY && index->getType() == OBJ_INT)
         return evalArrayIndexExpr(left, index);
     if (left->getType() == OBJ_HASH)
@@ -289,44 +585,46 @@ ObjectPtr evalIndexExpr(const ObjectPtr& left, const ObjectPtr& index) {
     if (left->getType() == OBJ_STR && index->getType() == OBJ_INT)
         return evalStringIndexExpr(left, index);
 
-    return std::make_shared<Error>(("index operator not supported: " + left->typeString()));
+    return makeObject<Error>(("index operator not supported: " + left->typeString()));
 }
 
-ObjectPtr evalArrayIndexExpr(const ObjectPtr& array, const ObjectPtr& index) {
+Value evalArrayIndexExpr(const Value& array, const Value& index) {
     const size_t i = static_cast<size_t>(index->getIntVal());
-    const size_t max = array->getElements().size() - 1;
+    const auto& elements = array->getElements();
 
-    if (i < 0 || i > max)
-        return std::make_shared<NIL>();
+    // Negative indexes wrap around to huge ones
+    if (i >= elements.size())
+        return Value::nil();
 
-    return array->getElements()[i];
+    return elements[i];
 }
 
-ObjectPtr evalStringIndexExpr(const ObjectPtr& str, const ObjectPtr& index) {
+Value evalStringIndexExpr(const Value& str, const Value& index) {
     const size_t i = static_cast<size_t>(index->getIntVal());
-    const size_t max = str->getStrVal().length() - 1;
+    const auto& value = str->getStrVal();
+    const size_t max = value.length() - 1;
 
     if (i < 0 || i > max)
-        return std::make_shared<NIL>();
+        return Value::nil();
 
-    return std::make_shared<String>(std::string(1, str->getStrVal()[i]));
+    return charString(value[i]);
 }
 
-ObjectPtr evalHashIndexExpr(const ObjectPtr& hash, const ObjectPtr& index) {
+Value evalHashIndexExpr(const Value& hash, const Value& index) {
     int index_type = index->getType();
 
     if (index_type != OBJ_INT && index_type != OBJ_BOOL && index_type != OBJ_STR)
-        return std::make_shared<Error>(("unusable as hash key: " + index->typeString()));
+        return makeObject<Error>(("unusable as hash key: " + index->typeString()));
     
-    auto pair = hash->getPairAt(index->hashKey());
-    if (!pair)
-        return std::make_shared<NIL>();
+    auto value = hash->getValueAt(index);
+    if (!value)
+        return Value::nil();
 
-    return pair->value;
+    return value;
 }
 
-ObjectPtr evalHashLiteral(const ASTNodePtr& node, EnvPtr env) {
-    std::map<HashKey, HashPairPtr> pairs;
+Value evalHashLiteral(const ASTNodePtr& node, EnvPtr env) {
+    HashTable pairs;
 
     for (const auto& [key_node, value_node] : node->getPairs()) {
         auto key = eval(key_node, env);
@@ -340,63 +638,100 @@ ObjectPtr evalHashLiteral(const ASTNodePtr& node, EnvPtr env) {
         auto hashed = key->hashKey();
 
         if (hashed.type == OBJ_NIL)
-            return std::make_shared<Error>("unusable as hash key");
+            return makeObject<Error>("unusable as hash key");
 
-        auto pair = std::make_shared<HashPair>(key, value);
-        pairs[hashed] = pair;
+        pairs.set(hashed, key, value);
     }
 
-    return std::make_shared<Hash>(pairs);
+    return makeObject<Hash>(std::move(pairs));
 }
 
-ObjectPtr applyFunction(ObjectPtr func, std::vector<ObjectPtr> args) {
-    switch (func->getType())
-    {
-    case OBJ_FUNC: {
-        const size_t n_params = func->getParams().size();
-        const size_t n_args = args.size();
-        if (n_params != n_args)
-            return std::make_shared<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=" + std::to_string(n_params));
+// Tail calls run in a loop here: the body of each call may end in a
+// TailCall, which is then applied in place of the call that produced it.
+Value applyFunction(Value func, std::vector<Value> args) {
+    EnvPtr env;
+
+    while (true) {
+        switch (func->getType())
+        {
+        case OBJ_FUNC: {
+            Value jitted = nullptr;
+            if (jit::tryCall(func.as<Function>(), args, jitted))
+                return jitted;
+
+            const size_t n_params = func->getParams().size();
+            const size_t n_args = args.size();
+            if (n_params != n_args)
+                return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=" + std::to_string(n_params));
+
+            // Nothing else holds the previous call's env (no closure was made
+            // in it), so the next call of the same kind can reuse it
+            if (env && env->refs == 1 && env->getOuter() == func->getEnv() && env->getSlotCount() == static_cast<size_t>(func->getSlotCount())) {
+                env->reset();
+                bindParams(func, args, env);
+            } else {
+                env = extendFunctionEnv(func, args);
+            }
+
+            const auto native = func.as<Function>()->native;
+            auto evaluated = unwrapReturnValue(native ? Value::adoptBits(native(env.get())) : evalBlock(func->getBody()->getStatements(), env));
+            if (evaluated->getType() != OBJ_TAIL_CALL)
+                return evaluated;
+
+            auto tail_call = evaluated.as<TailCall>();
+            func = tail_call->func;
+            args = std::move(tail_call->args);
+            break;
+        }
+        case OBJ_BUILTIN: {
+            return callBuiltin(func, args);
+        }
+        case OBJ_MEMO: {
+            return callMemoized(func, args, applyFunction);
+        }
+        default:
+            return makeObject<Error>(("not a function: " + func->typeString()));
+        }
+    }
+}
 
-        auto extended_env = extendFunctionEnv(func, args);
-        auto evaluated = evalBlock(func->getBody()->getStatements(), extended_env);
+EnvPtr extendFunctionEnv(const Value& func, const std::vector<Value>& args) {
+    auto outer_env = func->getEnv();
+    const int n_slots = func->getSlotCount();
+    auto new_env = makeRef<Env>(outer_env, static_cast<size_t>(n_slots));
 
-        return unwrapReturnValue(evaluated);
-    }
-    case OBJ_BUILTIN: {
-        return getBuiltin(func->getStrVal(), args);
-    }
-    default:
-        return std::make_shared<Error>(("not a function: " + func->typeString()));
-    }
+    bindParams(func, args, new_env);
+
+    return new_env;
 }
 
-EnvPtr extendFunctionEnv(const ObjectPtr& func, std::vector<ObjectPtr> args) {
-    auto outer_env = func->getEnv().lock();
-    auto new_env = std::make_shared<Env>(outer_env);
-    auto params = func->getParams();
+void bindParams(const Value& func, const std::vector<Value>& args, const EnvPtr& env) {
+    const int n_slots = func->getSlotCount();
+    const auto& params = func->getParams();
     unsigned int i = 0;
 
+    // Resolved functions keep their params in the first slots
     for (const auto& param : params) {
-        new_env->set(param.getIdentName(), args[i]);
+        if (n_slots > 0)
+            env->setAt(static_cast<int>(i), args[i]);
+        else
+            env->set(param.getIdentName(), args[i]);
         i++;
     }
-
-    return new_env;
 }
 
-ObjectPtr unwrapReturnValue(ObjectPtr obj) {
+Value unwrapReturnValue(Value obj) {
     if (obj->getType() == OBJ_RETURN)
         return obj->getObjValue();
     
     return obj;
 }
 
-bool isTrue(const ObjectPtr& obj) {
+bool isTrue(const Value& obj) {
     return obj->getBoolVal();
 }
 
-bool isError(const ObjectPtr& obj) {
+bool isError(const Value& obj) {
     if (obj)
         return obj->getType() == OBJ_ERROR;
     
@@ -7,34 +7,42 @@
 
 namespace evaluator {
 
-ObjectPtr eval(const ASTNodePtr& node, EnvPtr env);
-ObjectPtr evalProgram(std::vector<std::shared_ptr<Statement>> statements, EnvPtr env);
-ObjectPtr evalBlock(std::vector<std::shared_ptr<Statement>> statements, EnvPtr env);
-ObjectPtr evalPrefixExpr(const std::string& oprtr, const ObjectPtr& right);
-ObjectPtr evalInfixExpr(const std::string& oprtr, const ObjectPtr& left, const ObjectPtr& right);
-ObjectPtr evalBangOperator(const ObjectPtr& right);
-ObjectPtr evalMinusOperator(const ObjectPtr& right);
-ObjectPtr evalIntInfixExpr(const std::string& oprtr, const ObjectPtr& left, const ObjectPtr& right);
-ObjectPtr evalFloatInfixExpr(const std::string& oprtr, const ObjectPtr& left, const ObjectPtr& right);
-ObjectPtr evalStringInfixExpr(const std::string& oprtr, const ObjectPtr& left, const ObjectPtr& right);
-ObjectPtr evalIfExpr(const ASTNodePtr& node, EnvPtr env);
-ObjectPtr evalIdentifier(const ASTNodePtr& node, EnvPtr env);
-ObjectPtr evalIndexExpr(const ObjectPtr& left, const ObjectPtr& index);
-ObjectPtr evalArrayIndexExpr(const ObjectPtr& array, const ObjectPtr& index);
-ObjectPtr evalStringIndexExpr(const ObjectPtr& str, const ObjectPtr& index);
-ObjectPtr evalHashIndexExpr(const ObjectPtr& hash, const ObjectPtr& index);
-ObjectPtr evalHashLiteral(const ASTNodePtr& node, EnvPtr env);
-
-ObjectPtr applyFunction(ObjectPtr func, std::vector<ObjectPtr> args);
-ObjectPtr unwrapReturnValue(ObjectPtr obj);
-
-ObjectPtr error(const std::string& format);
-
-std::vector<ObjectPtr> evalExprs(std::vector<ExprPtr> args, EnvPtr env);
-
-EnvPtr extendFunctionEnv(const ObjectPtr& func, std::vector<ObjectPtr> args);
-
-bool isTrue(const ObjectPtr& obj);
-bool isError(const ObjectPtr& obj);
+Value eval(const ASTNodePtr& node, EnvPtr env);
+Value eval(const std::shared_ptr<Program>& program, EnvPtr env);
+Value evalProgram(const std::vector<Statement*>& statements, EnvPtr env);
+Value evalBlock(const std::vector<Statement*>& statements, EnvPtr env);
+// oprtr is an oprtr_type
+Value evalPrefixExpr(int oprtr, const Value& right);
+Value evalInfixExpr(int oprtr, const Value& left, const Value& right);
+// Int division of every engine, false for a zero divisor. INT_MIN / -1
+// wraps around to INT_MIN like the other int operators instead of trapping.
+bool divideInts(int left, int right, int& quotient);
+Value evalBangOperator(const Value& right);
+Value evalMinusOperator(const Value& right);
+Value evalStringInfixExpr(int oprtr, const Value& left, const Value& right);
+Value evalArrayInfixExpr(int oprtr, const Value& left, const Value& right);
+Value evalCall(const ASTNodePtr& node, Value func, EnvPtr env);
+Value evalIfExpr(const ASTNodePtr& node, EnvPtr env);
+Value evalIdentifier(const ASTNodePtr& node, EnvPtr env);
+Value evalIndexExpr(const Value& left, const Value& index);
+Value evalArrayIndexExpr(const Value& array, const Value& index);
+Value evalStringIndexExpr(const Value& str, const Value& index);
+Value evalHashIndexExpr(const Value& hash, const Value& index);
+Value evalHashLiteral(const ASTNodePtr& node, EnvPtr env);
+
+Value applyFunction(Value func, std::vector<Value> args);
+Value unwrapReturnValue(Value obj);
+
+Value error(const std::string& format);
+
+std::vector<Value> evalExprs(const std::vector<ExprPtr>& args, EnvPtr env);
+
+EnvPtr extendFunctionEnv(const Value& func, const std::vector<Value>& args);
+void bindParams(const Value& func, const std::vector<Value>& args, const EnvPtr& env);
+
+bool isTrue(const Value& obj);
+bool isError(const Value& obj);
+// Whether func is a function of the literal inlined_call inlined
+bool isInlined(const Value& func, const ASTNodePtr& inlined_call);
 
 } // evaluator
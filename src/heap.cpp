@@ -0,0 +1,167 @@
+#include "heap.h"
+
+#include <vector>
+
+// Circular list holding every live cell
+struct HeapList {
+    HeapCell* head {nullptr};
+    size_t n_cells {0};
+    size_t n_allocated {0};
+    size_t threshold {1 << 14};
+    bool collecting {false};
+};
+
+static HeapList& heapList() {
+    // Leaked on purpose: static Values may outlive a destructed heap list
+    static HeapList* list = new HeapList();
+
+    return *list;
+}
+
+static std::vector<HeapCell*> worklist;
+
+static void decrementGcRefs(HeapCell* cell) {
+    cell->gc_refs--;
+}
+
+static void markReachable(HeapCell* cell) {
+    if (!cell->gc_reachable) {
+        cell->gc_reachable = true;
+        worklist.push_back(cell);
+    }
+}
+
+// Immortal cells are already off the list
+static void unlink(HeapCell* cell) {
+    auto& list = heapList();
+
+    if (!cell->gc_next)
+        return;
+
+    if (cell->gc_next == cell) {
+        list.head = nullptr;
+    } else {
+        cell->gc_prev->gc_next = cell->gc_next;
+        cell->gc_next->gc_prev = cell->gc_prev;
+
+        if (list.head == cell)
+            list.head = cell->gc_next;
+    }
+
+    cell->gc_next = nullptr;
+    cell->gc_prev = nullptr;
+    list.n_cells--;
+}
+
+HeapCell::HeapCell() {
+    auto& list = heapList();
+
+    if (list.head) {
+        gc_next = list.head;
+        gc_prev = list.head->gc_prev;
+        gc_prev->gc_next = this;
+        gc_next->gc_prev = this;
+    } else {
+        gc_next = this;
+        gc_prev = this;
+    }
+
+    list.head = this;
+    list.n_cells++;
+    list.n_allocated++;
+}
+
+HeapCell::~HeapCell() {
+    unlink(this);
+}
+
+namespace gc {
+
+// Trial deletion: a cell whose count is fully explained by references from
+// other cells can only be reached through the heap. Anything else is held by
+// a Value or Ref outside the heap (the evaluator's C++ stack, the REPL's
+// global env, the VM's stack and globals) and is a root. Cells not reachable
+// from a root are garbage.
+size_t collect() {
+    auto& list = heapList();
+
+    if (!list.head || list.collecting)
+        return 0;
+
+    list.collecting = true;
+    list.n_allocated = 0;
+
+    std::vector<HeapCell*> cells;
+    cells.reserve(list.n_cells);
+
+    HeapCell* cell = list.head;
+    do {
+        cell->gc_refs = cell->refs;
+        cell->gc_reachable = false;
+        cells.push_back(cell);
+        cell = cell->gc_next;
+    } while (cell != list.head);
+
+    for (auto c : cells)
+        c->trace(decrementGcRefs);
+
+    for (auto c : cells) {
+        if (c->gc_refs > 0)
+            markReachable(c);
+    }
+
+    while (!worklist.empty()) {
+        HeapCell* reachable = worklist.back();
+        worklist.pop_back();
+        reachable->trace(markReachable);
+    }
+
+    std::vector<HeapCell*> garbage;
+    for (auto c : cells) {
+        if (!c->gc_reachable)
+            garbage.push_back(c);
+    }
+
+    // Keep the garbage alive while the cycles are being cut, then let the
+    // reference counts free it
+    for (auto c : garbage)
+        c->refs++;
+    for (auto c : garbage)
+        c->clearRefs();
+    for (auto c : garbage) {
+        if (--c->refs == 0)
+            delete c;
+    }
+
+    list.collecting = false;
+
+    return garbage.size();
+}
+
+bool maybeCollect() {
+    if (heapList().n_allocated < heapList().threshold)
+        return false;
+
+    collect();
+
+    return true;
+}
+
+void makeImmortal(HeapCell* cell) {
+    unlink(cell);
+    cell->refs += IMMORTAL_REFS;
+}
+
+void setThreshold(size_t n_cells) {
+    heapList().threshold = n_cells;
+}
+
+size_t threshold() {
+    return heapList().threshold;
+}
+
+size_t tracked() {
+    return heapList().n_cells;
+}
+
+} // gc
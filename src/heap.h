@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+// Base of everything allocated on the language heap: objects and envs.
+// Cells are reference counted by the Values and Refs pointing to them and
+// freed as soon as the count drops to zero. Every live cell is also linked
+// into the heap so that gc::collect() can find and free reference cycles,
+// e.g. a function stored in the env it closes over.
+struct HeapCell {
+    mutable unsigned int refs {0};
+
+    HeapCell* gc_prev {nullptr};
+    HeapCell* gc_next {nullptr};
+    long gc_refs {0};
+    bool gc_reachable {false};
+
+    HeapCell();
+    HeapCell(const HeapCell&) = delete;
+    HeapCell& operator= (const HeapCell&) = delete;
+
+    // Calls visit for every cell this one holds a counted reference to
+    virtual void trace(void (*visit)(HeapCell*)) const { (void)visit; }
+
+    // Drops all references to other cells, used to break garbage cycles
+    virtual void clearRefs() {}
+
+    virtual ~HeapCell();
+};
+
+// Added to the count of immortal cells so that it never drops to zero
+const unsigned int IMMORTAL_REFS = 1u << 30;
+
+// Counted pointer to a heap cell that is not a Value, like Env
+template <typename T>
+class Ref {
+    T* m_ptr;
+
+    void retain() const {
+        if (m_ptr)
+            m_ptr->refs++;
+    }
+
+    void release() const {
+        if (m_ptr && --m_ptr->refs == 0)
+            delete m_ptr;
+    }
+
+public:
+    Ref() : m_ptr(nullptr) {}
+    Ref(std::nullptr_t) : m_ptr(nullptr) {}
+    explicit Ref(T* ptr) : m_ptr(ptr) { retain(); }
+
+    Ref(const Ref& other) : m_ptr(other.m_ptr) { retain(); }
+    Ref(Ref&& other) noexcept : m_ptr(other.m_ptr) { other.m_ptr = nullptr; }
+
+    Ref& operator= (const Ref& other) {
+        other.retain();
+        release();
+        m_ptr = other.m_ptr;
+
+        return *this;
+    }
+
+    Ref& operator= (Ref&& other) noexcept {
+        if (this != &other) {
+            release();
+            m_ptr = other.m_ptr;
+            other.m_ptr = nullptr;
+        }
+
+        return *this;
+    }
+
+    ~Ref() { release(); }
+
+    T* get() const { return m_ptr; }
+    T* operator-> () const { return m_ptr; }
+    T& operator* () const { return *m_ptr; }
+
+    explicit operator bool() const { return m_ptr != nullptr; }
+
+    friend bool operator== (const Ref& ref, std::nullptr_t) { return ref.m_ptr == nullptr; }
+    friend bool operator!= (const Ref& ref, std::nullptr_t) { return ref.m_ptr != nullptr; }
+    friend bool operator== (const Ref& a, const Ref& b) { return a.m_ptr == b.m_ptr; }
+    friend bool operator!= (const Ref& a, const Ref& b) { return a.m_ptr != b.m_ptr; }
+};
+
+template <typename T, typename... Args>
+Ref<T> makeRef(Args&&... args) {
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+namespace gc {
+
+// Frees every cell that is only reachable from other cells, returns how many
+size_t collect();
+
+// Runs collect() once threshold() cells have been allocated since the last
+// collection. Called by the evaluator between statements.
+bool maybeCollect();
+
+// Takes cell off the heap for good: it is never collected or freed. Used
+// for objects shared by the whole run, like builtins and one-char strings.
+void makeImmortal(HeapCell* cell);
+
+void setThreshold(size_t n_cells);
+size_t threshold();
+
+// Number of live cells
+size_t tracked();
+
+} // gc
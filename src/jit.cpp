@@ -0,0 +1,488 @@
+#include "jit.h"
+#include "ast.h"
+#include "env.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define JIT_X86_64
+#endif
+
+JitCode::~JitCode() {
+#ifdef JIT_X86_64
+    if (memory)
+        munmap(memory, size);
+#endif
+}
+
+namespace jit {
+
+static size_t jit_threshold = DEFAULT_JIT_THRESHOLD;
+
+void setThreshold(size_t n_calls) {
+    jit_threshold = n_calls;
+}
+
+size_t threshold() {
+    return jit_threshold;
+}
+
+#ifdef JIT_X86_64
+
+// Static type of what the code of a node leaves in eax
+enum jit_type {
+    JIT_NONE,   // differs between runs, or isn't a value the JIT handles
+    JIT_INT,
+    JIT_BOOL,
+    JIT_NIL,
+    JIT_RETURNS // never falls through: returns or tail calls
+};
+
+static jit_type mergeTypes(jit_type a, jit_type b) {
+    if (a == JIT_RETURNS)
+        return b;
+    if (b == JIT_RETURNS || a == b)
+        return a;
+
+    return JIT_NONE;
+}
+
+// Single pass code generator. Values live in eax, operands are saved on
+// the stack while the other side is computed, params in the frame at
+// [rbp - 8 * (slot + 1)].
+class FunctionCompiler {
+    const Function& m_func;
+    const int m_n_params;
+    const jit_type m_call_type; // assumed result of a call to itself
+
+    std::vector<uint8_t> m_code;
+    std::vector<size_t> m_returns; // rel32 of the jumps to the epilogue
+    size_t m_body_start {0};
+    int m_operand_depth {0};
+
+public:
+    jit_type return_type {JIT_RETURNS};
+    std::vector<std::string> callees;
+    bool calls_itself {false};
+    bool failed {false};
+
+    FunctionCompiler(const Function& func, jit_type call_type)
+        : m_func(func), m_n_params(static_cast<int>(func.params.size())), m_call_type(call_type) {
+    }
+
+    const std::vector<uint8_t>& code() const { return m_code; }
+
+    void compile();
+
+private:
+    void emit(std::initializer_list<uint8_t> bytes) { m_code.insert(m_code.end(), bytes); }
+
+    void emit32(int32_t value) {
+        uint8_t bytes[4];
+        std::memcpy(bytes, &value, 4);
+        m_code.insert(m_code.end(), bytes, bytes + 4);
+    }
+
+    // Emits a rel32 placeholder and returns where it is
+    size_t emitJump(std::initializer_list<uint8_t> op) {
+        emit(op);
+        emit32(0);
+        return m_code.size() - 4;
+    }
+
+    void patch(size_t rel, size_t target) {
+        const int32_t offset = static_cast<int32_t>(target) - static_cast<int32_t>(rel + 4);
+        std::memcpy(&m_code[rel], &offset, 4);
+    }
+
+    static int32_t slotOffset(int slot) { return -8 * (slot + 1); }
+
+    jit_type fail() {
+        failed = true;
+        return JIT_NONE;
+    }
+
+    jit_type genOperand(const ASTNodePtr& node);
+    jit_type genValue(const ASTNodePtr& node);
+    jit_type genBlock(const ASTNodePtr& block);
+    jit_type genIf(const ASTNodePtr& node);
+    jit_type genPrefix(const ASTNodePtr& node);
+    jit_type genInfix(const ASTNodePtr& node);
+    jit_type genCall(const ASTNodePtr& node);
+    jit_type genExpr(const ASTNodePtr& node);
+};
+
+void FunctionCompiler::compile() {
+    // push rbp; mov rbp, rsp; sub rsp, 8 * n_params
+    emit({0x55, 0x48, 0x89, 0xE5, 0x48, 0x81, 0xEC});
+    emit32(8 * m_n_params);
+
+    // mov rax, [rdi + 8 * (n - 1 - i)]; mov [rbp - 8 * (i + 1)], rax
+    for (int i = 0; i < m_n_params; i++) {
+        emit({0x48, 0x8B, 0x87});
+        emit32(8 * (m_n_params - 1 - i));
+        emit({0x48, 0x89, 0x85});
+        emit32(slotOffset(i));
+    }
+
+    m_body_start = m_code.size();
+
+    const jit_type body_type = genBlock(m_func.body);
+    return_type = mergeTypes(return_type, body_type);
+
+    if (return_type != JIT_INT && return_type != JIT_BOOL)
+        fail();
+
+    for (size_t rel : m_returns)
+        patch(rel, m_code.size());
+
+    // leave; ret
+    emit({0xC9, 0xC3});
+}
+
+// Value of a node that is used by another expression. A return inside it
+// wouldn't leave the function in the interpreter, so it isn't compiled.
+jit_type FunctionCompiler::genOperand(const ASTNodePtr& node) {
+    m_operand_depth++;
+    const jit_type type = genExpr(node);
+    m_operand_depth--;
+
+    if (type != JIT_INT && type != JIT_BOOL)
+        return fail();
+
+    return type;
+}
+
+// Value of an expression statement, which is the value of its block, or
+// of a return. Unlike an operand it can be a tail call, so it doesn't count
+// towards m_operand_depth.
+jit_type FunctionCompiler::genValue(const ASTNodePtr& node) {
+    switch (node->nodeType())
+    {
+    case NODE_IF_EXPR:
+        return genIf(node);
+    case NODE_CALL_EXPR: {
+        const jit_type type = genCall(node);
+        if (type != JIT_INT && type != JIT_BOOL && type != JIT_RETURNS)
+            return fail();
+
+        return type;
+    }
+    default:
+        return genOperand(node);
+    }
+}
+
+jit_type FunctionCompiler::genBlock(const ASTNodePtr& block) {
+    const auto& statements = block->getStatements();
+
+    if (statements.empty())
+        return JIT_NIL;
+
+    for (size_t i = 0; i < statements.size(); i++) {
+        const auto statement = statements[i];
+
+        if (statement->nodeType() == NODE_RETURN_STMNT) {
+            if (m_operand_depth > 0)
+                return fail();
+
+            return_type = mergeTypes(return_type, genValue(statement->getExpr()));
+            m_returns.push_back(emitJump({0xE9}));
+            return JIT_RETURNS;
+        }
+
+        if (statement->nodeType() != NODE_EXPR_STMNT)
+            return fail();
+
+        const jit_type type = genValue(statement->getExpr());
+
+        // The statements after it never run
+        if (type == JIT_RETURNS || i + 1 == statements.size())
+            return type;
+    }
+
+    return JIT_NIL;
+}
+
+jit_type FunctionCompiler::genIf(const ASTNodePtr& node) {
+    genOperand(node->getCondition());
+
+    // test eax, eax; je else
+    emit({0x85, 0xC0});
+    const size_t to_alt = emitJump({0x0F, 0x84});
+
+    const jit_type consequence = genBlock(node->getConsequence());
+    const size_t to_end = emitJump({0xE9});
+
+    patch(to_alt, m_code.size());
+    const jit_type alternative = node->getAlternative() ? genBlock(node->getAlternative()) : JIT_NIL;
+    patch(to_end, m_code.size());
+
+    return mergeTypes(consequence, alternative);
+}
+
+jit_type FunctionCompiler::genPrefix(const ASTNodePtr& node) {
+    const jit_type type = genOperand(node->getRight());
+
+    switch (node->getOprtr())
+    {
+    case OPRTR_SUB:
+        if (type != JIT_INT)
+            return fail();
+
+        emit({0xF7, 0xD8}); // neg eax
+        return JIT_INT;
+    case OPRTR_BANG:
+        // Like evaluator::evalBangOperator, ! of any int is false
+        if (type == JIT_BOOL)
+            emit({0x83, 0xF0, 0x01}); // xor eax, 1
+        else
+            emit({0x31, 0xC0});       // xor eax, eax
+        return JIT_BOOL;
+    default:
+        return fail();
+    }
+}
+
+jit_type FunctionCompiler::genInfix(const ASTNodePtr& node) {
+    const jit_type left = genOperand(node->getLeft());
+    emit({0x50}); // push rax
+    const jit_type right = genOperand(node->getRight());
+    emit({0x89, 0xC1, 0x58}); // mov ecx, eax; pop rax
+
+    if (failed)
+        return JIT_NONE;
+
+    const int oprtr = node->getOprtr();
+
+    if (left == JIT_INT && right == JIT_INT) {
+        switch (oprtr)
+        {
+        case OPRTR_ADD:
+            emit({0x01, 0xC8}); // add eax, ecx
+            return JIT_INT;
+        case OPRTR_SUB:
+            emit({0x29, 0xC8}); // sub eax, ecx
+            return JIT_INT;
+        case OPRTR_MUL:
+            emit({0x0F, 0xAF, 0xC1}); // imul eax, ecx
+            return JIT_INT;
+        case OPRTR_DIV: {
+            // idiv traps where the interpreter gives an error for a zero
+            // divisor and wraps INT_MIN / -1, so only other literals divide
+            const auto divisor = node->getRight();
+            if (divisor->nodeType() != NODE_INT || divisor->getIntValue() == 0 || divisor->getIntValue() == -1)
+                return fail();
+
+            emit({0x99, 0xF7, 0xF9}); // cdq; idiv ecx
+            return JIT_INT;
+        }
+        default:
+            break;
+        }
+    } else if (oprtr == OPRTR_EQ || oprtr == OPRTR_NOT_EQ) {
+        // Other types only compare truthiness, see evaluator::evalInfixExpr
+        if (left == JIT_INT)
+            emit({0x85, 0xC0, 0x0F, 0x95, 0xC0, 0x0F, 0xB6, 0xC0}); // test eax, eax; setne al; movzx eax, al
+        if (right == JIT_INT)
+            emit({0x85, 0xC9, 0x0F, 0x95, 0xC1, 0x0F, 0xB6, 0xC9}); // test ecx, ecx; setne cl; movzx ecx, cl
+    } else {
+        return fail();
+    }
+
+    uint8_t setcc;
+
+    switch (oprtr)
+    {
+    case OPRTR_LT:
+        setcc = 0x9C;
+        break;
+    case OPRTR_GT:
+        setcc = 0x9F;
+        break;
+    case OPRTR_EQ:
+        setcc = 0x94;
+        break;
+    case OPRTR_NOT_EQ:
+        setcc = 0x95;
+        break;
+    default:
+        return fail();
+    }
+
+    // cmp eax, ecx; setcc al; movzx eax, al
+    emit({0x39, 0xC8, 0x0F, setcc, 0xC0, 0x0F, 0xB6, 0xC0});
+    return JIT_BOOL;
+}
+
+// Only calls of the function itself by a global name are compiled
+jit_type FunctionCompiler::genCall(const ASTNodePtr& node) {
+    const auto callee = node->getFunc();
+
+    if (callee->nodeType() != NODE_IDENT || callee->getDepth() >= 0)
+        return fail();
+
+    const std::string name = callee->getIdentName();
+    auto bound = m_func.env ? m_func.env->get(name) : Value(nullptr);
+
+    if (!bound.isObject() || bound.asObject() != &m_func || node->getArgs().size() != static_cast<size_t>(m_n_params))
+        return fail();
+
+    if (std::find(callees.begin(), callees.end(), name) == callees.end())
+        callees.push_back(name);
+
+    for (const auto arg : node->getArgs()) {
+        if (genOperand(arg) != JIT_INT)
+            return fail();
+
+        emit({0x50}); // push rax
+    }
+
+    // Returning the call's value as is: the params are replaced and the
+    // body starts over, like the tail call loop of applyFunction
+    if (node->isTailCall() && m_operand_depth == 0) {
+        for (int i = m_n_params - 1; i >= 0; i--) {
+            emit({0x58, 0x48, 0x89, 0x85}); // pop rax; mov [rbp - 8 * (i + 1)], rax
+            emit32(slotOffset(i));
+        }
+
+        patch(emitJump({0xE9}), m_body_start);
+        return JIT_RETURNS;
+    }
+
+    calls_itself = true;
+
+    // mov rdi, rsp; call start; add rsp, 8 * n_params
+    emit({0x48, 0x89, 0xE7});
+    patch(emitJump({0xE8}), 0);
+    emit({0x48, 0x81, 0xC4});
+    emit32(8 * m_n_params);
+
+    return m_call_type;
+}
+
+jit_type FunctionCompiler::genExpr(const ASTNodePtr& node) {
+    switch (node->nodeType())
+    {
+    case NODE_INT:
+        emit({0xB8}); // mov eax, imm32
+        emit32(node->getIntValue());
+        return JIT_INT;
+    case NODE_BOOL:
+        emit({0xB8});
+        emit32(node->getBoolValue() ? 1 : 0);
+        return JIT_BOOL;
+    case NODE_IDENT:
+        if (node->getDepth() != 0 || node->getSlot() < 0 || node->getSlot() >= m_n_params)
+            return fail();
+
+        emit({0x8B, 0x85}); // mov eax, [rbp - 8 * (slot + 1)]
+        emit32(slotOffset(node->getSlot()));
+        return JIT_INT;
+    case NODE_PREFIX:
+        return genPrefix(node);
+    case NODE_INFIX:
+        return genInfix(node);
+    case NODE_IF_EXPR:
+        return genIf(node);
+    case NODE_CALL_EXPR:
+        return genCall(node);
+    default:
+        return fail();
+    }
+}
+
+std::unique_ptr<JitCode> compile(const Function& func) {
+    if (!func.body)
+        return nullptr;
+
+    // Calls of itself return what the function returns, which is known
+    // only once the body is compiled, so both are tried
+    for (const jit_type call_type : {JIT_INT, JIT_BOOL}) {
+        FunctionCompiler compiler(func, call_type);
+        compiler.compile();
+
+        if (compiler.failed || (compiler.calls_itself && compiler.return_type != call_type))
+            continue;
+
+        const auto& code = compiler.code();
+        const long page_size = sysconf(_SC_PAGESIZE);
+        const size_t size = (code.size() + static_cast<size_t>(page_size) - 1) / static_cast<size_t>(page_size) * static_cast<size_t>(page_size);
+
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return nullptr;
+
+        auto jitted = std::make_unique<JitCode>();
+        jitted->memory = memory;
+        jitted->size = size;
+
+        // Never writable and executable at once
+        std::memcpy(memory, code.data(), code.size());
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+            return nullptr;
+
+        jitted->entry = reinterpret_cast<int64_t (*)(const int64_t*)>(memory);
+        jitted->n_params = func.params.size();
+        jitted->returns_bool = compiler.return_type == JIT_BOOL;
+        jitted->callees = compiler.callees;
+
+        return jitted;
+    }
+
+    return nullptr;
+}
+
+#else
+
+std::unique_ptr<JitCode> compile(const Function& func) {
+    (void)func;
+    return nullptr;
+}
+
+#endif
+
+bool tryCall(Function* func, const std::vector<Value>& args, Value& result) {
+    if (jit_threshold == 0)
+        return false;
+
+    if (!func->jit) {
+        // Compiled at most once, when the count reaches the threshold
+        if (func->n_calls >= jit_threshold || ++func->n_calls < jit_threshold)
+            return false;
+
+        func->jit = compile(*func);
+        if (!func->jit)
+            return false;
+    }
+
+    const JitCode& code = *func->jit;
+
+    if (args.size() != code.n_params)
+        return false;
+
+    for (const auto& name : code.callees) {
+        auto bound = func->env->get(name);
+        if (!bound.isObject() || bound.asObject() != func)
+            return false;
+    }
+
+    std::vector<int64_t> native_args(std::max<size_t>(code.n_params, 1));
+
+    for (size_t i = 0; i < args.size(); i++) {
+        if (!args[i].isInt())
+            return false;
+
+        native_args[code.n_params - 1 - i] = args[i].asInt();
+    }
+
+    const int64_t value = code.entry(native_args.data());
+    result = code.returns_bool ? Value(value != 0) : Value(static_cast<int>(static_cast<int32_t>(value)));
+
+    return true;
+}
+
+} // jit
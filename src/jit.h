@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "object.h"
+
+// Native code of a function, in its own executable mapping. args holds the
+// arguments in reverse order, the result is an int or 0/1 for a bool.
+struct JitCode {
+    void* memory {nullptr};
+    size_t size {0};
+    int64_t (*entry)(const int64_t* args) {nullptr};
+    size_t n_params {0};
+    bool returns_bool {false};
+    std::vector<std::string> callees; // names the body calls itself by
+
+    JitCode() = default;
+    JitCode(const JitCode&) = delete;
+    JitCode& operator= (const JitCode&) = delete;
+
+    ~JitCode();
+};
+
+const size_t DEFAULT_JIT_THRESHOLD = 1000;
+
+// Baseline x86-64 JIT for small functions of ints: once a Function has been
+// called threshold times, its body is compiled to native code if it only
+// uses its params, int and bool literals, arithmetic, comparisons, ifs,
+// returns and calls to itself. Every call then checks that the arguments
+// are ints and that the names the body calls itself by still refer to it,
+// and runs the native code. Elsewhere than on x86-64 Linux nothing is ever
+// compiled.
+namespace jit {
+
+// 0 turns the JIT off
+void setThreshold(size_t n_calls);
+size_t threshold();
+
+// nullptr if the body of func can't be compiled
+std::unique_ptr<JitCode> compile(const Function& func);
+
+// Counts the call and runs the native code of func when it has it and the
+// guards pass. Returns false when the caller has to run the call itself.
+bool tryCall(Function* func, const std::vector<Value>& args, Value& result);
+
+} // jit
@@ -0,0 +1,394 @@
+#include "kernels.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define KERNELS_AVX2
+#endif
+
+namespace kernels {
+
+#ifdef KERNELS_AVX2
+
+static bool hasAvx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+
+__attribute__((target("avx2")))
+static __m256i loadInts(const int32_t* values) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+}
+
+__attribute__((target("avx2")))
+static int64_t sumIntsAvx2(const int32_t* values, size_t n) {
+    __m256i sums = _mm256_setzero_si256();
+    size_t i = 0;
+
+    // Widened to 64 bits so the sum is exact
+    for (; i + 8 <= n; i += 8) {
+        const __m256i block = loadInts(values + i);
+        sums = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(block)));
+        sums = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(block, 1)));
+    }
+
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sums);
+    int64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    for (; i < n; i++)
+        sum += values[i];
+
+    return sum;
+}
+
+__attribute__((target("avx2")))
+static double sumFloatsAvx2(const double* values, size_t n) {
+    __m256d sums = _mm256_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        sums = _mm256_add_pd(sums, _mm256_loadu_pd(values + i));
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sums);
+    double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+    for (; i < n; i++)
+        sum += values[i];
+
+    return sum;
+}
+
+__attribute__((target("avx2")))
+static int32_t minMaxIntsAvx2(const int32_t* values, size_t n, bool is_max) {
+    __m256i best = _mm256_set1_epi32(values[0]);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        const __m256i block = loadInts(values + i);
+        best = is_max ? _mm256_max_epi32(best, block) : _mm256_min_epi32(best, block);
+    }
+
+    int32_t lanes[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), best);
+    int32_t result = lanes[0];
+
+    for (int lane = 1; lane < 8; lane++)
+        result = (is_max ? lanes[lane] > result : lanes[lane] < result) ? lanes[lane] : result;
+    for (; i < n; i++)
+        result = (is_max ? values[i] > result : values[i] < result) ? values[i] : result;
+
+    return result;
+}
+
+__attribute__((target("avx2")))
+static double minMaxFloatsAvx2(const double* values, size_t n, bool is_max) {
+    __m256d best = _mm256_set1_pd(values[0]);
+    size_t i = 0;
+
+    // min_pd(a, b) is a < b ? a : b, so a NaN block value keeps best
+    for (; i + 4 <= n; i += 4) {
+        const __m256d block = _mm256_loadu_pd(values + i);
+        best = is_max ? _mm256_max_pd(block, best) : _mm256_min_pd(block, best);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, best);
+    double result = lanes[0];
+
+    for (int lane = 1; lane < 4; lane++)
+        result = (is_max ? lanes[lane] > result : lanes[lane] < result) ? lanes[lane] : result;
+    for (; i < n; i++)
+        result = (is_max ? values[i] > result : values[i] < result) ? values[i] : result;
+
+    return result;
+}
+
+__attribute__((target("avx2")))
+static int32_t dotIntsAvx2(const int32_t* a, const int32_t* b, size_t n) {
+    __m256i sums = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+        sums = _mm256_add_epi32(sums, _mm256_mullo_epi32(loadInts(a + i), loadInts(b + i)));
+
+    uint32_t lanes[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sums);
+    uint32_t sum = 0;
+
+    for (int lane = 0; lane < 8; lane++)
+        sum += lanes[lane];
+    for (; i < n; i++)
+        sum += static_cast<uint32_t>(a[i]) * static_cast<uint32_t>(b[i]);
+
+    return static_cast<int32_t>(sum);
+}
+
+__attribute__((target("avx2")))
+static double dotFloatsAvx2(const double* a, const double* b, size_t n) {
+    __m256d sums = _mm256_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        sums = _mm256_add_pd(sums, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sums);
+    double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+    for (; i < n; i++)
+        sum += a[i] * b[i];
+
+    return sum;
+}
+
+__attribute__((target("avx2")))
+static void mapIntsAvx2(kernel_op op, const int32_t* a, const int32_t* b, int32_t* out, size_t n) {
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        const __m256i x = loadInts(a + i);
+        const __m256i y = loadInts(b + i);
+        __m256i result;
+
+        switch (op)
+        {
+        case KERNEL_ADD:
+            result = _mm256_add_epi32(x, y);
+            break;
+        case KERNEL_SUB:
+            result = _mm256_sub_epi32(x, y);
+            break;
+        default:
+            result = _mm256_mullo_epi32(x, y);
+            break;
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), result);
+    }
+
+    if (i < n)
+        mapInts(op, a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void mapFloatsAvx2(kernel_op op, const double* a, const double* b, double* out, size_t n) {
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        const __m256d x = _mm256_loadu_pd(a + i);
+        const __m256d y = _mm256_loadu_pd(b + i);
+        __m256d result;
+
+        switch (op)
+        {
+        case KERNEL_ADD:
+            result = _mm256_add_pd(x, y);
+            break;
+        case KERNEL_SUB:
+            result = _mm256_sub_pd(x, y);
+            break;
+        case KERNEL_MUL:
+            result = _mm256_mul_pd(x, y);
+            break;
+        default:
+            result = _mm256_div_pd(x, y);
+            break;
+        }
+
+        _mm256_storeu_pd(out + i, result);
+    }
+
+    if (i < n)
+        mapFloats(op, a + i, b + i, out + i, n - i);
+}
+
+#endif
+
+// Scalar loops, written with the switch outside so that each one vectorizes
+template <typename T, typename U, typename F>
+static void mapLoop(const T* a, const T* b, U* out, size_t n, F f) {
+    for (size_t i = 0; i < n; i++)
+        out[i] = f(a[i], b[i]);
+}
+
+int64_t sumInts(const int32_t* values, size_t n) {
+#ifdef KERNELS_AVX2
+    if (hasAvx2())
+        return sumIntsAvx2(values, n);
+#endif
+
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += values[i];
+
+    return sum;
+}
+
+double sumFloats(const double* values, size_t n) {
+#ifdef KERNELS_AVX2
+    if (hasAvx2())
+        return sumFloatsAvx2(values, n);
+#endif
+
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += values[i];
+
+    return sum;
+}
+
+int32_t minInts(const int32_t* values, size_t n) {
+#ifdef KERNELS_AVX2
+    if (hasAvx2())
+        return minMaxIntsAvx2(values, n, false);
+#endif
+
+    int32_t min = values[0];
+    for (size_t i = 1; i < n; i++)
+        min = values[i] < min ? values[i] : min;
+
+    return min;
+}
+
+int32_t maxInts(const int32_t* values, size_t n) {
+#ifdef KERNELS_AVX2
+    if (hasAvx2())
+        return minMaxIntsAvx2(values, n, true);
+#endif
+
+    int32_t max = values[0];
+    for (size_t i = 1; i < n; i++)
+        max = values[i] > max ? values[i] : max;
+
+    return max;
+}
+
+double minFloats(const double* values, size_t n) {
+#ifdef KERNELS_AVX2
+    if (hasAvx2())
+        return minMaxFloatsAvx2(values, n, false);
+#endif
+
+    double min = values[0];
+    for (size_t i = 1; i < n; i++)
+        min = values[i] < min ? values[i] : min;
+
+    return min;
+}
+
+double maxFloats(const double* values, size_t n) {
+#ifdef KERNELS_AVX2
+    if (hasAvx2())
+        return minMaxFloatsAvx2(values, n, true);
+#endif
+
+    double max = values[0];
+    for (size_t i = 1; i < n; i++)
+        max = values[i] > max ? values[i] : max;
+
+    return max;
+}
+
+int32_t dotInts(const int32_t* a, const int32_t* b, size_t n) {
+#ifdef KERNELS_AVX2
+    if (hasAvx2())
+        return dotIntsAvx2(a, b, n);
+#endif
+
+    uint32_t sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += static_cast<uint32_t>(a[i]) * static_cast<uint32_t>(b[i]);
+
+    return static_cast<int32_t>(sum);
+}
+
+double dotFloats(const double* a, const double* b, size_t n) {
+#ifdef KERNELS_AVX2
+    if (hasAvx2())
+        return dotFloatsAvx2(a, b, n);
+#endif
+
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += a[i] * b[i];
+
+    return sum;
+}
+
+void mapInts(kernel_op op, const int32_t* a, const int32_t* b, int32_t* out, size_t n) {
+#ifdef KERNELS_AVX2
+    if (n >= 8 && hasAvx2()) {
+        mapIntsAvx2(op, a, b, out, n);
+        return;
+    }
+#endif
+
+    // Unsigned so that overflow wraps around
+    switch (op)
+    {
+    case KERNEL_ADD:
+        mapLoop(a, b, out, n, [](int32_t x, int32_t y) { return static_cast<int32_t>(static_cast<uint32_t>(x) + static_cast<uint32_t>(y)); });
+        break;
+    case KERNEL_SUB:
+        mapLoop(a, b, out, n, [](int32_t x, int32_t y) { return static_cast<int32_t>(static_cast<uint32_t>(x) - static_cast<uint32_t>(y)); });
+        break;
+    default:
+        mapLoop(a, b, out, n, [](int32_t x, int32_t y) { return static_cast<int32_t>(static_cast<uint32_t>(x) * static_cast<uint32_t>(y)); });
+        break;
+    }
+}
+
+void mapFloats(kernel_op op, const double* a, const double* b, double* out, size_t n) {
+#ifdef KERNELS_AVX2
+    if (n >= 4 && hasAvx2()) {
+        mapFloatsAvx2(op, a, b, out, n);
+        return;
+    }
+#endif
+
+    switch (op)
+    {
+    case KERNEL_ADD:
+        mapLoop(a, b, out, n, [](double x, double y) { return x + y; });
+        break;
+    case KERNEL_SUB:
+        mapLoop(a, b, out, n, [](double x, double y) { return x - y; });
+        break;
+    case KERNEL_MUL:
+        mapLoop(a, b, out, n, [](double x, double y) { return x * y; });
+        break;
+    default:
+        mapLoop(a, b, out, n, [](double x, double y) { return x / y; });
+        break;
+    }
+}
+
+template <typename T>
+static void compareLoop(kernel_op op, const T* a, const T* b, bool* out, size_t n) {
+    switch (op)
+    {
+    case KERNEL_LT:
+        mapLoop(a, b, out, n, [](T x, T y) { return x < y; });
+        break;
+    case KERNEL_GT:
+        mapLoop(a, b, out, n, [](T x, T y) { return x > y; });
+        break;
+    case KERNEL_EQ:
+        mapLoop(a, b, out, n, [](T x, T y) { return x == y; });
+        break;
+    default:
+        mapLoop(a, b, out, n, [](T x, T y) { return x != y; });
+        break;
+    }
+}
+
+void compareInts(kernel_op op, const int32_t* a, const int32_t* b, bool* out, size_t n) {
+    compareLoop(op, a, b, out, n);
+}
+
+void compareFloats(kernel_op op, const double* a, const double* b, bool* out, size_t n) {
+    compareLoop(op, a, b, out, n);
+}
+
+} // kernels
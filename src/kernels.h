@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Loops over contiguous buffers of numbers, used by the array builtins. On
+// x86-64 they run with AVX2 when the CPU has it, elsewhere they are plain
+// loops left to the compiler. Float results are added up lane by lane, so
+// their last bits can differ from adding the values in order.
+enum kernel_op {
+    KERNEL_ADD,
+    KERNEL_SUB,
+    KERNEL_MUL,
+    KERNEL_DIV,
+    KERNEL_LT,
+    KERNEL_GT,
+    KERNEL_EQ,
+    KERNEL_NOT_EQ
+};
+
+namespace kernels {
+
+int64_t sumInts(const int32_t* values, size_t n);
+double sumFloats(const double* values, size_t n);
+
+// n must be > 0. A NaN never replaces the current min or max, like in a
+// loop of value < min comparisons.
+int32_t minInts(const int32_t* values, size_t n);
+int32_t maxInts(const int32_t* values, size_t n);
+double minFloats(const double* values, size_t n);
+double maxFloats(const double* values, size_t n);
+
+// Products and their sum wrap around like int arithmetic in the language
+int32_t dotInts(const int32_t* a, const int32_t* b, size_t n);
+double dotFloats(const double* a, const double* b, size_t n);
+
+// out[i] = a[i] op b[i]. mapInts takes + - * and wraps around like int
+// arithmetic, mapFloats takes + - * /.
+void mapInts(kernel_op op, const int32_t* a, const int32_t* b, int32_t* out, size_t n);
+void mapFloats(kernel_op op, const double* a, const double* b, double* out, size_t n);
+
+// out[i] = a[i] op b[i] for < > == !=
+void compareInts(kernel_op op, const int32_t* a, const int32_t* b, bool* out, size_t n);
+void compareFloats(kernel_op op, const double* a, const double* b, bool* out, size_t n);
+
+} // kernels
@@ -5,15 +5,20 @@
 #define __DEBUG__
 
 Lexer::Lexer(std::string input)
+    : m_input(std::make_shared<const std::string>(std::move(input))) {
+    readChar();
+}
+
+Lexer::Lexer(std::shared_ptr<const std::string> input)
     : m_input(input) {
     readChar();
 }
 
 void Lexer::readChar() {
-    if (m_read_pos >= static_cast<int>(m_input.length()))
+    if (m_read_pos >= static_cast<int>(m_input->length()))
         m_char = 0;
     else
-        m_char = m_input[static_cast<size_t>(m_read_pos)];
+        m_char = (*m_input)[static_cast<size_t>(m_read_pos)];
 
     m_read_pos++;
 }
@@ -31,48 +36,51 @@ void Lexer::skipComment() {
         readChar();
 }
 
-std::string Lexer::readIdentifier() {
-    std::string ident;
+std::string_view Lexer::readIdentifier() {
+    const int start = m_read_pos - 1;
 
-    while (isLetter(m_char)) {
-        ident += m_char;
+    while (isLetter(m_char))
         readChar();
-    }
     
-    return ident;
+    return span(start, m_read_pos - 1);
 }
 
-std::string Lexer::readNumber() {
-    std::string str_num;
+std::string_view Lexer::readNumber() {
+    const int start = m_read_pos - 1;
 
-    while (isdigit(m_char) || m_char == '.') {
-        str_num += m_char;
+    while (isdigit(m_char) || m_char == '.')
         readChar();
-    }
 
-    return str_num;
+    return span(start, m_read_pos - 1);
 }
 
-std::string Lexer::readString() {
-    std::string str = "";
-
+std::string_view Lexer::readString() {
     readChar();
-    while (true) {
-        if (m_char == '"' || m_char == 0)
-            break;
+    const int start = m_read_pos - 1;
 
-        str += m_char;
+    while (m_char != '"' && m_char != 0)
         readChar();
-    }
 
-    return str;
+    return span(start, m_read_pos - 1);
+}
+
+// Source text from start up to, but not including, end
+std::string_view Lexer::span(int start, int end) const {
+    const int length = static_cast<int>(m_input->length());
+
+    if (start > length)
+        start = length;
+    if (end > length)
+        end = length;
+
+    return std::string_view(*m_input).substr(static_cast<size_t>(start), static_cast<size_t>(end - start));
 }
 
 char Lexer::peekChar() {
-    if (m_read_pos >= static_cast<int>(m_input.length()))
+    if (m_read_pos >= static_cast<int>(m_input->length()))
         return 0;
     else
-        return m_input[static_cast<size_t>(m_read_pos)];
+        return (*m_input)[static_cast<size_t>(m_read_pos)];
 }
 
 bool Lexer::isLetter(char c) {
@@ -86,13 +94,14 @@ Token Lexer::nextToken() {
     skipComment();
     skipWhitespace();
 
-    std::string literal = std::string(1, m_char);
+    const int start = m_read_pos - 1;
+    std::string_view literal = span(start, start + 1);
 
     switch (m_char) {
         case '=':
             if (peekChar() == '=') {
                 readChar();
-                literal += m_char;
+                literal = span(start, start + 2);
                 tok = {TOK_EQ, literal};
             } else {
                 tok = {TOK_ASSIGN, literal};
@@ -105,7 +114,7 @@ Token Lexer::nextToken() {
         case '!':
             if (peekChar() == '=') {
                 readChar();
-                literal += m_char;
+                literal = span(start, start + 2);
                 tok = {TOK_NOT_EQ, literal};
             } else {
                 tok = {TOK_BANG, literal};
@@ -137,11 +146,8 @@ Token Lexer::nextToken() {
             tok = {TOK_LBRACKET, literal}; break;
         case ']':
             tok = {TOK_RBRACKET, literal}; break;
-        case '"': {
-            std::string str = readString();
-            tok = {TOK_STR, str};
-            break;
-        }
+        case '"':
+            tok = {TOK_STR, readString()}; break;
         case 0:
             tok = {TOK_EOF, ""}; break;
         default:
@@ -150,8 +156,7 @@ Token Lexer::nextToken() {
                 tok.type = lookupIdent(tok.literal);
                 return tok;
             } else if (isdigit(m_char)) {
-                const std::string num_str = readNumber();
-                return getNumberToken(num_str);
+                return getNumberToken(readNumber());
             } else {
 #ifdef __DEBUG__
                 std::cout << "Illegal tok: " << literal << " found\n";
@@ -165,7 +170,7 @@ Token Lexer::nextToken() {
     return tok;
 }
 
-Token Lexer::getNumberToken(const std::string& str) {
+Token Lexer::getNumberToken(std::string_view str) {
     const size_t str_len = str.length();
     unsigned int n_dots = 0;
 
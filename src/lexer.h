@@ -1,27 +1,35 @@
 #pragma once
 
+#include <memory>
+
 #include "token.h"
 
+// Tokens point into m_input, which is shared and never modified, so copies
+// of the lexer (and the parser's arena) can keep it alive cheaply
 class Lexer {
-    std::string m_input;
+    std::shared_ptr<const std::string> m_input;
     int m_read_pos {0};
     char m_char {0}; // current char under examination
 
 public:
     Lexer(std::string input);
+    Lexer(std::shared_ptr<const std::string> input);
+
+    std::shared_ptr<const std::string> source() const { return m_input; }
 
     void readChar();
     void skipWhitespace();
     void skipComment();
 
-    std::string readIdentifier();
-    std::string readNumber();
-    std::string readString();
+    std::string_view readIdentifier();
+    std::string_view readNumber();
+    std::string_view readString();
+    std::string_view span(int start, int end) const;
 
     char peekChar();
 
     bool isLetter(char c);
 
     Token nextToken();
-    Token getNumberToken(const std::string& str);
+    Token getNumberToken(std::string_view str);
 };
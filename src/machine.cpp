@@ -0,0 +1,473 @@
+#include "machine.h"
+#include "builtin.h"
+#include "evaluator.h"
+
+using namespace evaluator;
+
+// Step of a call task while the function body runs
+const int STEP_BODY = -1;
+
+Machine::Machine(size_t max_depth)
+    : m_max_depth(max_depth) {
+}
+
+Value Machine::run(const ASTNodePtr& node, EnvPtr env) {
+    m_tasks.clear();
+    m_values.clear();
+    m_nodes.clear();
+    m_depth = 0;
+
+    push(node, env);
+
+    while (!m_tasks.empty())
+        resume();
+
+    Value result = m_values.back();
+    m_values.clear();
+
+    return result;
+}
+
+Value Machine::run(const std::shared_ptr<Program>& program, EnvPtr env) {
+    return run(program.get(), env);
+}
+
+// Leaves are evaluated right away, everything else becomes a task. Returns
+// true when a task was pushed, false when the value is already on m_values.
+bool Machine::push(const ASTNodePtr& node, const EnvPtr& env) {
+    const int type = node->nodeType();
+
+    switch (type)
+    {
+    case NODE_EXPR_STMNT:
+        return push(node->getExpr(), env);
+    case NODE_INLINED_CALL:
+        // Calls go through the machine so its depth limit holds
+        return push(node->getCall(), env);
+    case NODE_IDENT:
+        m_values.push_back(evalIdentifier(node, env));
+        return false;
+    case NODE_INT:
+        m_values.push_back(Value(node->getIntValue()));
+        return false;
+    case NODE_FLOAT:
+        m_values.push_back(Value(node->getFloatValue()));
+        return false;
+    case NODE_STR:
+        m_values.push_back(makeObject<String>(node->tokenLiteral()));
+        return false;
+    case NODE_BOOL:
+        m_values.push_back(Value(node->getBoolValue()));
+        return false;
+    case NODE_FUNC: {
+        m_values.push_back(makeObject<Function>(node->getParams(), node->getBody(), node->getArena(), env, node->getSlotCount()));
+        return false;
+    }
+    case NODE_PROGRAM:
+    case NODE_BLOCK_STMNT:
+    case NODE_PREFIX:
+    case NODE_INFIX:
+    case NODE_IF_EXPR:
+    case NODE_RETURN_STMNT:
+    case NODE_LET_STMNT:
+    case NODE_CALL_EXPR:
+    case NODE_ARRAY:
+    case NODE_HASH:
+    case NODE_INDEX:
+        m_tasks.push_back({node, type, env, 0, 0, 0});
+        return true;
+    default:
+        m_values.push_back(Value::nil());
+        return false;
+    }
+}
+
+// Pops the current task and pushes its result
+void Machine::finish(Value value) {
+    m_tasks.pop_back();
+    m_values.push_back(value);
+}
+
+// Runs the task on top of the stack until it finishes or pushes a child
+// task. Pushing a task invalidates task, so a step returns right after.
+void Machine::resume() {
+    Task& task = m_tasks.back();
+    const ASTNodePtr node = task.node;
+
+    switch (task.type)
+    {
+    case NODE_PROGRAM:
+    case NODE_BLOCK_STMNT:
+        resumeSequence(task);
+        return;
+    case NODE_PREFIX: {
+        if (task.step++ == 0 && push(node->getRight(), task.env))
+            return;
+
+        auto right = m_values.back();
+        m_values.pop_back();
+
+        finish(isError(right) ? right : evalPrefixExpr(node->getOprtr(), right));
+        return;
+    }
+    case NODE_INFIX:
+    case NODE_INDEX: {
+        if (task.step == 0) {
+            task.step++;
+            if (push(node->getLeft(), task.env))
+                return;
+        }
+
+        if (task.step == 1) {
+            if (isError(m_values.back())) {
+                m_tasks.pop_back();
+                return;
+            }
+
+            task.step++;
+            if (push(task.type == NODE_INFIX ? node->getRight() : node->getIndex(), task.env))
+                return;
+        }
+
+        auto right = m_values.back();
+        m_values.pop_back();
+        auto left = m_values.back();
+        m_values.pop_back();
+
+        if (isError(right))
+            finish(right);
+        else if (task.type == NODE_INFIX)
+            finish(evalInfixExpr(node->getOprtr(), left, right));
+        else
+            finish(evalIndexExpr(left, right));
+        return;
+    }
+    case NODE_IF_EXPR: {
+        if (task.step++ == 0 && push(node->getCondition(), task.env))
+            return;
+
+        auto cond = m_values.back();
+        if (isError(cond)) {
+            m_tasks.pop_back();
+            return;
+        }
+        m_values.pop_back();
+
+        // The chosen branch takes the place of the if
+        ASTNodePtr branch = isTrue(cond) ? node->getConsequence() : node->getAlternative();
+        EnvPtr env = task.env;
+        m_tasks.pop_back();
+
+        if (branch)
+            push(branch, env);
+        else
+            m_values.push_back(Value::nil());
+        return;
+    }
+    case NODE_RETURN_STMNT: {
+        if (task.step++ == 0 && push(node->getExpr(), task.env))
+            return;
+
+        auto value = m_values.back();
+        m_values.pop_back();
+
+        finish(isError(value) ? value : makeObject<Return>(value));
+        return;
+    }
+    case NODE_LET_STMNT: {
+        if (task.step++ == 0 && push(node->getExpr(), task.env))
+            return;
+
+        auto value = m_values.back();
+        m_values.pop_back();
+
+        if (isError(value))
+            finish(value);
+        else if (node->getSlot() >= 0)
+            finish(task.env->setAt(node->getSlot(), value));
+        else
+            finish(task.env->set(node->getIdentName(), value));
+        return;
+    }
+    case NODE_CALL_EXPR:
+        resumeCall(task);
+        return;
+    case NODE_ARRAY:
+        resumeExprs(task);
+        return;
+    case NODE_HASH:
+        resumeHash(task);
+        return;
+    default:
+        finish(Value::nil());
+        return;
+    }
+}
+
+// Statements of a program or a block, step counts the ones started so far
+void Machine::resumeSequence(Task& task) {
+    const bool is_program = task.type == NODE_PROGRAM;
+
+    if (task.step == 0) {
+        auto first = task.node->getStatementAt(0);
+
+        if (!first) {
+            finish(is_program ? Value(nullptr) : Value::nil());
+            return;
+        }
+
+        task.step++;
+        if (push(first, task.env))
+            return;
+    }
+
+    while (true) {
+        gc::maybeCollect();
+
+        auto& result = m_values.back();
+        const int type = result->getType();
+        auto next = task.node->getStatementAt(static_cast<unsigned int>(task.step));
+
+        if (type == OBJ_RETURN || type == OBJ_ERROR || !next) {
+            if (is_program && type == OBJ_RETURN) {
+                Value value = result->getObjValue();
+                result = value;
+            }
+
+            m_tasks.pop_back();
+            return;
+        }
+
+        m_values.pop_back();
+        task.step++;
+        if (push(next, task.env))
+            return;
+    }
+}
+
+// The callee and the arguments are collected from task.begin on in
+// m_values, the callee stays there while the body runs
+void Machine::resumeCall(Task& task) {
+    const auto call = static_cast<Expr*>(task.node);
+
+    if (task.step == 0) {
+        task.begin = m_values.size();
+        task.step++;
+        if (push(call->getFunc(), task.env))
+            return;
+    }
+
+    if (task.step == STEP_BODY) {
+        auto result = unwrapReturnValue(m_values.back());
+        m_values.pop_back();
+
+        if (result->getType() != OBJ_TAIL_CALL) {
+            m_depth--;
+            m_values.resize(task.begin);
+            finish(result);
+            return;
+        }
+
+        auto tail_call = result.as<TailCall>();
+        m_values.back() = tail_call->func;
+        enterFunction(task, tail_call->func, tail_call->args);
+        return;
+    }
+
+    const size_t n_args = call->getArgSize();
+
+    while (true) {
+        const size_t n_evaluated = m_values.size() - task.begin;
+
+        // Arguments are cut after the first error, like in evaluator::evalExprs
+        if (isError(m_values.back())) {
+            if (n_evaluated <= 2) {
+                auto error = m_values.back();
+                m_values.resize(task.begin);
+                finish(error);
+                return;
+            }
+            break;
+        }
+
+        if (n_evaluated - 1 == n_args)
+            break;
+
+        if (push(call->getArgAt(static_cast<unsigned int>(n_evaluated - 1)), task.env))
+            return;
+    }
+
+    auto func = m_values[task.begin];
+    std::vector<Value> args(m_values.begin() + static_cast<long>(task.begin) + 1, m_values.end());
+
+    switch (func->getType())
+    {
+    case OBJ_FUNC:
+        // Compiled ahead of time, so it has no body to step through
+        if (func.as<Function>()->native) {
+            m_values.resize(task.begin);
+            finish(applyFunction(func, args));
+            return;
+        }
+
+        if (call->isTailCall()) {
+            m_values.resize(task.begin);
+            finish(makeObject<TailCall>(func, args));
+            return;
+        }
+
+        m_values.resize(task.begin + 1);
+        enterFunction(task, func, args);
+        return;
+    case OBJ_BUILTIN:
+        m_values.resize(task.begin);
+        finish(callBuiltin(func, args));
+        return;
+    // Runs on the C++ stack, like a builtin
+    case OBJ_MEMO:
+        m_values.resize(task.begin);
+        finish(callMemoized(func, args, applyFunction));
+        return;
+    default:
+        m_values.resize(task.begin);
+        finish(makeObject<Error>(("not a function: " + func->typeString())));
+        return;
+    }
+}
+
+// Starts the body of func, or a tail call made from a body already running
+// in task. Mirrors evaluator::applyFunction, including the env reuse.
+void Machine::enterFunction(Task& task, const Value& func, const std::vector<Value>& args) {
+    const bool is_tail_call = task.step == STEP_BODY;
+    const size_t n_params = func->getParams().size();
+
+    Value error = nullptr;
+
+    if (n_params != args.size())
+        error = makeObject<Error>("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=" + std::to_string(n_params));
+    else if (!is_tail_call && m_depth >= m_max_depth)
+        error = makeObject<Error>("maximum call depth exceeded: " + std::to_string(m_depth));
+
+    if (error) {
+        if (is_tail_call)
+            m_depth--;
+
+        m_values.resize(task.begin);
+        finish(error);
+        return;
+    }
+
+    auto& env = task.env;
+
+    if (is_tail_call && env->refs == 1 && env->getOuter() == func->getEnv() && env->getSlotCount() == static_cast<size_t>(func->getSlotCount())) {
+        env->reset();
+        bindParams(func, args, env);
+    } else {
+        env = extendFunctionEnv(func, args);
+    }
+
+    if (!is_tail_call)
+        m_depth++;
+
+    task.step = STEP_BODY;
+    push(func->getBody(), env);
+}
+
+// Array elements, step counts the ones started so far
+void Machine::resumeExprs(Task& task) {
+    const auto& elements = task.node->getElements();
+
+    if (task.step == 0) {
+        if (elements.empty()) {
+            finish(makeObject<Array>(std::vector<Value>()));
+            return;
+        }
+
+        task.step++;
+        if (push(elements[0], task.env))
+            return;
+    }
+
+    while (true) {
+        const size_t n_evaluated = static_cast<size_t>(task.step);
+
+        // Elements are cut after the first error, like in evaluator::evalExprs
+        if (isError(m_values.back())) {
+            if (n_evaluated == 1) {
+                m_tasks.pop_back();
+                return;
+            }
+            break;
+        }
+
+        if (n_evaluated == elements.size())
+            break;
+
+        task.step++;
+        if (push(elements[n_evaluated], task.env))
+            return;
+    }
+
+    const size_t first = m_values.size() - static_cast<size_t>(task.step);
+    std::vector<Value> values(m_values.begin() + static_cast<long>(first), m_values.end());
+    m_values.resize(first);
+
+    finish(makeObject<Array>(values));
+}
+
+// Keys and values alternate in m_nodes, step counts the ones started so far
+void Machine::resumeHash(Task& task) {
+    if (task.step == 0) {
+        const auto& pairs = task.node->getPairs();
+
+        if (pairs.empty()) {
+            finish(makeObject<Hash>(HashTable()));
+            return;
+        }
+
+        task.begin = m_nodes.size();
+        for (const auto& [key_node, value_node] : pairs) {
+            m_nodes.push_back(key_node);
+            m_nodes.push_back(value_node);
+        }
+        task.end = m_nodes.size();
+        task.step++;
+        if (push(m_nodes[task.begin], task.env))
+            return;
+    }
+
+    while (true) {
+        const size_t n_evaluated = static_cast<size_t>(task.step);
+        Value error = nullptr;
+
+        if (isError(m_values.back()))
+            error = m_values.back();
+        else if (n_evaluated % 2 == 0 && m_values[m_values.size() - 2]->hashKey().type == OBJ_NIL)
+            error = makeObject<Error>("unusable as hash key");
+
+        if (error) {
+            m_values.resize(m_values.size() - n_evaluated);
+            m_nodes.resize(task.begin);
+            finish(error);
+            return;
+        }
+
+        if (task.begin + n_evaluated == task.end)
+            break;
+
+        task.step++;
+        if (push(m_nodes[task.begin + n_evaluated], task.env))
+            return;
+    }
+
+    const size_t first = m_values.size() - static_cast<size_t>(task.step);
+    HashTable pairs;
+
+    for (size_t i = first; i < m_values.size(); i += 2)
+        pairs.set(m_values[i]->hashKey(), m_values[i], m_values[i + 1]);
+
+    m_values.resize(first);
+    m_nodes.resize(task.begin);
+
+    finish(makeObject<Hash>(std::move(pairs)));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ast.h"
+#include "env.h"
+
+const size_t DEFAULT_MAX_DEPTH = 1 << 18;
+
+// Pending work for a node whose children are still being evaluated. begin
+// and end delimit the keys and values of a hash in Machine::m_nodes, for
+// calls begin is where the callee and arguments start in Machine::m_values.
+struct Task {
+    ASTNodePtr node;
+    int type;
+    EnvPtr env;
+    int step;
+    size_t begin;
+    size_t end;
+};
+
+// Tree-walking evaluator that keeps its continuations in heap allocated
+// stacks instead of on the C++ stack. Gives the same results as
+// evaluator::eval, but a program that recurses deeper than max_depth calls
+// gets an error instead of overflowing the native stack.
+class Machine {
+    std::vector<Task> m_tasks;
+    std::vector<Value> m_values;
+    std::vector<ASTNodePtr> m_nodes;
+
+    size_t m_depth {0};
+    size_t m_max_depth;
+
+public:
+    Machine(size_t max_depth = DEFAULT_MAX_DEPTH);
+
+    Value run(const ASTNodePtr& node, EnvPtr env);
+    Value run(const std::shared_ptr<Program>& program, EnvPtr env);
+
+    size_t maxDepth() const { return m_max_depth; }
+
+private:
+    bool push(const ASTNodePtr& node, const EnvPtr& env);
+    void resume();
+
+    void resumeSequence(Task& task);
+    void resumeCall(Task& task);
+    void resumeExprs(Task& task);
+    void resumeHash(Task& task);
+
+    void enterFunction(Task& task, const Value& func, const std::vector<Value>& args);
+    void finish(Value value);
+};
@@ -1,11 +1,121 @@
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 
+#include "aot.h"
+#include "heap.h"
+#include "jit.h"
+#include "optimizer.h"
+#include "parser.h"
 #include "repl.h"
 
-int main() {
+// Parsed program of file, nullptr after printing why there's none
+static std::shared_ptr<Program> parseFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "can't open " << path << '\n';
+        return nullptr;
+    }
+
+    std::stringstream source;
+    source << file.rdbuf();
+    const std::string input = source.str();
+
+    Lexer lexer(input);
+    Parser parser(lexer);
+    auto program = parser.parseProgram();
+
+    if (parser.errors().size() != 0) {
+        repl::printParsingErrors(parser.errors());
+        return nullptr;
+    }
+
+    Optimizer optimizer;
+    optimizer.optimize(program);
+
+    return program;
+}
+
+// Runs the program in path as a native module, compiled unless it's cached
+static int runNative(const std::string& path) {
+    auto program = parseFile(path);
+    if (!program)
+        return 1;
+
+    aot::ModuleCache cache;
+    auto evaluated = cache.run(program, makeRef<Env>());
+
+    if (!evaluated) {
+        for (const auto& error : cache.errors())
+            std::cerr << error << '\n';
+        return 1;
+    }
+
+    if (evaluated->getType() != OBJ_NIL)
+        std::cout << evaluated->inspect() << '\n';
+
+    return evaluated->getType() == OBJ_ERROR ? 1 : 0;
+}
+
+// Count given as an arg, false unless text is only digits and fits
+static bool parseCount(const std::string& text, size_t& count) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+
+    try {
+        count = std::stoul(text);
+    } catch (const std::out_of_range&) {
+        return false;
+    }
+
+    return true;
+}
+
+static int printUsage() {
+    std::cout << "Usage: toylang [--vm | --stack | --thunk] [--max-depth n_calls] [--gc-threshold n_cells] [--jit-threshold n_calls]\n";
+    std::cout << "       toylang [--gc-threshold n_cells] --emit-cpp file | --native file\n";
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    engine_type engine = ENGINE_EVAL;
+    size_t max_depth = DEFAULT_MAX_DEPTH;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        size_t count = 0;
+
+        if (arg == "--vm") {
+            engine = ENGINE_VM;
+        } else if (arg == "--stack") {
+            engine = ENGINE_STACK;
+        } else if (arg == "--thunk") {
+            engine = ENGINE_THUNK;
+        } else if (arg == "--max-depth" && i + 1 < argc && parseCount(argv[++i], count)) {
+            max_depth = count;
+        } else if (arg == "--gc-threshold" && i + 1 < argc && parseCount(argv[++i], count)) {
+            gc::setThreshold(count);
+        } else if (arg == "--jit-threshold" && i + 1 < argc && parseCount(argv[++i], count)) {
+            jit::setThreshold(count);
+        } else if (arg == "--emit-cpp" && i + 1 < argc) {
+            auto program = parseFile(argv[++i]);
+            if (!program)
+                return 1;
+
+            std::cout << aot::emitCpp(program);
+            return 0;
+        } else if (arg == "--native" && i + 1 < argc) {
+            return runNative(argv[++i]);
+        } else {
+            return printUsage();
+        }
+    }
+
     std::cout << "==== Welcome to toy-lang ====\n\n";
 
-    repl::start();
+    repl::start(engine, max_depth);
 
     return 0;
 }
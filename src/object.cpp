@@ -1,44 +1,350 @@
 #include "object.h"
+#include "env.h"
+#include "jit.h"
 
+#include <iterator>
 #include <vector>
 
+// Returned by reference for objects without strings, params etc.
+static const std::string empty_str;
+static const std::vector<Identifier> empty_params;
+static const PersistentVector empty_elements;
+static const HashTable empty_pairs;
+
 bool operator== (const HashKey& hash_key_a, const HashKey& hash_key_b) {
-    return hash_key_a.value == hash_key_b.value;
+    return hash_key_a.type == hash_key_b.type && hash_key_a.value == hash_key_b.value;
 }
 
-bool operator< (const HashKey& hash_key_a, const HashKey& hash_key_b) {
-    return hash_key_a.value < hash_key_b.value;
-}
+Value charString(char c) {
+    static Value strings[256];
+    auto& str = strings[static_cast<unsigned char>(c)];
 
-const std::string Bool::inspect() const {
-    if (value) return "true";
-    return "false";
-};
+    if (!str) {
+        str = makeObject<String>(std::string(1, c));
+        gc::makeImmortal(str.asObject());
+    }
+
+    return str;
+}
 
 HashKey String::hashKey() const {
     std::hash<std::string> hasher;
     auto hashed_value = hasher(value);
 
-    return {OBJ_STR, static_cast<int>(hashed_value)};
+    return {OBJ_STR, static_cast<uint64_t>(hashed_value)};
+}
+
+static const uint8_t CTRL_EMPTY = 0x80;
+static const size_t GROUP_SIZE = 8;
+static const uint64_t LOW_BITS = 0x0101010101010101;
+static const uint64_t HIGH_BITS = 0x8080808080808080;
+
+// Spreads the key's hash over all 64 bits, ints hash to themselves
+static uint64_t mixHash(const HashKey& hashed) {
+    uint64_t h = hashed.value ^ (static_cast<uint64_t>(hashed.type) << 56);
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53;
+    h ^= h >> 33;
+
+    return h;
+}
+
+static uint64_t loadGroup(const uint8_t* ctrl) {
+    uint64_t group;
+    std::memcpy(&group, ctrl, sizeof(group));
+
+    return group;
+}
+
+// High bit set in every byte of group equal to byte. May report a false
+// match next to a real one, the keys are compared anyway.
+static uint64_t matchByte(uint64_t group, uint8_t byte) {
+    const uint64_t x = group ^ (LOW_BITS * byte);
+
+    return (x - LOW_BITS) & ~x & HIGH_BITS;
+}
+
+static size_t firstByte(uint64_t mask) {
+    return static_cast<size_t>(__builtin_ctzll(mask)) / 8;
+}
+
+// Equal hashes already mean equal ints and bools
+static bool sameKey(const Value& a, const Value& b) {
+    const int type = a->getType();
+
+    if (type != b->getType())
+        return false;
+
+    return type != OBJ_STR || a->getStrVal() == b->getStrVal();
+}
+
+bool MemoTable::hashArgs(const std::vector<Value>& args, uint64_t& hash) {
+    hash = args.size();
+
+    for (const auto& arg : args) {
+        const auto hashed = arg.hashKey();
+        if (hashed.type == OBJ_NIL)
+            return false;
+
+        hash = mixHash({hashed.type, hashed.value ^ hash});
+    }
+
+    return true;
+}
+
+const Value* MemoTable::get(uint64_t hash, const std::vector<Value>& args) {
+    const auto [begin, end] = m_index.equal_range(hash);
+
+    for (auto it = begin; it != end; ++it) {
+        const auto& entry_args = it->second->args;
+        if (entry_args.size() != args.size())
+            continue;
+
+        bool is_same = true;
+        for (size_t i = 0; i < args.size() && is_same; i++)
+            is_same = sameKey(entry_args[i], args[i]);
+
+        if (is_same) {
+            m_hits++;
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            return &m_entries.front().result;
+        }
+    }
+
+    m_misses++;
+    return nullptr;
+}
+
+void MemoTable::set(uint64_t hash, const std::vector<Value>& args, const Value& result) {
+    if (m_capacity == 0)
+        return;
+
+    if (m_entries.size() == m_capacity) {
+        const auto& oldest = m_entries.back();
+        auto [begin, end] = m_index.equal_range(oldest.hash);
+
+        for (auto it = begin; it != end; ++it) {
+            if (it->second == std::prev(m_entries.end())) {
+                m_index.erase(it);
+                break;
+            }
+        }
+        m_entries.pop_back();
+    }
+
+    m_entries.push_front({hash, args, result});
+    m_index.emplace(hash, m_entries.begin());
+}
+
+void MemoTable::clear() {
+    m_index.clear();
+    m_entries.clear();
+}
+
+// Index of key's entry, size() if there is none
+size_t HashTable::find(uint64_t hash, const Value& key) const {
+    if (m_entries.empty())
+        return 0;
+
+    const uint8_t h2 = static_cast<uint8_t>(hash & 0x7f);
+    const size_t group_mask = m_ctrl.size() / GROUP_SIZE - 1;
+    size_t group = (hash >> 7) & group_mask;
+
+    // Triangular probing visits every group since their count is a power of 2
+    for (size_t step = 1; ; step++) {
+        const uint64_t ctrl = loadGroup(&m_ctrl[group * GROUP_SIZE]);
+
+        for (uint64_t match = matchByte(ctrl, h2); match; match &= match - 1) {
+            const uint32_t index = m_slots[group * GROUP_SIZE + firstByte(match)];
+            const auto& entry = m_entries[index];
+
+            if (entry.hash == hash && sameKey(entry.key, key))
+                return index;
+        }
+
+        // Probing stops at the first group that has room
+        if (ctrl & HIGH_BITS)
+            return m_entries.size();
+
+        group = (group + step) & group_mask;
+    }
 }
 
-HashPairPtr Hash::getPairAt(HashKey key) {
-    auto search = pairs.find(key);
+const Value* HashTable::get(const HashKey& hashed, const Value& key) const {
+    const size_t index = find(mixHash(hashed), key);
+
+    return index < m_entries.size() ? &m_entries[index].value : nullptr;
+}
+
+void HashTable::set(const HashKey& hashed, const Value& key, const Value& value) {
+    const uint64_t hash = mixHash(hashed);
+    const size_t index = find(hash, key);
+
+    if (index < m_entries.size()) {
+        m_entries[index].value = value;
+        return;
+    }
 
-    if (search != pairs.end())
-        return search->second;
+    // Keep the load at 7/8 at most
+    if ((m_entries.size() + 1) * 8 > m_ctrl.size() * 7)
+        grow();
 
+    insertSlot(hash, static_cast<uint32_t>(m_entries.size()));
+    m_entries.push_back({hash, key, value});
+}
+
+void HashTable::insertSlot(uint64_t hash, uint32_t index) {
+    const size_t group_mask = m_ctrl.size() / GROUP_SIZE - 1;
+    size_t group = (hash >> 7) & group_mask;
+
+    for (size_t step = 1; ; step++) {
+        const uint64_t empty = loadGroup(&m_ctrl[group * GROUP_SIZE]) & HIGH_BITS;
+
+        if (empty) {
+            const size_t slot = group * GROUP_SIZE + firstByte(empty);
+            m_ctrl[slot] = static_cast<uint8_t>(hash & 0x7f);
+            m_slots[slot] = index;
+            return;
+        }
+
+        group = (group + step) & group_mask;
+    }
+}
+
+void HashTable::grow() {
+    const size_t capacity = m_ctrl.empty() ? 2 * GROUP_SIZE : 2 * m_ctrl.size();
+
+    m_ctrl.assign(capacity, CTRL_EMPTY);
+    m_slots.assign(capacity, 0);
+
+    for (size_t i = 0; i < m_entries.size(); i++)
+        insertSlot(m_entries[i].hash, static_cast<uint32_t>(i));
+}
+
+void HashTable::clear() {
+    m_entries.clear();
+    m_ctrl.clear();
+    m_slots.clear();
+}
+
+Value Hash::getValueAt(const Value& key) const {
+    auto value = pairs.get(key->hashKey(), key);
+
+    return value ? *value : nullptr;
+}
+
+EnvPtr Object::getEnv() {
     return nullptr;
 }
 
+const std::string& Object::getStrVal() const {
+    return empty_str;
+}
+
+const std::vector<Identifier>& Object::getParams() const {
+    return empty_params;
+}
+
+const PersistentVector& Object::getElements() const {
+    return empty_elements;
+}
+
+const HashTable& Object::getPairs() const {
+    return empty_pairs;
+}
+
+void Array::trace(void (*visit)(HeapCell*)) const {
+    elements.trace(visit);
+}
+
+void Hash::trace(void (*visit)(HeapCell*)) const {
+    for (const auto& entry : pairs) {
+        entry.key.trace(visit);
+        entry.value.trace(visit);
+    }
+}
+
+void Return::trace(void (*visit)(HeapCell*)) const {
+    value.trace(visit);
+}
+
+Function::Function(const std::vector<Identifier>& params, BlockStatement* body, std::shared_ptr<Arena> arena, EnvPtr env, int n_slots)
+    : params(params), body(body), arena(arena), env(env), n_slots(n_slots) {
+}
+
+Function::~Function() = default;
+
+EnvPtr Function::getEnv() {
+    return env;
+}
+
+void Function::trace(void (*visit)(HeapCell*)) const {
+    if (env)
+        visit(env.get());
+}
+
+void Function::clearRefs() {
+    env = nullptr;
+}
+
+void TailCall::trace(void (*visit)(HeapCell*)) const {
+    func.trace(visit);
+
+    for (const auto& arg : args)
+        arg.trace(visit);
+}
+
+Memoized::Memoized(Value func_in, size_t capacity, std::vector<MemoBinding> bindings_in)
+    : func(func_in), table(capacity), bindings(std::move(bindings_in)) {
+}
+
+Memoized::~Memoized() = default;
+
+EnvPtr Memoized::getEnv() {
+    return func->getEnv();
+}
+
+void Memoized::clearRefs() {
+    table.clear();
+    bindings.clear();
+    func = nullptr;
+}
+
+void Memoized::trace(void (*visit)(HeapCell*)) const {
+    func.trace(visit);
+
+    for (const auto& binding : bindings) {
+        if (binding.env)
+            visit(binding.env.get());
+        binding.value.trace(visit);
+    }
+
+    for (const auto& entry : table) {
+        for (const auto& arg : entry.args)
+            arg.trace(visit);
+        entry.result.trace(visit);
+    }
+}
+
+void Closure::trace(void (*visit)(HeapCell*)) const {
+    func.trace(visit);
+
+    for (const auto& value : free)
+        value.trace(visit);
+}
+
 const std::string Array::inspect() const {
     std::string arr_str = "[";
 
     const size_t n = elements.size();
-    for (unsigned int i = 0; i < n; i++) {
-        arr_str += elements[i]->inspect();
+    size_t i = 0;
+    for (const auto& element : elements) {
+        arr_str += element->inspect();
 
-        if (i < n - 1)
+        if (++i < n)
             arr_str += ", ";
     }
     arr_str += "]";
@@ -51,10 +357,10 @@ const std::string Hash::inspect() const {
     const size_t pairs_size = pairs.size();
 
     unsigned int i = 0;
-    for (const auto& [key, pair]: pairs) {
-        hash_str += pair->key->inspect();
+    for (const auto& entry : pairs) {
+        hash_str += entry.key->inspect();
         hash_str += " : ";
-        hash_str += pair->value->inspect();
+        hash_str += entry.value->inspect();
 
         if (i < pairs_size - 1)
             hash_str += ", "; 
@@ -65,7 +371,7 @@ const std::string Hash::inspect() const {
     return hash_str;
 }
 
-const std::string Function::inspect() const {
+static std::string funcString(const std::vector<Identifier>& params, const std::string& body_str) {
     std::string func_str = "func(";
     const size_t n = params.size();
     for (unsigned int i = 0; i < n; i++) {
@@ -75,9 +381,95 @@ const std::string Function::inspect() const {
             func_str += ", ";
     }
     
-    func_str += ") {\n";
-    func_str += body->toString();
-    func_str += "\n}";
+    func_str += ") {\n" + body_str + "\n}";
     
     return func_str;
 }
+
+const std::string Function::inspect() const {
+    if (native)
+        return funcString(params, native_text);
+
+    return funcString(params, body ? body->toString() : "");
+}
+
+const std::string CompiledFunction::inspect() const {
+    return funcString(params, body ? body->toString() : "");
+}
+
+const std::string Value::inspect() const {
+    if (isInt())
+        return std::to_string(asInt());
+    if (isFloat())
+        return std::to_string(asFloat());
+    if (isBool())
+        return asBool() ? "true" : "false";
+    if (isNil())
+        return "nil";
+    if (isObject())
+        return asObject()->inspect();
+
+    return "";
+}
+
+const std::string Value::typeString() const {
+    if (isInt())
+        return "INTEGER";
+    if (isFloat())
+        return "FLOAT";
+    if (isBool())
+        return "BOOLEAN";
+    if (isNil())
+        return "NIL";
+    if (isObject())
+        return asObject()->typeString();
+
+    return "";
+}
+
+int Value::getSlotCount() const {
+    return isObject() ? asObject()->getSlotCount() : 0;
+}
+
+const std::string& Value::getStrVal() const {
+    return isObject() ? asObject()->getStrVal() : empty_str;
+}
+
+Value Value::getObjValue() const {
+    return isObject() ? asObject()->getObjValue() : nullptr;
+}
+
+BlockStatement* Value::getBody() const {
+    return isObject() ? asObject()->getBody() : nullptr;
+}
+
+EnvPtr Value::getEnv() const {
+    return isObject() ? asObject()->getEnv() : nullptr;
+}
+
+const std::vector<Identifier>& Value::getParams() const {
+    return isObject() ? asObject()->getParams() : empty_params;
+}
+
+const PersistentVector& Value::getElements() const {
+    return isObject() ? asObject()->getElements() : empty_elements;
+}
+
+const HashTable& Value::getPairs() const {
+    return isObject() ? asObject()->getPairs() : empty_pairs;
+}
+
+HashKey Value::hashKey() const {
+    if (isInt())
+        return {OBJ_INT, static_cast<uint64_t>(asInt())};
+    if (isBool())
+        return {OBJ_BOOL, static_cast<uint64_t>(asBool())};
+    if (isObject())
+        return asObject()->hashKey();
+
+    return {OBJ_NIL, 0};
+}
+
+Value Value::getValueAt(const Value& key) const {
+    return isObject() ? asObject()->getValueAt(key) : nullptr;
+}
@@ -1,129 +1,120 @@
 #pragma once
 
 #include <iostream>
-#include <functional>
-
-#include "ast.h"
-
-enum object_type {
-    OBJ_INT,
-    OBJ_FLOAT,
-    OBJ_STR,
-    OBJ_BOOL,
-    OBJ_ARRAY,
-    OBJ_HASH,
-    OBJ_RETURN,
-    OBJ_FUNC,
-    OBJ_BUILTIN,
-    OBJ_NIL,
-    OBJ_ERROR
+#include <list>
+#include <unordered_map>
+
+#include "code.h"
+#include "persistent_vector.h"
+#include "value.h"
+
+// Immortal one character string, the same object for every call with c
+Value charString(char c);
+
+// Map from hashable Values (ints, bools and strings) to Values, used by
+// Hash. Open addressing in the style of a Swiss table: each slot has a
+// control byte holding 7 bits of the hash, and the probe compares a group
+// of 8 control bytes at once before looking at any key. The entries live
+// in a dense vector in insertion order, slots index into it.
+class HashTable {
+public:
+    struct Entry {
+        uint64_t hash;
+        Value key;
+        Value value;
+    };
+
+private:
+    std::vector<Entry> m_entries;
+    std::vector<uint8_t> m_ctrl;
+    std::vector<uint32_t> m_slots;
+
+    size_t find(uint64_t hash, const Value& key) const;
+    void grow();
+    void insertSlot(uint64_t hash, uint32_t index);
+
+public:
+    // Adds key or replaces its value. hashed is key->hashKey(), which the
+    // caller has already checked to be usable.
+    void set(const HashKey& hashed, const Value& key, const Value& value);
+
+    // nullptr if key is not in the table
+    const Value* get(const HashKey& hashed, const Value& key) const;
+
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+
+    void clear();
+
+    std::vector<Entry>::const_iterator begin() const { return m_entries.begin(); }
+    std::vector<Entry>::const_iterator end() const { return m_entries.end(); }
 };
 
-class Env;
-struct Object;
-struct HashPair;
-
-typedef std::shared_ptr<HashPair> HashPairPtr;
-typedef std::shared_ptr<Object> ObjectPtr;
-
-struct HashKey {
-    object_type type;
-    int value;
-
-    friend bool operator== (const HashKey& hash_key_a, const HashKey& hash_key_b);
-    friend bool operator< (const HashKey& hash_key_a, const HashKey& hash_key_b);
-};
-
-struct HashPair {
-    ObjectPtr key;
-    ObjectPtr value;
-
-    HashPair(ObjectPtr key_in, ObjectPtr value_in) : key(key_in), value(value_in) {}
+// Results of a function by its args, which must all be usable as hash keys.
+// Holds at most capacity results, dropping the least recently used one to
+// make room for a new one.
+class MemoTable {
+public:
+    struct Entry {
+        uint64_t hash;
+        std::vector<Value> args;
+        Value result;
+    };
+
+private:
+    std::list<Entry> m_entries; // most recently used first
+    std::unordered_multimap<uint64_t, std::list<Entry>::iterator> m_index;
+    size_t m_capacity;
+    size_t m_hits {0};
+    size_t m_misses {0};
+
+public:
+    MemoTable(size_t capacity) : m_capacity(capacity) {}
+
+    // Hash of args as a whole, false if some arg can't be a key
+    static bool hashArgs(const std::vector<Value>& args, uint64_t& hash);
+
+    // Result for args, nullptr if there is none. Counts a hit or a miss.
+    const Value* get(uint64_t hash, const std::vector<Value>& args);
+    void set(uint64_t hash, const std::vector<Value>& args, const Value& result);
+
+    // A call that can't be looked up still runs the function
+    void countMiss() { m_misses++; }
+
+    size_t size() const { return m_entries.size(); }
+    size_t capacity() const { return m_capacity; }
+    size_t hits() const { return m_hits; }
+    size_t misses() const { return m_misses; }
+
+    void clear();
+
+    std::list<Entry>::const_iterator begin() const { return m_entries.begin(); }
+    std::list<Entry>::const_iterator end() const { return m_entries.end(); }
 };
 
-struct Object {
-    std::string type;
-
-    Object() = default;
-
+// Heap allocated values, counted by the Values pointing to them
+struct Object: public HeapCell {
     virtual const std::string inspect() const { return ""; }
     virtual const std::string typeString() const { return ""; }
 
     virtual int getType() const { return -1; }
+    virtual int getSlotCount() const { return 0; }
 
     virtual int getIntVal() const { return 0; }
     virtual bool getBoolVal() const { return true; }
     virtual double getFloatVal() const { return -1; }
-    virtual std::string getStrVal() const { return ""; }
-
-    virtual std::shared_ptr<Object> getObjValue() { return nullptr; }
-    virtual std::shared_ptr<BlockStatement> getBody() { return nullptr; }
-    virtual std::weak_ptr<Env> getEnv() { return std::weak_ptr<Env>(); }
-
-    virtual const std::vector<Identifier> getParams() const { return {}; }
-    virtual std::vector<ObjectPtr> getElements() { return {}; }
-    virtual std::map<HashKey, HashPairPtr> getPairs() { return {}; }
-
-    virtual HashKey hashKey() const { return {OBJ_NIL, -1}; }
-    virtual HashPairPtr getPairAt(HashKey key) { (void)key; return nullptr; }
+    virtual const std::string& getStrVal() const;
 
-    virtual std::shared_ptr<Object> clone() { return std::make_shared<Object>(*this); }
+    virtual Value getObjValue() { return nullptr; }
+    virtual BlockStatement* getBody() { return nullptr; }
+    virtual EnvPtr getEnv();
 
-    virtual ~Object() = default;
-};
-
-struct Integer: public Object {
-    int value;
-
-    Integer(int value_in) : value(value_in) {}
-
-    const std::string inspect() const override { return std::to_string(value); }
-    const std::string typeString() const override { return "INTEGER"; }
-
-    int getType() const override { return OBJ_INT; }
-
-    int getIntVal() const override { return value; }
-    bool getBoolVal() const override { return value; }
-    double getFloatVal() const override { return static_cast<double>(value); }
+    virtual const std::vector<Identifier>& getParams() const;
+    virtual const PersistentVector& getElements() const;
+    virtual const HashTable& getPairs() const;
 
-    HashKey hashKey() const override { return {OBJ_INT, value}; }
-
-    std::shared_ptr<Object> clone() override { return std::make_shared<Integer>(*this); }
-};
-
-struct Float: public Object {
-    double value;
-
-    Float(double value_in) : value(value_in) {}
-
-    const std::string inspect() const override { return std::to_string(value); }
-    const std::string typeString() const override { return "FLOAT"; }
-
-    int getType() const override { return OBJ_FLOAT; }
-
-    int getIntVal() const override { return static_cast<int>(value); }
-    bool getBoolVal() const override { return static_cast<bool>(value); }
-    double getFloatVal() const override { return value; }
-
-    std::shared_ptr<Object> clone() override { return std::make_shared<Float>(*this); }
-};
-
-struct Bool: public Object {
-    bool value;
-
-    Bool(bool value_in) : value(value_in) {}
-
-    const std::string inspect() const override;
-    const std::string typeString() const override { return "BOOLEAN"; }
-
-    int getType() const override { return OBJ_BOOL; }
-    int getIntVal() const override { return value; }
-
-    bool getBoolVal() const override { return value; }
-
-    HashKey hashKey() const override { return {OBJ_BOOL, static_cast<int>(value)}; }
-
-    std::shared_ptr<Object> clone() override { return std::make_shared<Bool>(*this); }
+    virtual HashKey hashKey() const { return {OBJ_NIL, 0}; }
+    virtual Value getValueAt(const Value& key) const { (void)key; return nullptr; }
 };
 
 struct String: public Object {
@@ -133,103 +124,158 @@ struct String: public Object {
 
     const std::string inspect() const override { return ("'" + value + "'"); }
     const std::string typeString() const override { return "STRING"; }
-    std::string getStrVal() const override { return value; }
+    const std::string& getStrVal() const override { return value; }
 
     int getType() const override { return OBJ_STR; }
 
     HashKey hashKey() const override;
-
-    std::shared_ptr<Object> clone() override { return std::make_shared<String>(*this); }
 };
 
 struct Array: public Object {
-    std::vector<ObjectPtr> elements;
+    PersistentVector elements;
 
-    Array(std::vector<ObjectPtr> elements_in) : elements(elements_in) {}
+    Array(const std::vector<Value>& elements_in) : elements(elements_in) {}
+    Array(PersistentVector elements_in) : elements(std::move(elements_in)) {}
 
     const std::string inspect() const override;
     const std::string typeString() const override { return "ARRAY"; }
 
-    std::vector<ObjectPtr> getElements() override { return { elements }; }
+    const PersistentVector& getElements() const override { return elements; }
 
     int getType() const override { return OBJ_ARRAY; }
 
-    std::shared_ptr<Object> clone() override { return std::make_shared<Array>(*this); }
+    void trace(void (*visit)(HeapCell*)) const override;
+    void clearRefs() override { elements.clear(); }
 };
 
 struct Hash: public Object {
-    std::map<HashKey, HashPairPtr> pairs;
+    HashTable pairs;
 
-    Hash(std::map<HashKey, HashPairPtr> pairs_in) : pairs(pairs_in) {}
+    Hash(HashTable pairs_in) : pairs(std::move(pairs_in)) {}
 
     const std::string inspect() const override;
     const std::string typeString() const override { return "HASH"; }
 
     int getType() const override { return OBJ_HASH; }
 
-    std::map<HashKey, HashPairPtr> getPairs() override { return pairs; }
-    HashPairPtr getPairAt(HashKey key) override;
+    const HashTable& getPairs() const override { return pairs; }
+    Value getValueAt(const Value& key) const override;
+
+    void trace(void (*visit)(HeapCell*)) const override;
+    void clearRefs() override { pairs.clear(); }
 };
 
 struct Return: public Object {
-    std::shared_ptr<Object> value;
+    Value value;
 
-    Return(std::shared_ptr<Object> value_in) : value(value_in) {}
+    Return(Value value_in) : value(value_in) {}
 
     const std::string inspect() const override { return value->inspect(); }
     const std::string typeString() const override { return "RETURN"; }
 
     int getType() const override { return OBJ_RETURN; }
 
-    std::shared_ptr<Object> getObjValue() override { return value; }
+    Value getObjValue() override { return value; }
 
-    std::shared_ptr<Object> clone() override { return std::make_shared<Return>(*this); }
+    void trace(void (*visit)(HeapCell*)) const override;
+    void clearRefs() override { value = nullptr; }
 };
 
+struct Thunk;
+struct JitCode;
+
+// Body of a function compiled ahead of time into a native module, see aot.h.
+// Takes the Env* of the call and returns the raw bits of the result.
+typedef uint64_t (*NativeBody)(void* env);
+
+// Holds on to the env it was defined in, which usually holds the function
+// back. Members touching env live in object.cpp where Env is complete.
 struct Function: public Object {
     std::vector<Identifier> params;
-    std::shared_ptr<BlockStatement> body;
-    std::weak_ptr<Env> env;
-
-    Function(std::vector<Identifier> params, std::shared_ptr<BlockStatement> body, std::shared_ptr<Env> env)
-        : params(params), body(body), env(env) {
-    }
+    BlockStatement* body;
+    std::shared_ptr<Arena> arena; // keeps body alive
+    EnvPtr env;
+    int n_slots;
+    const Thunk* compiled {nullptr}; // body, if made by the thunk engine
+    size_t n_calls {0};              // counted by the JIT until it's hot
+    std::unique_ptr<JitCode> jit;
+    NativeBody native {nullptr};     // body, if compiled ahead of time (then body is nullptr)
+    const char* native_text {nullptr}; // text of that body, in its module
+
+    Function(const std::vector<Identifier>& params, BlockStatement* body, std::shared_ptr<Arena> arena, EnvPtr env, int n_slots = 0);
+    ~Function() override;
 
     const std::string inspect() const override;
     const std::string typeString() const override { return "FUNC"; }
 
-    std::shared_ptr<BlockStatement> getBody() override { return body; }
-    std::weak_ptr<Env> getEnv() override { return env; }
+    BlockStatement* getBody() override { return body; }
+    EnvPtr getEnv() override;
 
-    const std::vector<Identifier> getParams() const override { return params; }
+    const std::vector<Identifier>& getParams() const override { return params; }
 
     int getType() const override { return OBJ_FUNC; }
+    int getSlotCount() const override { return n_slots; }
 
-    std::shared_ptr<Object> clone() override { return std::make_shared<Function>(*this); }
+    void trace(void (*visit)(HeapCell*)) const override;
+    void clearRefs() override;
 };
 
-struct Builtin: public Object {
-    std::string builtin_name;
+// Name from outside a memoized function that its purity was checked
+// against, with the value it held then
+struct MemoBinding {
+    EnvPtr env;
+    int depth;        // of the env holding it, -1 if it's looked up by name
+    int slot;
+    std::string name;
+    Value value;      // empty if it wasn't bound yet
+};
 
-    Builtin(const std::string builtin_name_in) : builtin_name(builtin_name_in) {}
+// Function whose results are kept by its args, made by the memo builtin.
+// Called like the function, which it otherwise stands in for.
+struct Memoized: public Object {
+    Value func;
+    MemoTable table;
+    std::vector<MemoBinding> bindings; // the table is only used while these hold
 
-    const std::string inspect() const override { return "builtin function"; }
-    std::string getStrVal() const override { return builtin_name; }
+    Memoized(Value func_in, size_t capacity, std::vector<MemoBinding> bindings_in);
+    ~Memoized() override;
 
-    int getType() const override { return OBJ_BUILTIN; }
+    const std::string inspect() const override { return func->inspect(); }
+    const std::string typeString() const override { return "FUNC"; }
+
+    BlockStatement* getBody() override { return func->getBody(); }
+    EnvPtr getEnv() override;
+
+    const std::vector<Identifier>& getParams() const override { return func->getParams(); }
+
+    int getType() const override { return OBJ_MEMO; }
 
-    std::shared_ptr<Object> clone() override { return std::make_shared<Builtin>(*this); }
+    void trace(void (*visit)(HeapCell*)) const override;
+    void clearRefs() override;
 };
 
-struct NIL: public Object {
-    const std::string inspect() const override { return "nil"; }
-    const std::string typeString() const override { return "NIL"; }
+typedef Value (*BuiltinFunc)(const std::vector<Value>& args);
 
-    int getType() const override { return OBJ_NIL; }
+// Takes any number of arguments
+const int ANY_ARITY = -1;
 
-    bool getBoolVal() const override { return false; }
+// Native function. The builtin registry makes one per name, which every
+// lookup of the name shares.
+struct Builtin: public Object {
+    std::string builtin_name;
+    BuiltinFunc func;
+    int arity;
+    bool is_pure; // gives the same result for the same args, without effects
 
-    std::shared_ptr<Object> clone() override { return std::make_shared<NIL>(*this); }
+    Builtin(const std::string& builtin_name_in, BuiltinFunc func_in, int arity_in, bool is_pure_in)
+        : builtin_name(builtin_name_in), func(func_in), arity(arity_in), is_pure(is_pure_in) {
+    }
+
+    const std::string inspect() const override { return "builtin function"; }
+    const std::string typeString() const override { return "BUILTIN"; }
+    const std::string& getStrVal() const override { return builtin_name; }
+
+    int getType() const override { return OBJ_BUILTIN; }
 };
 
 struct Error: public Object {
@@ -241,6 +287,166 @@ struct Error: public Object {
     const std::string typeString() const override { return "ERROR"; }
 
     int getType() const override { return OBJ_ERROR; }
+};
+
+// Call left for applyFunction to make once the current call has returned,
+// so tail calls don't grow the C++ stack
+struct TailCall: public Object {
+    Value func;
+    std::vector<Value> args;
+
+    TailCall(Value func_in, std::vector<Value> args_in) : func(func_in), args(args_in) {}
+
+    const std::string typeString() const override { return "TAIL_CALL"; }
+
+    int getType() const override { return OBJ_TAIL_CALL; }
+
+    void trace(void (*visit)(HeapCell*)) const override;
+    void clearRefs() override { args.clear(); func = nullptr; }
+};
+
+// Function body compiled to bytecode, used only by the VM
+struct CompiledFunction: public Object {
+    Instructions instructions;
+    int n_locals;
+    int n_params;
+    std::vector<Identifier> params;
+    BlockStatement* body;
+    std::shared_ptr<Arena> arena; // keeps body alive
+
+    CompiledFunction(const Instructions& instructions_in, int n_locals_in, const std::vector<Identifier>& params_in, BlockStatement* body_in, std::shared_ptr<Arena> arena_in)
+        : instructions(instructions_in), n_locals(n_locals_in), n_params(static_cast<int>(params_in.size())), params(params_in), body(body_in), arena(arena_in) {
+    }
+
+    const std::string inspect() const override;
+    const std::string typeString() const override { return "COMPILED_FUNC"; }
+
+    BlockStatement* getBody() override { return body; }
 
-    std::shared_ptr<Object> clone() override { return std::make_shared<Error>(*this); }
+    const std::vector<Identifier>& getParams() const override { return params; }
+
+    int getType() const override { return OBJ_COMPILED_FUNC; }
 };
+
+// Compiled function together with the values of its free variables
+struct Closure: public Object {
+    Value func;
+    std::vector<Value> free;
+
+    Closure(Value func_in, std::vector<Value> free_in)
+        : func(func_in), free(free_in) {
+    }
+
+    const CompiledFunction* compiled() const { return func.as<CompiledFunction>(); }
+
+    const std::string inspect() const override { return func->inspect(); }
+    const std::string typeString() const override { return "FUNC"; }
+
+    BlockStatement* getBody() override { return compiled()->body; }
+
+    const std::vector<Identifier>& getParams() const override { return compiled()->params; }
+
+    int getType() const override { return OBJ_CLOSURE; }
+
+    void trace(void (*visit)(HeapCell*)) const override;
+    void clearRefs() override { free.clear(); }
+};
+
+inline void Value::retain() const {
+    if (isObject())
+        asObject()->refs++;
+}
+
+inline void Value::release() const {
+    if (isObject() && --asObject()->refs == 0)
+        delete asObject();
+}
+
+inline void Value::trace(void (*visit)(HeapCell*)) const {
+    if (isObject())
+        visit(asObject());
+}
+
+inline Value::Value(double value) {
+    if (value != value)
+        m_bits = CANONICAL_NAN;
+    else
+        std::memcpy(&m_bits, &value, sizeof(value));
+}
+
+inline Value::Value(Object* obj)
+    : m_bits(TAG_OBJ | reinterpret_cast<uint64_t>(obj)) {
+    retain();
+}
+
+inline Value& Value::operator= (const Value& other) {
+    other.retain();
+    release();
+    m_bits = other.m_bits;
+
+    return *this;
+}
+
+inline Value& Value::operator= (Value&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_bits = other.m_bits;
+        other.m_bits = TAG_EMPTY;
+    }
+
+    return *this;
+}
+
+inline int Value::getType() const {
+    if (isInt())
+        return OBJ_INT;
+    if (isFloat())
+        return OBJ_FLOAT;
+    if (isBool())
+        return OBJ_BOOL;
+    if (isNil())
+        return OBJ_NIL;
+    if (isObject())
+        return asObject()->getType();
+
+    return -1;
+}
+
+inline int Value::getIntVal() const {
+    if (isInt())
+        return asInt();
+    if (isFloat())
+        return static_cast<int>(asFloat());
+    if (isBool())
+        return asBool();
+    if (isObject())
+        return asObject()->getIntVal();
+
+    return 0;
+}
+
+inline bool Value::getBoolVal() const {
+    if (isBool())
+        return asBool();
+    if (isInt())
+        return asInt() != 0;
+    if (isFloat())
+        return asFloat() != 0;
+    if (isNil())
+        return false;
+    if (isObject())
+        return asObject()->getBoolVal();
+
+    return true;
+}
+
+inline double Value::getFloatVal() const {
+    if (isFloat())
+        return asFloat();
+    if (isInt())
+        return static_cast<double>(asInt());
+    if (isObject())
+        return asObject()->getFloatVal();
+
+    return -1;
+}
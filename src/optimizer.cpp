@@ -0,0 +1,409 @@
+#include "optimizer.h"
+#include "evaluator.h"
+#include "resolver.h"
+
+static bool isLiteral(const ASTNodePtr& node) {
+    if (!node)
+        return false;
+
+    const int type = node->nodeType();
+
+    return type == NODE_INT || type == NODE_FLOAT || type == NODE_STR || type == NODE_BOOL;
+}
+
+static Value literalValue(const ASTNodePtr& node) {
+    switch (node->nodeType())
+    {
+    case NODE_INT:
+        return Value(node->getIntValue());
+    case NODE_FLOAT:
+        return Value(node->getFloatValue());
+    case NODE_STR:
+        return makeObject<String>(node->tokenLiteral());
+    default:
+        return Value(node->getBoolValue());
+    }
+}
+
+// Whether a let in node binds name in the scope node runs in
+static bool bindsName(const ASTNodePtr& node, const std::string& name) {
+    if (!node || node->nodeType() == NODE_FUNC)
+        return false;
+
+    if (node->nodeType() == NODE_LET_STMNT && node->getIdentName() == name)
+        return true;
+
+    for (const auto& child : childNodes(node)) {
+        if (bindsName(child, name))
+            return true;
+    }
+
+    return false;
+}
+
+static int countLets(const ASTNodePtr& node, const std::string& name) {
+    if (!node || node->nodeType() == NODE_FUNC)
+        return 0;
+
+    int n_lets = node->nodeType() == NODE_LET_STMNT && node->getIdentName() == name ? 1 : 0;
+    for (const auto& child : childNodes(node))
+        n_lets += countLets(child, name);
+
+    return n_lets;
+}
+
+static bool isOperator(const ASTNodePtr& node) {
+    return node->nodeType() == NODE_PREFIX || node->nodeType() == NODE_INFIX;
+}
+
+// Whether node only has literals, identifiers and operators. Adds up its
+// nodes in n_nodes and its identifiers in leaf order in idents.
+static bool isPureExpr(const ASTNodePtr& node, int& n_nodes, std::vector<ASTNodePtr>& idents) {
+    if (!node)
+        return false;
+
+    n_nodes++;
+
+    if (isLiteral(node))
+        return true;
+    if (node->nodeType() == NODE_IDENT) {
+        idents.push_back(node);
+        return true;
+    }
+    if (!isOperator(node))
+        return false;
+
+    if (node->nodeType() == NODE_INFIX && !isPureExpr(node->getLeft(), n_nodes, idents))
+        return false;
+
+    return isPureExpr(node->getRight(), n_nodes, idents);
+}
+
+// Leftmost leaf, the first one evaluated
+static ASTNodePtr firstLeaf(const ASTNodePtr& node) {
+    if (node->nodeType() == NODE_INFIX)
+        return firstLeaf(node->getLeft());
+    if (node->nodeType() == NODE_PREFIX)
+        return firstLeaf(node->getRight());
+
+    return node;
+}
+
+// A body that reads each param once, in order, reading the first one before
+// anything else, and nothing but the params
+static bool isInlinable(const ASTNodePtr& func) {
+    const auto& statements = func->getBody()->getStatements();
+    if (statements.size() != 1 || statements[0]->nodeType() != NODE_EXPR_STMNT)
+        return false;
+
+    const auto body = statements[0]->getExpr();
+    const auto& params = func->getParams();
+    int n_nodes = 0;
+    std::vector<ASTNodePtr> idents;
+
+    if (!isPureExpr(body, n_nodes, idents) || n_nodes > MAX_INLINED_NODES || idents.size() != params.size())
+        return false;
+
+    for (size_t i = 0; i < idents.size(); i++) {
+        if (idents[i]->getIdentName() != params[i].getIdentName())
+            return false;
+    }
+
+    return params.empty() || firstLeaf(body) == idents[0];
+}
+
+static Token tokenOf(int oprtr) {
+    switch (oprtr)
+    {
+    case OPRTR_ADD:
+        return Token(TOK_PLUS, "+");
+    case OPRTR_SUB:
+        return Token(TOK_MINUS, "-");
+    case OPRTR_MUL:
+        return Token(TOK_MUL, "*");
+    case OPRTR_DIV:
+        return Token(TOK_DIV, "/");
+    case OPRTR_LT:
+        return Token(TOK_LT, "<");
+    case OPRTR_GT:
+        return Token(TOK_GT, ">");
+    case OPRTR_EQ:
+        return Token(TOK_EQ, "==");
+    case OPRTR_NOT_EQ:
+        return Token(TOK_NOT_EQ, "!=");
+    default:
+        return Token(TOK_BANG, "!");
+    }
+}
+
+// Forgets the constants statement binds again, even in a nested block that
+// may not run
+static void forgetBound(const ASTNodePtr& statement, Constants& constants) {
+    for (auto it = constants.begin(); it != constants.end();) {
+        if (bindsName(statement, it->first))
+            it = constants.erase(it);
+        else
+            ++it;
+    }
+}
+
+void Optimizer::optimize(const std::shared_ptr<Program>& program) {
+    m_arena = &program->arena();
+    m_body = nullptr;
+    m_n_params = 0;
+    m_inlinable.clear();
+
+    optimizeStatements(program->getStatements(), Constants());
+}
+
+void Optimizer::optimizeStatements(const std::vector<Statement*>& statements, Constants constants) {
+    const size_t n = statements.size();
+
+    for (size_t i = 0; i < n; i++) {
+        const auto statement = statements[i];
+        forgetBound(statement, constants);
+
+        switch (statement->nodeType())
+        {
+        case NODE_LET_STMNT: {
+            auto value = fold(statement->getExpr(), constants);
+            static_cast<LetStatement*>(statement)->setValue(value);
+
+            bool is_bound_again = false;
+            for (size_t j = i + 1; j < n && !is_bound_again; j++)
+                is_bound_again = bindsName(statements[j], statement->getIdentName());
+
+            if (isLiteral(value) && !is_bound_again)
+                constants[statement->getIdentName()] = value;
+
+            if (value && value->nodeType() == NODE_FUNC && isInlinable(value))
+                m_inlinable[statement->getIdentName()] = value;
+            break;
+        }
+        case NODE_RETURN_STMNT:
+            static_cast<ReturnStatement*>(statement)->setValue(fold(statement->getExpr(), constants));
+            break;
+        case NODE_EXPR_STMNT:
+            static_cast<ExprStatement*>(statement)->setExpr(fold(statement->getExpr(), constants));
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// Folds the children of node and returns what replaces node
+ExprPtr Optimizer::fold(const ASTNodePtr& node, const Constants& constants) {
+    if (!node)
+        return nullptr;
+
+    auto expr = static_cast<ExprPtr>(node);
+
+    switch (node->nodeType())
+    {
+    case NODE_IDENT: {
+        auto constant = constants.find(node->getIdentName());
+        if (constant != constants.end())
+            return constant->second;
+
+        return expr;
+    }
+    case NODE_PREFIX:
+        static_cast<PrefixExpr*>(node)->setRight(fold(node->getRight(), constants));
+        return foldPrefix(node);
+    case NODE_INFIX:
+        static_cast<InfixExpr*>(node)->setLeft(fold(node->getLeft(), constants));
+        static_cast<InfixExpr*>(node)->setRight(fold(node->getRight(), constants));
+        return foldInfix(node);
+    case NODE_IF_EXPR:
+        static_cast<IfExpr*>(node)->setCondition(fold(node->getCondition(), constants));
+        optimizeStatements(node->getConsequence()->getStatements(), constants);
+        if (node->getAlternative())
+            optimizeStatements(node->getAlternative()->getStatements(), constants);
+        return expr;
+    case NODE_FUNC: {
+        // The function may run after anything else in the enclosing one, so
+        // it only gets the locals bound once there. Top level names may be
+        // bound again by a later program.
+        Constants inner;
+        if (m_body) {
+            for (const auto& [name, literal] : constants) {
+                if (countLets(m_body, name) == 1)
+                    inner[name] = literal;
+            }
+        }
+
+        for (const auto& param : node->getParams())
+            inner.erase(param.getIdentName());
+
+        auto enclosing = m_body;
+        const int enclosing_n_params = m_n_params;
+        m_body = node->getBody();
+        m_n_params = static_cast<int>(node->getParams().size());
+        optimizeStatements(m_body->getStatements(), inner);
+        m_body = enclosing;
+        m_n_params = enclosing_n_params;
+        return expr;
+    }
+    case NODE_CALL_EXPR: {
+        static_cast<CallExpr*>(node)->setFunc(fold(node->getFunc(), constants));
+
+        std::vector<ExprPtr> args;
+        for (const auto& arg : node->getArgs())
+            args.push_back(fold(arg, constants));
+
+        static_cast<CallExpr*>(node)->setArgs(args);
+        return inlineCall(node);
+    }
+    case NODE_ARRAY: {
+        std::vector<ExprPtr> elements;
+        for (const auto& element : node->getElements())
+            elements.push_back(fold(element, constants));
+
+        static_cast<ArrayLiteral*>(node)->setElements(elements);
+        return expr;
+    }
+    case NODE_HASH: {
+        // Pairs are evaluated in the order of their key nodes, so keys keep
+        // their nodes and only get their children folded
+        std::map<ExprPtr, ExprPtr> pairs;
+        for (const auto& [key, value] : node->getPairs()) {
+            fold(key, constants);
+            pairs[key] = fold(value, constants);
+        }
+
+        static_cast<HashLiteral*>(node)->setPairs(pairs);
+        return expr;
+    }
+    case NODE_INDEX:
+        static_cast<IndexExpr*>(node)->setLeft(fold(node->getLeft(), constants));
+        static_cast<IndexExpr*>(node)->setIndex(fold(node->getIndex(), constants));
+        return expr;
+    default:
+        return expr;
+    }
+}
+
+ExprPtr Optimizer::foldPrefix(const ASTNodePtr& node) {
+    if (!isLiteral(node->getRight()))
+        return static_cast<ExprPtr>(node);
+
+    auto folded = makeLiteral(evaluator::evalPrefixExpr(node->getOprtr(), literalValue(node->getRight())));
+
+    return folded ? folded : static_cast<ExprPtr>(node);
+}
+
+ExprPtr Optimizer::foldInfix(const ASTNodePtr& node) {
+    auto left = node->getLeft();
+    auto right = node->getRight();
+
+    if (!isLiteral(left) || !isLiteral(right))
+        return static_cast<ExprPtr>(node);
+
+    auto folded = makeLiteral(evaluator::evalInfixExpr(node->getOprtr(), literalValue(left), literalValue(right)));
+
+    return folded ? folded : static_cast<ExprPtr>(node);
+}
+
+// Literal node evaluating to value, nullptr for errors and anything else
+// that has no literal
+ExprPtr Optimizer::makeLiteral(const Value& value) {
+    switch (value->getType())
+    {
+    case OBJ_INT: {
+        auto literal = m_arena->make<std::string>(std::to_string(value.asInt()));
+        auto node = m_arena->make<IntegerLiteral>(Token(TOK_INT, *literal));
+        node->setValue(value.asInt());
+        return node;
+    }
+    case OBJ_FLOAT: {
+        auto literal = m_arena->make<std::string>(value->inspect());
+        auto node = m_arena->make<FloatLiteral>(Token(TOK_FLOAT, *literal));
+        node->setValue(value.asFloat());
+        return node;
+    }
+    case OBJ_STR: {
+        auto literal = m_arena->make<std::string>(value->getStrVal());
+        return m_arena->make<StringLiteral>(Token(TOK_STR, *literal), *literal);
+    }
+    case OBJ_BOOL:
+        if (value.asBool())
+            return m_arena->make<BoolExpr>(Token(TOK_TRUE, "true"), true);
+        return m_arena->make<BoolExpr>(Token(TOK_FALSE, "false"), false);
+    default:
+        return nullptr;
+    }
+}
+
+// Args are evaluated in the body when it reads the params instead of all
+// before it. The first one is still evaluated first, so it can be anything
+// that gives a value, also a call. The others must not give an error or
+// have an effect, which would then come after some operators of the body
+// instead of before them. Those are literals and params of the enclosing
+// function, which are always bound.
+bool Optimizer::canInlineArgs(const std::vector<ExprPtr>& args) {
+    for (size_t i = 0; i < args.size(); i++) {
+        if (i == 0) {
+            int n_nodes = 0;
+            std::vector<ASTNodePtr> idents;
+            const int type = args[i]->nodeType();
+
+            if (type != NODE_CALL_EXPR && type != NODE_INLINED_CALL && !isPureExpr(args[i], n_nodes, idents))
+                return false;
+            continue;
+        }
+
+        const bool is_param = args[i]->nodeType() == NODE_IDENT && m_body && args[i]->getDepth() == 0 &&
+                              args[i]->getSlot() >= 0 && args[i]->getSlot() < m_n_params;
+
+        if (!isLiteral(args[i]) && !is_param)
+            return false;
+    }
+
+    return true;
+}
+
+ExprPtr Optimizer::inlineCall(const ASTNodePtr& call) {
+    auto func = call->getFunc();
+    if (!func || func->nodeType() != NODE_IDENT)
+        return static_cast<ExprPtr>(call);
+
+    auto inlinable = m_inlinable.find(func->getIdentName());
+    if (inlinable == m_inlinable.end())
+        return static_cast<ExprPtr>(call);
+
+    const auto literal = inlinable->second;
+    const auto& args = call->getArgs();
+
+    if (args.size() != literal->getParams().size() || !canInlineArgs(args))
+        return static_cast<ExprPtr>(call);
+
+    auto body = substitute(literal->getBody()->getStatements()[0]->getExpr(), literal->getParams(), args);
+
+    return m_arena->make<InlinedCall>(static_cast<CallExpr*>(call), literal->getBody(), fold(body, Constants()));
+}
+
+// Copy of the operators of a body, with args in place of the params
+ExprPtr Optimizer::substitute(const ASTNodePtr& node, const std::vector<Identifier>& params, const std::vector<ExprPtr>& args) {
+    switch (node->nodeType())
+    {
+    case NODE_IDENT:
+        for (size_t i = 0; i < params.size(); i++) {
+            if (params[i].getIdentName() == node->getIdentName())
+                return args[i];
+        }
+        return static_cast<ExprPtr>(node);
+    case NODE_PREFIX: {
+        auto prefix = m_arena->make<PrefixExpr>(tokenOf(node->getOprtr()), static_cast<oprtr_type>(node->getOprtr()));
+        prefix->setRight(substitute(node->getRight(), params, args));
+        return prefix;
+    }
+    case NODE_INFIX: {
+        auto infix = m_arena->make<InfixExpr>(tokenOf(node->getOprtr()), substitute(node->getLeft(), params, args), static_cast<oprtr_type>(node->getOprtr()));
+        infix->setRight(substitute(node->getRight(), params, args));
+        return infix;
+    }
+    default:
+        return static_cast<ExprPtr>(node);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "ast.h"
+#include "value.h"
+
+// Nodes in a body that still gets inlined
+const int MAX_INLINED_NODES = 16;
+
+// Literal node a name is known to hold
+typedef std::map<std::string, ExprPtr> Constants;
+
+// Rewrites a resolved program in place before it runs. Prefix and infix
+// operators on literals are folded into a literal, unless evaluating them
+// gives an error, which is then left to happen at run time. A let of a
+// literal is propagated into the rest of its block when nothing there binds
+// the name again, and into the functions made there when nothing else in the
+// enclosing function does. Top level lets aren't propagated into functions,
+// since a later program may bind the name again before they're called.
+//
+// Calls of a small function literal bound by let, whose body is a single
+// expression of its params, literals and operators, are inlined when the
+// args can be evaluated in the body without changing any result (see
+// canInlineArgs). The inlined body only runs after checking that the name
+// still refers to a function of that literal, so binding it again, even in
+// a later program, falls back to the call.
+class Optimizer {
+    Arena* m_arena {nullptr};
+    BlockStatement* m_body {nullptr}; // of the function being optimized
+    int m_n_params {0};               // of that function
+    std::map<std::string, ASTNodePtr> m_inlinable; // latest literal let by name
+
+    void optimizeStatements(const std::vector<Statement*>& statements, Constants constants);
+    ExprPtr fold(const ASTNodePtr& node, const Constants& constants);
+    ExprPtr foldPrefix(const ASTNodePtr& node);
+    ExprPtr foldInfix(const ASTNodePtr& node);
+    ExprPtr makeLiteral(const Value& value);
+
+    bool canInlineArgs(const std::vector<ExprPtr>& args);
+    ExprPtr inlineCall(const ASTNodePtr& call);
+    ExprPtr substitute(const ASTNodePtr& node, const std::vector<Identifier>& params, const std::vector<ExprPtr>& args);
+
+public:
+    void optimize(const std::shared_ptr<Program>& program);
+};
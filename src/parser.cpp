@@ -1,10 +1,13 @@
 #include "parser.h"
+#include "resolver.h"
 
 #include <algorithm>
+#include <charconv>
 #include <iostream>
 
 Parser::Parser(const Lexer& lexer)
-    : m_lexer(lexer) {
+    : m_lexer(lexer), m_arena(std::make_shared<Arena>()) {
+    m_arena->retain(m_lexer.source());
     nextToken();
     nextToken();
 }
@@ -24,7 +27,10 @@ void Parser::peekError(token_type tok_type) {
 }
 
 std::shared_ptr<Program> Parser::parseProgram() {
-    auto program = std::make_shared<Program>();
+    // Each program gets an arena of its own, freed together with the tree
+    m_arena = std::make_shared<Arena>();
+    m_arena->retain(m_lexer.source());
+    auto program = std::make_shared<Program>(m_arena);
 
     while (m_cur_tok.type != TOK_EOF) {
         auto statement = parseStatement();
@@ -35,10 +41,13 @@ std::shared_ptr<Program> Parser::parseProgram() {
         nextToken();
     }
 
+    Resolver resolver;
+    resolver.resolve(program.get());
+
     return program;
 }
 
-std::shared_ptr<Statement> Parser::parseStatement() {
+Statement* Parser::parseStatement() {
     switch (m_cur_tok.type)
     {
     case TOK_LET:
@@ -50,13 +59,13 @@ std::shared_ptr<Statement> Parser::parseStatement() {
     }
 }
 
-std::shared_ptr<LetStatement> Parser::parseLetStatement() {
-    auto statement = std::make_shared<LetStatement>(m_cur_tok);
+LetStatement* Parser::parseLetStatement() {
+    auto statement = m_arena->make<LetStatement>(m_cur_tok);
 
     if (!expectPeek(TOK_IDENT))
         return nullptr;
 
-    Identifier ident(m_cur_tok, m_cur_tok.literal);
+    Identifier ident(m_cur_tok, std::string(m_cur_tok.literal));
     statement->setName(ident);
 
     if (!expectPeek(TOK_ASSIGN))
@@ -72,8 +81,8 @@ std::shared_ptr<LetStatement> Parser::parseLetStatement() {
     return statement;
 }
 
-std::shared_ptr<ReturnStatement> Parser::parseReturnStatement() {
-    auto statement = std::make_shared<ReturnStatement>(m_cur_tok);
+ReturnStatement* Parser::parseReturnStatement() {
+    auto statement = m_arena->make<ReturnStatement>(m_cur_tok);
 
     nextToken();
 
@@ -85,8 +94,8 @@ std::shared_ptr<ReturnStatement> Parser::parseReturnStatement() {
     return statement;
 }
 
-std::shared_ptr<ExprStatement> Parser::parseExprStatement() {
-    auto statement = std::make_shared<ExprStatement>(m_cur_tok);
+ExprStatement* Parser::parseExprStatement() {
+    auto statement = m_arena->make<ExprStatement>(m_cur_tok);
     auto expr = parseExpr(LOWEST);
 
     statement->setExpr((expr));
@@ -158,42 +167,46 @@ ExprPtr Parser::parseExpr(int precedence) {
 }
 
 ExprPtr Parser::parseIdentifier() {
-    auto ident = std::make_shared<Identifier>(m_cur_tok, m_cur_tok.literal);
+    auto ident = m_arena->make<Identifier>(m_cur_tok, std::string(m_cur_tok.literal));
 
     return ident;
 }
 
 ExprPtr Parser::parseIntegerLiteral() {
-    auto int_lit = std::make_shared<IntegerLiteral>(m_cur_tok);
+    auto int_lit = m_arena->make<IntegerLiteral>(m_cur_tok);
+
+    const auto literal = m_cur_tok.literal;
+    int value = 0;
 
-    if (!isNumber(m_cur_tok)) {
-        const std::string error = "could not parse " + m_cur_tok.literal + " as integer";
+    // from_chars reads the span in place, without a temporary string
+    if (!isNumber(m_cur_tok) || std::from_chars(literal.data(), literal.data() + literal.size(), value).ec != std::errc()) {
+        const std::string error = "could not parse " + std::string(literal) + " as integer";
         m_errors.push_back(error);
         return nullptr;
     }
 
-    int_lit->setValue(stoi(m_cur_tok.literal));
+    int_lit->setValue(value);
 
     return int_lit;
 }
 
 ExprPtr Parser::parseFloatLiteral() {
-    auto float_lit = std::make_shared<FloatLiteral>(m_cur_tok);
-    float_lit->setValue(stod(m_cur_tok.literal));
+    auto float_lit = m_arena->make<FloatLiteral>(m_cur_tok);
+    float_lit->setValue(stod(std::string(m_cur_tok.literal)));
 
     return float_lit;
 }
 
 ExprPtr Parser::parseStringLiteral() {
-    return std::make_shared<StringLiteral>(m_cur_tok, m_cur_tok.literal);
+    return m_arena->make<StringLiteral>(m_cur_tok, std::string(m_cur_tok.literal));
 }
 
 ExprPtr Parser::parseBoolean() {
-    return std::make_shared<BoolExpr>(m_cur_tok, curTokenIs(TOK_TRUE));
+    return m_arena->make<BoolExpr>(m_cur_tok, curTokenIs(TOK_TRUE));
 }
 
 ExprPtr Parser::parsePrefixExpr() {
-    auto expr = std::make_shared<PrefixExpr>(m_cur_tok, m_cur_tok.literal);
+    auto expr = m_arena->make<PrefixExpr>(m_cur_tok, toOprtr(m_cur_tok.type));
 
     nextToken();
 
@@ -204,7 +217,7 @@ ExprPtr Parser::parsePrefixExpr() {
 }
 
 ExprPtr Parser::parseInfixExpr(ExprPtr left) {
-    auto infix_expr = std::make_shared<InfixExpr>(m_cur_tok, (left), m_cur_tok.literal);
+    auto infix_expr = m_arena->make<InfixExpr>(m_cur_tok, (left), toOprtr(m_cur_tok.type));
 
     const int precedence = curPrecedence();
 
@@ -228,7 +241,7 @@ ExprPtr Parser::parseGroupedExpr() {
 }
 
 ExprPtr Parser::parseIfExpr() {
-    auto expr = std::make_shared<IfExpr>(m_cur_tok);
+    auto expr = m_arena->make<IfExpr>(m_cur_tok);
 
     if (!expectPeek(TOK_LPAREN))
         return nullptr;
@@ -257,7 +270,7 @@ ExprPtr Parser::parseIfExpr() {
 }
 
 ExprPtr Parser::parseFuncLiteral() {
-    auto func_literal = std::make_shared<FuncLiteral>(m_cur_tok);
+    auto func_literal = m_arena->make<FuncLiteral>(m_cur_tok, m_arena.get());
 
     if (!expectPeek(TOK_LPAREN))
         return nullptr;
@@ -273,21 +286,21 @@ ExprPtr Parser::parseFuncLiteral() {
 }
 
 ExprPtr Parser::parseCallExpr(ExprPtr func) {
-    auto call_expr = std::make_shared<CallExpr>(m_cur_tok, (func));
+    auto call_expr = m_arena->make<CallExpr>(m_cur_tok, (func));
     call_expr->setArgs(parseExprList(TOK_RPAREN));
 
     return call_expr;
 }
 
 ExprPtr Parser::parseArrayLiteral() {
-    auto arr = std::make_shared<ArrayLiteral>(m_cur_tok);
+    auto arr = m_arena->make<ArrayLiteral>(m_cur_tok);
     arr->setElements(parseExprList(TOK_RBRACKET));
 
     return arr;
 }
 
 ExprPtr Parser::parseIndexExpr(ExprPtr left) {
-    auto expr = std::make_shared<IndexExpr>(m_cur_tok, left);
+    auto expr = m_arena->make<IndexExpr>(m_cur_tok, left);
 
     nextToken();
     expr->setIndex(parseExpr(LOWEST));
@@ -299,7 +312,7 @@ ExprPtr Parser::parseIndexExpr(ExprPtr left) {
 }
 
 ExprPtr Parser::parseHashLiteral() {
-    auto hash = std::make_shared<HashLiteral>(m_cur_tok);
+    auto hash = m_arena->make<HashLiteral>(m_cur_tok);
     std::map<ExprPtr, ExprPtr> pairs;
 
     while (!peekTokenIs(TOK_RBRACE)) {
@@ -351,8 +364,8 @@ std::vector<ExprPtr> Parser::parseExprList(token_type end_tok) {
     return list;
 }
 
-std::shared_ptr<BlockStatement> Parser::parseBlockStatement() {
-    auto block = std::make_shared<BlockStatement>(m_cur_tok);
+BlockStatement* Parser::parseBlockStatement() {
+    auto block = m_arena->make<BlockStatement>(m_cur_tok);
 
     nextToken();
 
@@ -378,13 +391,13 @@ std::vector<Identifier> Parser::parseFuncParameters() {
 
     nextToken();
 
-    params.push_back(Identifier(m_cur_tok, m_cur_tok.literal));
+    params.push_back(Identifier(m_cur_tok, std::string(m_cur_tok.literal)));
 
     while (peekTokenIs(TOK_COMMA)) {
         nextToken();
         nextToken();
 
-        params.push_back(Identifier(m_cur_tok, m_cur_tok.literal));
+        params.push_back(Identifier(m_cur_tok, std::string(m_cur_tok.literal)));
     }
 
     if (!expectPeek(TOK_RPAREN))
@@ -412,7 +425,7 @@ bool Parser::expectPeek(token_type tok_type) {
 }
 
 bool Parser::isNumber(const Token& tok) {
-    const std::string str = tok.literal;
+    const std::string_view str = tok.literal;
 
     return !str.empty() && std::find_if(str.begin(),
         str.end(), [](unsigned char c) { return !std::isdigit(c); }) == str.end();
@@ -18,6 +18,7 @@ enum precedence {
 
 class Parser {
     Lexer m_lexer;
+    std::shared_ptr<Arena> m_arena;
 
     Token m_cur_tok;
     Token m_peek_tok;
@@ -33,10 +34,10 @@ public:
     const std::vector<std::string> errors() const { return m_errors; }
 
     std::shared_ptr<Program> parseProgram();
-    std::shared_ptr<Statement> parseStatement();
-    std::shared_ptr<LetStatement> parseLetStatement();
-    std::shared_ptr<ReturnStatement> parseReturnStatement();
-    std::shared_ptr<ExprStatement> parseExprStatement();
+    Statement* parseStatement();
+    LetStatement* parseLetStatement();
+    ReturnStatement* parseReturnStatement();
+    ExprStatement* parseExprStatement();
 
     ExprPtr parseExpr(int precedence);
     ExprPtr parseIdentifier();
@@ -54,7 +55,7 @@ public:
     ExprPtr parseIndexExpr(ExprPtr left);
     ExprPtr parseHashLiteral();
 
-    std::shared_ptr<BlockStatement> parseBlockStatement();
+    BlockStatement* parseBlockStatement();
 
     std::vector<Identifier> parseFuncParameters();
     std::vector<ExprPtr> parseExprList(token_type end_tok);
@@ -0,0 +1,202 @@
+#include "persistent_vector.h"
+#include "object.h"
+
+#include <cstring>
+
+// Boxes the values of a packed leaf
+static void unpack(VectorNode& leaf) {
+    if (leaf.kind == LEAF_INT) {
+        leaf.values.reserve(VECTOR_WIDTH);
+        for (auto value : leaf.ints)
+            leaf.values.push_back(Value(value));
+
+        leaf.ints = std::vector<int32_t>();
+    }
+
+    leaf.kind = LEAF_BOXED;
+}
+
+void VectorNode::trace(void (*visit)(HeapCell*)) const {
+    for (const auto& value : values)
+        value.trace(visit);
+    for (const auto& child : children)
+        visit(child.get());
+}
+
+void VectorNode::push(const Value& value) {
+    if (size() == 0)
+        kind = value.isInt() ? LEAF_INT : (value.isFloat() ? LEAF_FLOAT : LEAF_BOXED);
+    else if ((kind == LEAF_INT && !value.isInt()) || (kind == LEAF_FLOAT && !value.isFloat()))
+        unpack(*this);
+
+    if (kind == LEAF_INT)
+        ints.push_back(value.asInt());
+    else
+        values.push_back(value);
+}
+
+void VectorNode::reserve(size_t n) {
+    if (kind == LEAF_INT)
+        ints.reserve(n);
+    else
+        values.reserve(n);
+}
+
+const double* VectorNode::floats(double* buffer) const {
+    std::memcpy(buffer, static_cast<const void*>(values.data()), values.size() * sizeof(double));
+    return buffer;
+}
+
+void VectorNode::clearRefs() {
+    values.clear();
+    children.clear();
+}
+
+// Gives node to this vector alone, copying it if it is shared
+static void makeUnique(VectorNodePtr& node) {
+    if (node->refs == 1)
+        return;
+
+    auto copy = makeRef<VectorNode>();
+    copy->kind = node->kind;
+    copy->values = node->values;
+    copy->ints = node->ints;
+    copy->children = node->children;
+    node = copy;
+}
+
+// Chain of branches down to node, for a leaf that starts a new subtree
+static VectorNodePtr newPath(unsigned int level, const VectorNodePtr& node) {
+    if (level == 0)
+        return node;
+
+    auto branch = makeRef<VectorNode>();
+    branch->children.push_back(newPath(level - VECTOR_BITS, node));
+
+    return branch;
+}
+
+PersistentVector::PersistentVector()
+    : m_shift(VECTOR_BITS) {
+}
+
+PersistentVector::PersistentVector(const std::vector<Value>& values)
+    : m_shift(VECTOR_BITS) {
+    for (const auto& value : values)
+        append(value);
+}
+
+// Index of the first value in the tail
+size_t PersistentVector::tailOffset() const {
+    if (m_size < VECTOR_WIDTH)
+        return 0;
+
+    return ((m_size - 1) >> VECTOR_BITS) << VECTOR_BITS;
+}
+
+const VectorNode* PersistentVector::leafFor(size_t index) const {
+    if (index >= tailOffset())
+        return m_tail.get();
+
+    const VectorNode* node = m_root.get();
+
+    for (unsigned int level = m_shift; level > 0; level -= VECTOR_BITS)
+        node = node->children[(index >> level) % VECTOR_WIDTH].get();
+
+    return node;
+}
+
+PersistentVector PersistentVector::push(const Value& value) const {
+    PersistentVector pushed = *this;
+    pushed.append(value);
+
+    return pushed;
+}
+
+void PersistentVector::append(const Value& value) {
+    if (!m_tail)
+        m_tail = makeRef<VectorNode>();
+
+    if (m_size - tailOffset() < VECTOR_WIDTH) {
+        makeUnique(m_tail);
+        m_tail->push(value);
+        m_size++;
+        return;
+    }
+
+    // The tail is full, move it into the trie and start a new one
+    commitTail();
+
+    m_tail = makeRef<VectorNode>();
+    m_tail->push(value);
+    m_tail->reserve(VECTOR_WIDTH);
+    m_size++;
+}
+
+void PersistentVector::appendLeaf(const VectorNodePtr& leaf) {
+    if (leaf->size() == 0)
+        return;
+
+    if (m_size > 0)
+        commitTail();
+
+    m_tail = leaf;
+    m_size += leaf->size();
+}
+
+// Moves the full tail into the trie, growing it by a level when it's full
+void PersistentVector::commitTail() {
+    if (!m_root)
+        m_root = makeRef<VectorNode>();
+
+    if ((m_size >> VECTOR_BITS) > (size_t(1) << m_shift)) {
+        auto root = makeRef<VectorNode>();
+        root->children.push_back(m_root);
+        root->children.push_back(newPath(m_shift, m_tail));
+        m_root = root;
+        m_shift += VECTOR_BITS;
+    } else {
+        pushTail(m_shift, m_root, m_tail);
+    }
+}
+
+void PersistentVector::pushTail(unsigned int level, VectorNodePtr& parent, const VectorNodePtr& tail) {
+    makeUnique(parent);
+
+    const size_t child = ((m_size - 1) >> level) % VECTOR_WIDTH;
+    auto& children = parent->children;
+
+    if (level == VECTOR_BITS)
+        children.push_back(tail);
+    else if (child < children.size())
+        pushTail(level - VECTOR_BITS, children[child], tail);
+    else
+        children.push_back(newPath(level - VECTOR_BITS, tail));
+}
+
+void PersistentVector::trace(void (*visit)(HeapCell*)) const {
+    if (m_root)
+        visit(m_root.get());
+    if (m_tail)
+        visit(m_tail.get());
+}
+
+void PersistentVector::clear() {
+    m_size = 0;
+    m_shift = VECTOR_BITS;
+    m_root = nullptr;
+    m_tail = nullptr;
+}
+
+PersistentVector::Iterator::Iterator(const PersistentVector* vector, size_t index)
+    : m_vector(vector), m_index(index), m_leaf(index < vector->size() ? vector->leafFor(index) : nullptr) {
+}
+
+PersistentVector::Iterator& PersistentVector::Iterator::operator++ () {
+    m_index++;
+
+    if (m_index % VECTOR_WIDTH == 0 && m_index < m_vector->size())
+        m_leaf = m_vector->leafFor(m_index);
+
+    return *this;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+
+#include "heap.h"
+#include "value.h"
+
+const unsigned int VECTOR_BITS = 5;
+const size_t VECTOR_WIDTH = 1 << VECTOR_BITS;
+
+enum leaf_kind {
+    LEAF_BOXED,
+    LEAF_INT,   // values are packed into ints
+    LEAF_FLOAT  // every value is a double, which a Value stores as is
+};
+
+// Node of a PersistentVector trie. Leaves hold up to 32 values, branches up
+// to 32 children. Nodes are shared between the vectors built from each
+// other, so they are heap cells the collector can see.
+struct VectorNode: public HeapCell {
+    leaf_kind kind {LEAF_BOXED};
+    std::vector<Value> values;
+    std::vector<int32_t> ints;
+    std::vector<Ref<VectorNode>> children;
+
+    size_t size() const { return kind == LEAF_INT ? ints.size() : values.size(); }
+    Value at(size_t index) const { return kind == LEAF_INT ? Value(ints[index]) : values[index]; }
+
+    // The first value of a leaf picks its kind, a value of another type
+    // turns it into a boxed leaf
+    void push(const Value& value);
+    void reserve(size_t n);
+
+    // The values of a LEAF_FLOAT leaf as doubles, copied into buffer
+    const double* floats(double* buffer) const;
+
+    void trace(void (*visit)(HeapCell*)) const override;
+    void clearRefs() override;
+};
+
+typedef Ref<VectorNode> VectorNodePtr;
+
+// Immutable vector with structural sharing: a 32-way trie of every full
+// block of 32 values plus a tail holding the last, partial block. push()
+// returns a new vector that shares all but the path to the changed leaf,
+// so it and indexing cost O(log32 n) and no values are copied. Blocks of
+// ints or floats are stored unboxed.
+class PersistentVector {
+    size_t m_size {0};
+    unsigned int m_shift;
+    VectorNodePtr m_root;
+    VectorNodePtr m_tail;
+
+    size_t tailOffset() const;
+
+    void pushTail(unsigned int level, VectorNodePtr& parent, const VectorNodePtr& tail);
+    void commitTail();
+
+public:
+    class Iterator {
+        const PersistentVector* m_vector;
+        size_t m_index;
+        const VectorNode* m_leaf;
+
+    public:
+        Iterator(const PersistentVector* vector, size_t index);
+
+        Value operator* () const { return m_leaf->at(m_index % VECTOR_WIDTH); }
+        Iterator& operator++ ();
+
+        bool operator!= (const Iterator& other) const { return m_index != other.m_index; }
+    };
+
+    PersistentVector();
+    PersistentVector(const std::vector<Value>& values);
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    // Unchecked, index must be < size()
+    Value operator[] (size_t index) const { return leafFor(index)->at(index % VECTOR_WIDTH); }
+
+    // Leaf holding index, whose values start at index - index % 32
+    const VectorNode* leafFor(size_t index) const;
+
+    // Calls visit with every leaf in order, for loops over whole blocks
+    template <typename F>
+    void forEachLeaf(F visit) const {
+        for (size_t index = 0; index < m_size; index += VECTOR_WIDTH)
+            visit(*leafFor(index));
+    }
+
+    Value front() const { return (*this)[0]; }
+    Value back() const { return (*this)[m_size - 1]; }
+
+    // New vector with value added to the end, this one is left as it is
+    PersistentVector push(const Value& value) const;
+
+    // Adds value to the end of this vector. Copies the nodes it changes if
+    // another vector shares them, so the other one never sees the change.
+    void append(const Value& value);
+
+    // Adds the values of leaf at once. The vector must end at a leaf
+    // boundary, which it does while it's built from the leaves of another.
+    void appendLeaf(const VectorNodePtr& leaf);
+
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, m_size); }
+
+    void trace(void (*visit)(HeapCell*)) const;
+    void clear();
+};
@@ -0,0 +1,199 @@
+#include "purity.h"
+#include "builtin.h"
+#include "env.h"
+#include "resolver.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace purity {
+
+// Function literal the walk is in
+struct Level {
+    size_t n_params;
+    std::map<int, bool> let_funcs; // slot -> whether every let of it is a function literal
+};
+
+struct Walk {
+    EnvPtr env; // the checked function was made in
+    std::vector<Level> levels; // innermost last
+    std::set<const BlockStatement*>& checked;
+    std::vector<MemoBinding>& bindings;
+};
+
+static std::string checkFunc(const Value& func, std::set<const BlockStatement*>& checked, std::vector<MemoBinding>& bindings);
+static std::string checkNode(const ASTNodePtr& node, Walk& walk);
+
+// Lets of the function, without descending into nested functions
+static void collectLets(const ASTNodePtr& node, Level& level) {
+    if (!node || node->nodeType() == NODE_FUNC)
+        return;
+
+    if (node->nodeType() == NODE_LET_STMNT) {
+        const auto value = node->getExpr();
+        const bool is_func = value && value->nodeType() == NODE_FUNC;
+        auto search = level.let_funcs.find(node->getSlot());
+
+        level.let_funcs[node->getSlot()] = is_func && (search == level.let_funcs.end() || search->second);
+    }
+
+    for (const auto& child : childNodes(node))
+        collectLets(child, level);
+}
+
+static std::string checkValue(const std::string& name, const Value& value, Walk& walk) {
+    if (!value)
+        return "";
+
+    switch (value->getType())
+    {
+    case OBJ_BUILTIN:
+        return value.as<Builtin>()->is_pure ? "" : "uses impure builtin '" + name + "'";
+    case OBJ_FUNC:
+    case OBJ_MEMO: {
+        const auto reason = checkFunc(value, walk.checked, walk.bindings);
+        return reason.empty() ? "" : "uses '" + name + "', which " + reason;
+    }
+    default:
+        return "captures '" + name + "'";
+    }
+}
+
+static std::string checkIdentifier(const ASTNodePtr& node, Walk& walk, bool is_called) {
+    const std::string name = node->getIdentName();
+    const int depth = node->getDepth();
+    const int innermost = static_cast<int>(walk.levels.size()) - 1;
+
+    if (depth >= 0 && depth <= innermost) {
+        if (!is_called)
+            return "";
+
+        const auto& level = walk.levels[static_cast<size_t>(innermost - depth)];
+        const int slot = node->getSlot();
+        auto search = level.let_funcs.find(slot);
+
+        if (slot >= 0 && static_cast<size_t>(slot) >= level.n_params && search != level.let_funcs.end() && search->second)
+            return "";
+
+        return "calls '" + name + "', which it can't check";
+    }
+
+    MemoBinding binding {walk.env, depth >= 0 ? depth - innermost - 1 : -1, node->getSlot(), name, nullptr};
+    binding.value = lookup(binding);
+
+    const bool is_known = std::any_of(walk.bindings.begin(), walk.bindings.end(), [&](const MemoBinding& other) {
+        return other.env == binding.env && other.depth == binding.depth && other.slot == binding.slot && other.name == binding.name;
+    });
+    if (!is_known)
+        walk.bindings.push_back(binding);
+
+    return checkValue(name, binding.value, walk);
+}
+
+static std::string checkChildren(const ASTNodePtr& node, Walk& walk) {
+    for (const auto& child : childNodes(node)) {
+        const auto reason = checkNode(child, walk);
+        if (!reason.empty())
+            return reason;
+    }
+
+    return "";
+}
+
+static std::string checkNode(const ASTNodePtr& node, Walk& walk) {
+    if (!node)
+        return "";
+
+    switch (node->nodeType())
+    {
+    case NODE_IDENT:
+        return checkIdentifier(node, walk, false);
+    case NODE_INLINED_CALL:
+        return checkNode(node->getCall(), walk);
+    case NODE_CALL_EXPR: {
+        const auto func = node->getFunc();
+        if (!func || func->nodeType() != NODE_IDENT)
+            return "calls a function value it can't check";
+
+        auto reason = checkIdentifier(func, walk, true);
+        for (const auto& arg : node->getArgs()) {
+            if (!reason.empty())
+                break;
+            reason = checkNode(arg, walk);
+        }
+
+        return reason;
+    }
+    case NODE_FUNC: {
+        Level level {node->getParams().size(), {}};
+        collectLets(node->getBody(), level);
+
+        walk.levels.push_back(level);
+        const auto reason = checkNode(node->getBody(), walk);
+        walk.levels.pop_back();
+
+        return reason;
+    }
+    default:
+        return checkChildren(node, walk);
+    }
+}
+
+// A function already being checked counts as pure, which is what it turns
+// out to be if nothing else in it says otherwise
+static std::string checkFunc(const Value& func, std::set<const BlockStatement*>& checked, std::vector<MemoBinding>& bindings) {
+    const auto body = func->getBody();
+    if (!body)
+        return "has no body to check";
+
+    if (!checked.insert(body).second)
+        return "";
+
+    Level level {func->getParams().size(), {}};
+    collectLets(body, level);
+
+    Walk walk {func->getEnv(), {level}, checked, bindings};
+
+    return checkNode(body, walk);
+}
+
+std::string impurity(const Value& func, std::vector<MemoBinding>* bindings) {
+    std::set<const BlockStatement*> checked;
+    std::vector<MemoBinding> found;
+
+    const auto reason = checkFunc(func, checked, found);
+    if (bindings)
+        *bindings = std::move(found);
+
+    return reason;
+}
+
+Value lookup(const MemoBinding& binding) {
+    if (!binding.env)
+        return binding.depth < 0 ? builtinObject(binding.name) : nullptr;
+
+    if (binding.depth >= 0)
+        return binding.env->getAt(binding.depth, binding.slot);
+
+    auto value = binding.env->get(binding.name);
+    return value ? value : builtinObject(binding.name);
+}
+
+bool stillHold(const std::vector<MemoBinding>& bindings, const Value& memoized) {
+    for (const auto& binding : bindings) {
+        const auto value = lookup(binding);
+
+        // A name bound later to the memoized function itself, like a
+        // recursive function bound to its memoized version
+        if (!binding.value && value.isObject() && value.asObject() == memoized.asObject())
+            continue;
+
+        if (value.bits() != binding.value.bits())
+            return false;
+    }
+
+    return true;
+}
+
+} // purity
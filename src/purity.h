@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+#include "object.h"
+
+// Finds out if a function is pure: if it gives the same result every time
+// it's called with the same args, without doing anything else, so calls of
+// it can be answered from a table of earlier results (see memo builtin).
+//
+// The body and every function literal in it must only call pure builtins,
+// functions let in the body itself and functions of enclosing scopes that
+// are pure in turn. Calling a param or any other value it can't check makes
+// a function impure, as does reading a name of an enclosing scope that holds
+// something other than a function, since a later let could bind it again.
+//
+// Names from outside are checked by what they hold at the time, and names
+// not bound yet, like the name of a recursive function about to be bound
+// to its memoized version, are let through. Since a later let can bind any
+// of them again, the check gives the bindings it relied on, which are only
+// safe to rely on while stillHold says so.
+namespace purity {
+
+// Why func isn't pure, empty if it is. Fills bindings with the names from
+// outside it read and what they held.
+std::string impurity(const Value& func, std::vector<MemoBinding>* bindings = nullptr);
+
+// Value the name of binding holds now, empty if it isn't bound
+Value lookup(const MemoBinding& binding);
+
+// Whether every name still holds what it did when checked. A name that
+// wasn't bound may since have been bound to memoized itself.
+bool stillHold(const std::vector<MemoBinding>& bindings, const Value& memoized);
+
+} // purity
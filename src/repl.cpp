@@ -1,6 +1,9 @@
 #include "repl.h"
 #include "parser.h"
 #include "evaluator.h"
+#include "optimizer.h"
+#include "thunk.h"
+#include "vm.h"
 #include "util.h"
 
 #include <iostream>
@@ -10,8 +13,11 @@
 
 namespace repl {
 
-void start() {
-    EnvPtr env = std::make_shared<Env>();
+void start(engine_type engine, size_t max_depth) {
+    EnvPtr env = makeRef<Env>();
+    Compiler compiler;
+    VM vm;
+    Machine machine(max_depth);
 
     while (true) {
         std::string line;
@@ -32,9 +38,26 @@ void start() {
                 break;
             }
 
+            Optimizer optimizer;
+            optimizer.optimize(program);
+
             const std::string program_str = program->toString();
-            auto evaluated = evaluator::eval((program), env);
-        
+            Value evaluated = nullptr;
+
+            if (engine == ENGINE_VM) {
+                if (!compiler.compile(program)) {
+                    printParsingErrors(compiler.errors());
+                    break;
+                }
+                evaluated = vm.run(compiler.bytecode());
+            } else if (engine == ENGINE_THUNK) {
+                evaluated = thunk::eval(program, env);
+            } else if (engine == ENGINE_STACK) {
+                evaluated = machine.run(program, env);
+            } else {
+                evaluated = evaluator::eval((program), env);
+            }
+
             if (evaluated && evaluated->getType() != OBJ_NIL)
                 std::cout << evaluated->inspect() << '\n';
         }
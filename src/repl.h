@@ -3,9 +3,18 @@
 #include <vector>
 #include <string>
 
+#include "machine.h"
+
+enum engine_type {
+    ENGINE_EVAL,  // tree-walking evaluator
+    ENGINE_STACK, // tree-walking evaluator with a heap allocated stack
+    ENGINE_VM,    // bytecode compiler + VM
+    ENGINE_THUNK  // AST compiled to a tree of pre-bound closures
+};
+
 namespace repl {
 
-void start();
+void start(engine_type engine = ENGINE_EVAL, size_t max_depth = DEFAULT_MAX_DEPTH);
 void printParsingErrors(std::vector<std::string> errors);
 
-} // repl
\ No newline at end of file
+} // repl
@@ -0,0 +1,279 @@
+#include "resolver.h"
+
+void Resolver::resolve(const ASTNodePtr& node) {
+    if (!node)
+        return;
+
+    switch (node->nodeType())
+    {
+    case NODE_LET_STMNT:
+        resolveLetStatement(node);
+        break;
+    case NODE_IDENT:
+        resolveIdentifier(node);
+        break;
+    case NODE_FUNC:
+        resolveFuncLiteral(node);
+        break;
+    default:
+        for (const auto& child : childNodes(node))
+            resolve(child);
+        break;
+    }
+}
+
+void Resolver::resolveLetStatement(const ASTNodePtr& node) {
+    auto value = node->getExpr();
+
+    if (m_scopes.empty()) {
+        resolve(value);
+        return;
+    }
+
+    const std::string name = node->getIdentName();
+
+    // A function literal doesn't read its own name until it's called, so
+    // recursive local functions can already see it.
+    if (value && value->nodeType() == NODE_FUNC) {
+        declare(name);
+        resolve(value);
+    } else {
+        resolve(value);
+        declare(name);
+    }
+
+    static_cast<LetStatement*>(node)->setSlot(m_scopes.back().slots[name]);
+}
+
+void Resolver::resolveIdentifier(const ASTNodePtr& node) {
+    const std::string name = node->getIdentName();
+    const int n_scopes = static_cast<int>(m_scopes.size());
+
+    for (int depth = 0; depth < n_scopes; depth++) {
+        const auto& scope = m_scopes[static_cast<size_t>(n_scopes - 1 - depth)];
+
+        // The current function only sees its own locals after their let has
+        // run. Enclosing functions have usually finished declaring theirs by
+        // the time an inner function gets called, so all of them count.
+        if (depth == 0 && scope.declared.count(name) == 0)
+            continue;
+
+        auto search = scope.slots.find(name);
+        if (search != scope.slots.end()) {
+            static_cast<Identifier*>(node)->setAddress(depth, search->second);
+            return;
+        }
+    }
+}
+
+void Resolver::resolveFuncLiteral(const ASTNodePtr& node) {
+    Scope scope;
+
+    for (const auto& param : node->getParams()) {
+        scope.slots[param.getIdentName()] = scope.n_slots++;
+        scope.declared.insert(param.getIdentName());
+    }
+
+    collectLets(node->getBody(), scope);
+
+    m_scopes.push_back(scope);
+    resolve(node->getBody());
+
+    static_cast<FuncLiteral*>(node)->setSlotCount(m_scopes.back().n_slots);
+    m_scopes.pop_back();
+
+    markTailPosition(node->getBody());
+    markTailCalls(node->getBody());
+
+    std::set<int> live;
+    std::set<int> captured;
+    collectCaptured(node->getBody(), 0, captured);
+    markLastUses(node->getBody(), live, captured);
+}
+
+// Gives a slot to every name declared with let in the function, without
+// descending into nested functions
+void Resolver::collectLets(const ASTNodePtr& node, Scope& scope) {
+    if (!node || node->nodeType() == NODE_FUNC)
+        return;
+
+    if (node->nodeType() == NODE_LET_STMNT && scope.slots.count(node->getIdentName()) == 0)
+        scope.slots[node->getIdentName()] = scope.n_slots++;
+
+    for (const auto& child : childNodes(node))
+        collectLets(child, scope);
+}
+
+// Every return in the function body returns its value as is, wherever it is
+void Resolver::markTailCalls(const ASTNodePtr& node) {
+    if (!node || node->nodeType() == NODE_FUNC)
+        return;
+
+    if (node->nodeType() == NODE_RETURN_STMNT)
+        markTailPosition(node->getExpr());
+
+    for (const auto& child : childNodes(node))
+        markTailCalls(child);
+}
+
+// node's value becomes the value of the function
+void Resolver::markTailPosition(const ASTNodePtr& node) {
+    if (!node)
+        return;
+
+    switch (node->nodeType())
+    {
+    case NODE_CALL_EXPR:
+        static_cast<CallExpr*>(node)->setTailCall(true);
+        break;
+    case NODE_EXPR_STMNT:
+    case NODE_RETURN_STMNT:
+        markTailPosition(node->getExpr());
+        break;
+    case NODE_BLOCK_STMNT: {
+        const auto& statements = node->getStatements();
+        if (!statements.empty())
+            markTailPosition(statements.back());
+        break;
+    }
+    case NODE_IF_EXPR:
+        markTailPosition(node->getConsequence());
+        markTailPosition(node->getAlternative());
+        break;
+    default:
+        break;
+    }
+}
+
+// Walks the function body backwards in evaluation order. live holds the
+// slots read later on, so a read of a slot not in it is the last one. Slots
+// that nested functions read stay in their env and are never marked.
+void Resolver::markLastUses(const ASTNodePtr& node, std::set<int>& live, const std::set<int>& captured) {
+    if (!node)
+        return;
+
+    switch (node->nodeType())
+    {
+    case NODE_FUNC:
+        break;
+    case NODE_IDENT: {
+        const int slot = node->getSlot();
+
+        if (node->getDepth() == 0 && captured.count(slot) == 0 && live.count(slot) == 0) {
+            static_cast<Identifier*>(node)->setLastUse(true);
+            live.insert(slot);
+        }
+        break;
+    }
+    case NODE_LET_STMNT:
+        // The value read before the let is not the one read after it
+        if (node->getSlot() >= 0)
+            live.erase(node->getSlot());
+        markLastUses(node->getExpr(), live, captured);
+        break;
+    case NODE_RETURN_STMNT:
+        // Nothing in the function runs after a return
+        live.clear();
+        markLastUses(node->getExpr(), live, captured);
+        break;
+    case NODE_IF_EXPR: {
+        std::set<int> live_alternative = live;
+        markLastUses(node->getConsequence(), live, captured);
+        markLastUses(node->getAlternative(), live_alternative, captured);
+        live.insert(live_alternative.begin(), live_alternative.end());
+        markLastUses(node->getCondition(), live, captured);
+        break;
+    }
+    default: {
+        const auto children = childNodes(node);
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
+            markLastUses(*it, live, captured);
+        break;
+    }
+    }
+}
+
+// Slots of the function being resolved that nested functions read. depth is
+// how many functions down node is.
+void Resolver::collectCaptured(const ASTNodePtr& node, int depth, std::set<int>& captured) {
+    if (!node)
+        return;
+
+    if (node->nodeType() == NODE_IDENT && depth > 0 && node->getDepth() == depth)
+        captured.insert(node->getSlot());
+
+    const int child_depth = node->nodeType() == NODE_FUNC ? depth + 1 : depth;
+
+    for (const auto& child : childNodes(node))
+        collectCaptured(child, child_depth, captured);
+}
+
+void Resolver::declare(const std::string& name) {
+    m_scopes.back().declared.insert(name);
+}
+
+std::vector<ASTNodePtr> childNodes(const ASTNodePtr& node) {
+    std::vector<ASTNodePtr> children;
+
+    switch (node->nodeType())
+    {
+    case NODE_PROGRAM:
+    case NODE_BLOCK_STMNT:
+        for (const auto& statement : node->getStatements())
+            children.push_back(statement);
+        break;
+    case NODE_EXPR_STMNT:
+    case NODE_RETURN_STMNT:
+    case NODE_LET_STMNT:
+        children.push_back(node->getExpr());
+        break;
+    case NODE_PREFIX:
+        children.push_back(node->getRight());
+        break;
+    case NODE_INFIX:
+        children.push_back(node->getLeft());
+        children.push_back(node->getRight());
+        break;
+    case NODE_IF_EXPR:
+        children.push_back(node->getCondition());
+        children.push_back(node->getConsequence());
+        children.push_back(node->getAlternative());
+        break;
+    case NODE_FUNC:
+        children.push_back(node->getBody());
+        break;
+    case NODE_CALL_EXPR:
+        children.push_back(node->getFunc());
+        for (const auto& arg : node->getArgs())
+            children.push_back(arg);
+        break;
+    case NODE_ARRAY:
+        for (const auto& element : node->getElements())
+            children.push_back(element);
+        break;
+    case NODE_HASH:
+        for (const auto& [key, value] : node->getPairs()) {
+            children.push_back(key);
+            children.push_back(value);
+        }
+        break;
+    case NODE_INDEX:
+        children.push_back(node->getLeft());
+        children.push_back(node->getIndex());
+        break;
+    case NODE_INLINED_CALL:
+        children.push_back(node->getCall());
+        break;
+    default:
+        break;
+    }
+
+    // Parsing errors can leave holes in the tree
+    std::vector<ASTNodePtr> non_null;
+    for (const auto& child : children) {
+        if (child)
+            non_null.push_back(child);
+    }
+
+    return non_null;
+}
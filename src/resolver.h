@@ -0,0 +1,35 @@
+#pragma once
+
+#include <map>
+#include <set>
+
+#include "ast.h"
+
+struct Scope {
+    std::map<std::string, int> slots; // every name declared in the function
+    std::set<std::string> declared;   // names declared so far
+    int n_slots {0};
+};
+
+// Annotates identifiers inside functions with their lexical address: how many
+// function envs up the name lives (depth) and its index in that env (slot).
+// Top level names stay unresolved and are looked up by name from the global
+// env, as are names that don't resolve to any enclosing function.
+class Resolver {
+    std::vector<Scope> m_scopes;
+
+public:
+    void resolve(const ASTNodePtr& node);
+    void resolveLetStatement(const ASTNodePtr& node);
+    void resolveIdentifier(const ASTNodePtr& node);
+    void resolveFuncLiteral(const ASTNodePtr& node);
+
+    void collectLets(const ASTNodePtr& node, Scope& scope);
+    void markTailCalls(const ASTNodePtr& node);
+    void markTailPosition(const ASTNodePtr& node);
+    void markLastUses(const ASTNodePtr& node, std::set<int>& live, const std::set<int>& captured);
+    void collectCaptured(const ASTNodePtr& node, int depth, std::set<int>& captured);
+    void declare(const std::string& name);
+};
+
+std::vector<ASTNodePtr> childNodes(const ASTNodePtr& node);
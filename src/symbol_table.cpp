@@ -0,0 +1,66 @@
+#include "symbol_table.h"
+
+SymbolTable::SymbolTable(SymbolTablePtr outer)
+    : m_outer(outer) {
+}
+
+Symbol SymbolTable::define(const std::string& name) {
+    const symbol_scope scope = m_outer ? SCOPE_LOCAL : SCOPE_GLOBAL;
+
+    // Redefinition in the same scope reuses the old slot, like Env::set does
+    auto search = m_store.find(name);
+    if (search != m_store.end() && search->second.scope == scope)
+        return search->second;
+
+    Symbol symbol {name, scope, m_n_definitions};
+    m_store[name] = symbol;
+    m_n_definitions++;
+
+    return symbol;
+}
+
+Symbol SymbolTable::defineFree(const Symbol& original) {
+    m_free_symbols.push_back(original);
+
+    Symbol symbol {original.name, SCOPE_FREE, static_cast<int>(m_free_symbols.size()) - 1};
+    m_store[original.name] = symbol;
+
+    return symbol;
+}
+
+Symbol SymbolTable::defineFunctionName(const std::string& name) {
+    Symbol symbol {name, SCOPE_FUNCTION, 0};
+    m_store[name] = symbol;
+
+    return symbol;
+}
+
+bool SymbolTable::resolve(const std::string& name, Symbol& symbol) {
+    auto search = m_store.find(name);
+
+    if (search != m_store.end()) {
+        symbol = search->second;
+        return true;
+    }
+
+    if (!m_outer || !m_outer->resolve(name, symbol))
+        return false;
+
+    if (symbol.scope == SCOPE_GLOBAL)
+        return true;
+
+    symbol = defineFree(symbol);
+
+    return true;
+}
+
+std::vector<std::string> SymbolTable::names() const {
+    std::vector<std::string> names(static_cast<size_t>(m_n_definitions));
+
+    for (const auto& [name, symbol] : m_store) {
+        if (symbol.scope == SCOPE_GLOBAL || symbol.scope == SCOPE_LOCAL)
+            names[static_cast<size_t>(symbol.index)] = name;
+    }
+
+    return names;
+}
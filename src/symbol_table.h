@@ -0,0 +1,49 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum symbol_scope {
+    SCOPE_GLOBAL,
+    SCOPE_LOCAL,
+    SCOPE_FREE,
+    SCOPE_FUNCTION
+};
+
+struct Symbol {
+    std::string name;
+    symbol_scope scope;
+    int index;
+};
+
+class SymbolTable;
+
+typedef std::shared_ptr<SymbolTable> SymbolTablePtr;
+
+class SymbolTable {
+    SymbolTablePtr m_outer;
+    std::map<std::string, Symbol> m_store;
+    std::vector<Symbol> m_free_symbols;
+    int m_n_definitions {0};
+
+public:
+    SymbolTable() = default;
+    SymbolTable(SymbolTablePtr outer);
+
+    Symbol define(const std::string& name);
+    Symbol defineFree(const Symbol& original);
+    Symbol defineFunctionName(const std::string& name);
+
+    bool resolve(const std::string& name, Symbol& symbol);
+
+    SymbolTablePtr getOuter() const { return m_outer; }
+
+    const std::vector<Symbol>& getFreeSymbols() const { return m_free_symbols; }
+
+    int nDefinitions() const { return m_n_definitions; }
+
+    // Names of the defined symbols ordered by their index
+    std::vector<std::string> names() const;
+};
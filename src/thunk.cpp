@@ -0,0 +1,448 @@
+#include "thunk.h"
+#include "builtin.h"
+#include "evaluator.h"
+#include "jit.h"
+
+using namespace evaluator;
+
+namespace thunk {
+
+static Value runProgram(const Thunk& thunk, const EnvPtr& env) {
+    Value result = nullptr;
+
+    for (const auto statement : thunk.children) {
+        result = statement->run(*statement, env);
+        gc::maybeCollect();
+
+        if (result->getType() == OBJ_RETURN)
+            return result->getObjValue();
+        if (result->getType() == OBJ_ERROR)
+            return result;
+    }
+
+    return result;
+}
+
+static Value runBlock(const Thunk& thunk, const EnvPtr& env) {
+    Value result = nullptr;
+
+    if (thunk.children.empty())
+        return Value::nil();
+
+    for (const auto statement : thunk.children) {
+        result = statement->run(*statement, env);
+        gc::maybeCollect();
+
+        if (result->getType() == OBJ_RETURN || result->getType() == OBJ_ERROR)
+            return result;
+    }
+
+    return result;
+}
+
+static Value runConstant(const Thunk& thunk, const EnvPtr& env) {
+    (void)env;
+    return thunk.value;
+}
+
+static Value runNil(const Thunk& thunk, const EnvPtr& env) {
+    (void)thunk;
+    (void)env;
+    return Value::nil();
+}
+
+// Mirrors evaluator::evalIdentifier
+static Value runGlobal(const Thunk& thunk, const EnvPtr& env) {
+    auto value = env->get(thunk.name);
+    if (value)
+        return value;
+
+    auto builtin = builtinObject(thunk.name);
+    if (builtin)
+        return builtin;
+
+    return makeObject<Error>(("identifier not found: " + thunk.name));
+}
+
+static Value runLocal(const Thunk& thunk, const EnvPtr& env) {
+    auto value = thunk.is_last_use ? env->takeAt(thunk.slot) : env->getAt(thunk.depth, thunk.slot);
+    if (value)
+        return value;
+
+    // Resolved to a local whose let hasn't run yet
+    return runGlobal(thunk, env);
+}
+
+static Value runBang(const Thunk& thunk, const EnvPtr& env) {
+    auto right = thunk.left->run(*thunk.left, env);
+    if (isError(right))
+        return right;
+
+    return evalBangOperator(right);
+}
+
+static Value runMinus(const Thunk& thunk, const EnvPtr& env) {
+    auto right = thunk.left->run(*thunk.left, env);
+    if (isError(right))
+        return right;
+
+    return evalMinusOperator(right);
+}
+
+static Value runPrefix(const Thunk& thunk, const EnvPtr& env) {
+    auto right = thunk.left->run(*thunk.left, env);
+    if (isError(right))
+        return right;
+
+    return evalPrefixExpr(thunk.oprtr, right);
+}
+
+static Value runInfix(const Thunk& thunk, const EnvPtr& env) {
+    auto left = thunk.left->run(*thunk.left, env);
+    if (isError(left))
+        return left;
+
+    auto right = thunk.right->run(*thunk.right, env);
+    if (isError(right))
+        return right;
+
+    return evalInfixExpr(thunk.oprtr, left, right);
+}
+
+static Value runIf(const Thunk& thunk, const EnvPtr& env) {
+    auto cond = thunk.left->run(*thunk.left, env);
+    if (isError(cond))
+        return cond;
+
+    if (isTrue(cond))
+        return thunk.right->run(*thunk.right, env);
+
+    if (thunk.alt)
+        return thunk.alt->run(*thunk.alt, env);
+
+    return Value::nil();
+}
+
+static Value runReturn(const Thunk& thunk, const EnvPtr& env) {
+    auto value = thunk.left->run(*thunk.left, env);
+    if (isError(value))
+        return value;
+
+    return makeObject<Return>(value);
+}
+
+static Value runLetSlot(const Thunk& thunk, const EnvPtr& env) {
+    auto value = thunk.left->run(*thunk.left, env);
+    if (isError(value))
+        return value;
+
+    return env->setAt(thunk.slot, std::move(value));
+}
+
+static Value runLetName(const Thunk& thunk, const EnvPtr& env) {
+    auto value = thunk.left->run(*thunk.left, env);
+    if (isError(value))
+        return value;
+
+    return env->set(thunk.name, std::move(value));
+}
+
+// Like evaluator::evalExprs, the values are cut after the first error
+static std::vector<Value> runExprs(const std::vector<const Thunk*>& thunks, const EnvPtr& env) {
+    std::vector<Value> result;
+    result.reserve(thunks.size());
+
+    for (const auto thunk : thunks) {
+        result.push_back(thunk->run(*thunk, env));
+
+        if (isError(result.back()))
+            return result;
+    }
+
+    return result;
+}
+
+static Value callWith(const Thunk& thunk, Value func, const EnvPtr& env) {
+    auto args = runExprs(thunk.children, env);
+    if (args.size() == 1 && isError(args[0]))
+        return args[0];
+
+    if (thunk.is_tail_call && func->getType() == OBJ_FUNC)
+        return makeObject<TailCall>(func, std::move(args));
+
+    return applyFunction(std::move(func), std::move(args));
+}
+
+static Value runCall(const Thunk& thunk, const EnvPtr& env) {
+    auto func = thunk.left->run(*thunk.left, env);
+    if (isError(func))
+        return func;
+
+    return callWith(thunk, std::move(func), env);
+}
+
+static Value runInlinedCall(const Thunk& thunk, const EnvPtr& env) {
+    auto func = thunk.left->run(*thunk.left, env);
+    if (isError(func))
+        return func;
+
+    if (isInlined(func, thunk.node))
+        return thunk.right->run(*thunk.right, env);
+
+    return callWith(thunk, std::move(func), env);
+}
+
+static Value runFunc(const Thunk& thunk, const EnvPtr& env) {
+    const auto node = thunk.node;
+    auto func = makeObject<Function>(node->getParams(), node->getBody(), node->getArena(), env, node->getSlotCount());
+    func.as<Function>()->compiled = thunk.right;
+
+    return func;
+}
+
+static Value runArray(const Thunk& thunk, const EnvPtr& env) {
+    auto elements = runExprs(thunk.children, env);
+    if (elements.size() == 1 && isError(elements[0]))
+        return elements[0];
+
+    return makeObject<Array>(elements);
+}
+
+static Value runHash(const Thunk& thunk, const EnvPtr& env) {
+    HashTable pairs;
+
+    for (size_t i = 0; i < thunk.children.size(); i += 2) {
+        auto key = thunk.children[i]->run(*thunk.children[i], env);
+        if (isError(key))
+            return key;
+
+        auto value = thunk.children[i + 1]->run(*thunk.children[i + 1], env);
+        if (isError(value))
+            return value;
+
+        auto hashed = key->hashKey();
+
+        if (hashed.type == OBJ_NIL)
+            return makeObject<Error>("unusable as hash key");
+
+        pairs.set(hashed, key, value);
+    }
+
+    return makeObject<Hash>(std::move(pairs));
+}
+
+static Value runIndex(const Thunk& thunk, const EnvPtr& env) {
+    auto left = thunk.left->run(*thunk.left, env);
+    if (isError(left))
+        return left;
+
+    auto index = thunk.right->run(*thunk.right, env);
+    if (isError(index))
+        return index;
+
+    return evalIndexExpr(left, index);
+}
+
+static const Thunk* compileNode(const ASTNodePtr& node, Arena& arena);
+
+static std::vector<const Thunk*> compileNodes(const std::vector<Statement*>& nodes, Arena& arena) {
+    std::vector<const Thunk*> thunks;
+
+    for (const auto node : nodes)
+        thunks.push_back(compileNode(node, arena));
+
+    return thunks;
+}
+
+static std::vector<const Thunk*> compileNodes(const std::vector<ExprPtr>& nodes, Arena& arena) {
+    std::vector<const Thunk*> thunks;
+
+    for (const auto node : nodes)
+        thunks.push_back(compileNode(node, arena));
+
+    return thunks;
+}
+
+static const Thunk* compileNode(const ASTNodePtr& node, Arena& arena) {
+    // The statement is nothing but its expression
+    if (node->nodeType() == NODE_EXPR_STMNT)
+        return compileNode(node->getExpr(), arena);
+
+    Thunk* thunk = arena.make<Thunk>();
+    thunk->node = node;
+
+    switch (node->nodeType())
+    {
+    case NODE_PROGRAM:
+        thunk->run = runProgram;
+        thunk->children = compileNodes(node->getStatements(), arena);
+        break;
+    case NODE_BLOCK_STMNT:
+        thunk->run = runBlock;
+        thunk->children = compileNodes(node->getStatements(), arena);
+        break;
+    case NODE_IDENT:
+        thunk->run = node->getDepth() >= 0 ? runLocal : runGlobal;
+        thunk->name = node->getIdentName();
+        thunk->depth = node->getDepth();
+        thunk->slot = node->getSlot();
+        thunk->is_last_use = node->isLastUse();
+        break;
+    case NODE_INT:
+        thunk->run = runConstant;
+        thunk->value = Value(node->getIntValue());
+        break;
+    case NODE_FLOAT:
+        thunk->run = runConstant;
+        thunk->value = Value(node->getFloatValue());
+        break;
+    case NODE_STR:
+        // Strings are never changed in place, so every run can share one
+        thunk->run = runConstant;
+        thunk->value = makeObject<String>(node->tokenLiteral());
+        break;
+    case NODE_BOOL:
+        thunk->run = runConstant;
+        thunk->value = Value(node->getBoolValue());
+        break;
+    case NODE_PREFIX:
+        thunk->oprtr = node->getOprtr();
+        thunk->run = thunk->oprtr == OPRTR_BANG ? runBang : thunk->oprtr == OPRTR_SUB ? runMinus : runPrefix;
+        thunk->left = compileNode(node->getRight(), arena);
+        break;
+    case NODE_INFIX:
+        thunk->run = runInfix;
+        thunk->oprtr = node->getOprtr();
+        thunk->left = compileNode(node->getLeft(), arena);
+        thunk->right = compileNode(node->getRight(), arena);
+        break;
+    case NODE_IF_EXPR:
+        thunk->run = runIf;
+        thunk->left = compileNode(node->getCondition(), arena);
+        thunk->right = compileNode(node->getConsequence(), arena);
+        if (node->getAlternative())
+            thunk->alt = compileNode(node->getAlternative(), arena);
+        break;
+    case NODE_RETURN_STMNT:
+        thunk->run = runReturn;
+        thunk->left = compileNode(node->getExpr(), arena);
+        break;
+    case NODE_LET_STMNT:
+        thunk->run = node->getSlot() >= 0 ? runLetSlot : runLetName;
+        thunk->name = node->getIdentName();
+        thunk->slot = node->getSlot();
+        thunk->left = compileNode(node->getExpr(), arena);
+        break;
+    case NODE_CALL_EXPR:
+        thunk->run = runCall;
+        thunk->is_tail_call = node->isTailCall();
+        thunk->left = compileNode(node->getFunc(), arena);
+        thunk->children = compileNodes(node->getArgs(), arena);
+        break;
+    case NODE_INLINED_CALL:
+        thunk->run = runInlinedCall;
+        thunk->is_tail_call = node->getCall()->isTailCall();
+        thunk->left = compileNode(node->getFunc(), arena);
+        thunk->right = compileNode(node->getExpr(), arena);
+        thunk->children = compileNodes(node->getCall()->getArgs(), arena);
+        break;
+    case NODE_FUNC:
+        thunk->run = runFunc;
+        thunk->right = compileNode(node->getBody(), arena);
+        break;
+    case NODE_ARRAY:
+        thunk->run = runArray;
+        thunk->children = compileNodes(node->getElements(), arena);
+        break;
+    case NODE_HASH:
+        thunk->run = runHash;
+        for (const auto& [key_node, value_node] : node->getPairs()) {
+            thunk->children.push_back(compileNode(key_node, arena));
+            thunk->children.push_back(compileNode(value_node, arena));
+        }
+        break;
+    case NODE_INDEX:
+        thunk->run = runIndex;
+        thunk->left = compileNode(node->getLeft(), arena);
+        thunk->right = compileNode(node->getIndex(), arena);
+        break;
+    default:
+        thunk->run = runNil;
+        break;
+    }
+
+    return thunk;
+}
+
+const Thunk* compile(const std::shared_ptr<Program>& program) {
+    return compileNode(program.get(), program->arena());
+}
+
+Value run(const Thunk* code, const EnvPtr& env) {
+    return code->run(*code, env);
+}
+
+Value eval(const std::shared_ptr<Program>& program, EnvPtr env) {
+    return run(compile(program), env);
+}
+
+// Mirrors evaluator::applyFunction, but runs the compiled body of functions
+// made by this engine
+Value applyFunction(Value func, std::vector<Value> args) {
+    EnvPtr env;
+
+    while (true) {
+        switch (func->getType())
+        {
+        case OBJ_FUNC: {
+            const auto function = func.as<Function>();
+
+            Value jitted = nullptr;
+            if (jit::tryCall(function, args, jitted))
+                return jitted;
+
+            const size_t n_params = function->params.size();
+            const size_t n_args = args.size();
+            if (n_params != n_args)
+                return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=" + std::to_string(n_params));
+
+            if (env && env->refs == 1 && env->getOuter() == function->env && env->getSlotCount() == static_cast<size_t>(function->n_slots))
+                env->reset();
+            else
+                env = makeRef<Env>(function->env, static_cast<size_t>(function->n_slots));
+
+            // Resolved functions keep their params in the first slots
+            for (size_t i = 0; i < n_args; i++) {
+                if (function->n_slots > 0)
+                    env->setAt(static_cast<int>(i), std::move(args[i]));
+                else
+                    env->set(function->params[i].getIdentName(), std::move(args[i]));
+            }
+
+            Value evaluated = nullptr;
+            if (function->native)
+                evaluated = Value::adoptBits(function->native(env.get()));
+            else if (function->compiled)
+                evaluated = runBlock(*function->compiled, env);
+            else
+                evaluated = evalBlock(function->body->getStatements(), env);
+            evaluated = unwrapReturnValue(evaluated);
+            if (evaluated->getType() != OBJ_TAIL_CALL)
+                return evaluated;
+
+            auto tail_call = evaluated.as<TailCall>();
+            func = tail_call->func;
+            args = std::move(tail_call->args);
+            break;
+        }
+        case OBJ_BUILTIN:
+            return callBuiltin(func, args);
+        case OBJ_MEMO:
+            return callMemoized(func, args, applyFunction);
+        default:
+            return makeObject<Error>(("not a function: " + func->typeString()));
+        }
+    }
+}
+
+} // thunk
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "ast.h"
+#include "env.h"
+
+struct Thunk;
+
+typedef Value (*ThunkFunc)(const Thunk& thunk, const EnvPtr& env);
+
+// AST node compiled once into the function that evaluates it, with its
+// children, operator and constant bound in. Running a thunk does no
+// nodeType() switch and calls no virtual getters of the AST.
+struct Thunk {
+    ThunkFunc run;
+    ASTNodePtr node;
+    Value value;                        // literal
+    std::string name;                   // identifier or let looked up by name
+    int depth {-1};
+    int slot {-1};
+    int oprtr {OPRTR_UNKNOWN};
+    bool is_last_use {false};
+    bool is_tail_call {false};
+    const Thunk* left {nullptr};        // also the only child of a prefix, return or let
+    const Thunk* right {nullptr};       // also the consequence of an if, the body of a func, an inlined body
+    const Thunk* alt {nullptr};
+    std::vector<const Thunk*> children; // statements, args, elements or hash keys and values in turn
+};
+
+// Engine running programs compiled to thunks. Gives the same results as
+// evaluator::eval, also for functions made by one and called by the other.
+namespace thunk {
+
+// The thunks are allocated in the arena of program and live as long as it
+const Thunk* compile(const std::shared_ptr<Program>& program);
+
+Value run(const Thunk* code, const EnvPtr& env);
+
+// Compiles program and runs it
+Value eval(const std::shared_ptr<Program>& program, EnvPtr env);
+
+Value applyFunction(Value func, std::vector<Value> args);
+
+} // thunk
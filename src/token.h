@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <map>
 
 // TODO: To get token string for error handling create array and use enum index to get string
@@ -53,15 +54,50 @@ enum token_type {
     TOK_NOT_EQ
 };
 
+// The literal is a span of the lexer's source buffer (or of a string
+// literal in tests), nothing is copied until a node needs a value
 struct Token {
     int type;
-    std::string literal;
+    std::string_view literal;
 
     friend bool operator== (const Token& tok_a, const Token& tok_b);
     friend bool operator!= (const Token& tok_a, const Token& tok_b);
 
     Token() = default;
-    Token(int type, std::string literal);
+    Token(int type, std::string_view literal);
 };
 
-int lookupIdent(std::string ident);
+// Keyword type for ident, TOK_IDENT otherwise. Switches on length and
+// first char, so at most one comparison runs and nothing is allocated.
+constexpr int lookupIdent(std::string_view ident) {
+    switch (ident.size()) {
+    case 2:
+        if (ident == "if")
+            return TOK_IF;
+        break;
+    case 3:
+        if (ident == "let")
+            return TOK_LET;
+        break;
+    case 4:
+        if (ident[0] == 'f' && ident == "func")
+            return TOK_FUNC;
+        if (ident[0] == 't' && ident == "true")
+            return TOK_TRUE;
+        if (ident[0] == 'e' && ident == "else")
+            return TOK_ELSE;
+        break;
+    case 5:
+        if (ident == "false")
+            return TOK_FALSE;
+        break;
+    case 6:
+        if (ident == "return")
+            return TOK_RETURN;
+        break;
+    default:
+        break;
+    }
+
+    return TOK_IDENT;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "ast.h"
+#include "heap.h"
+
+enum object_type {
+    OBJ_INT,
+    OBJ_FLOAT,
+    OBJ_STR,
+    OBJ_BOOL,
+    OBJ_ARRAY,
+    OBJ_HASH,
+    OBJ_RETURN,
+    OBJ_FUNC,
+    OBJ_BUILTIN,
+    OBJ_NIL,
+    OBJ_ERROR,
+    OBJ_COMPILED_FUNC,
+    OBJ_CLOSURE,
+    OBJ_TAIL_CALL,
+    OBJ_MEMO
+};
+
+class Env;
+class HashTable;
+class PersistentVector;
+struct Object;
+
+typedef Ref<Env> EnvPtr;
+
+// Full 64-bit hash of a key, type OBJ_NIL for values that can't be keys
+struct HashKey {
+    object_type type;
+    uint64_t value;
+
+    friend bool operator== (const HashKey& hash_key_a, const HashKey& hash_key_b);
+};
+
+// A 64-bit NaN-boxed value. Doubles are stored as they are, everything else
+// lives in the payload of a quiet NaN: ints, bools and nil inline, and heap
+// objects (strings, arrays, hashes, functions, ...) as a pointer to an
+// intrusively reference counted Object. An empty Value stands for "no value",
+// like a null ObjectPtr used to.
+class Value {
+    uint64_t m_bits;
+
+    void retain() const;
+    void release() const;
+
+public:
+    // Layout, also written into the runtime header of native modules (aot.h)
+    static constexpr uint64_t QNAN = 0x7ffc000000000000;
+    static constexpr uint64_t TAG_MASK = 0xffff000000000000;
+    static constexpr uint64_t TAG_EMPTY = 0x7ffc000000000000;
+    static constexpr uint64_t TAG_NIL = 0x7ffd000000000000;
+    static constexpr uint64_t TAG_BOOL = 0x7ffe000000000000;
+    static constexpr uint64_t TAG_INT = 0x7fff000000000000;
+    static constexpr uint64_t TAG_OBJ = 0xfffc000000000000;
+    static constexpr uint64_t PAYLOAD_MASK = 0x0000ffffffffffff;
+    static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+
+    Value() : m_bits(TAG_EMPTY) {}
+    Value(std::nullptr_t) : m_bits(TAG_EMPTY) {}
+
+    explicit Value(int value) : m_bits(TAG_INT | static_cast<uint32_t>(value)) {}
+    explicit Value(bool value) : m_bits(TAG_BOOL | (value ? 1 : 0)) {}
+    explicit Value(double value);
+    explicit Value(Object* obj);
+
+    Value(const Value& other) : m_bits(other.m_bits) { retain(); }
+    Value(Value&& other) noexcept : m_bits(other.m_bits) { other.m_bits = TAG_EMPTY; }
+
+    Value& operator= (const Value& other);
+    Value& operator= (Value&& other) noexcept;
+
+    ~Value() { release(); }
+
+    static Value nil() { Value value; value.m_bits = TAG_NIL; return value; }
+
+    // Raw bits, for passing values through the C ABI of native modules.
+    // adoptBits takes over the reference the bits hold, releaseBits gives
+    // it up to whoever takes the bits.
+    uint64_t bits() const { return m_bits; }
+    static Value adoptBits(uint64_t bits) { Value value; value.m_bits = bits; return value; }
+    uint64_t releaseBits() { const uint64_t bits = m_bits; m_bits = TAG_EMPTY; return bits; }
+
+    bool isEmpty() const { return m_bits == TAG_EMPTY; }
+    bool isNil() const { return m_bits == TAG_NIL; }
+    bool isBool() const { return (m_bits & TAG_MASK) == TAG_BOOL; }
+    bool isInt() const { return (m_bits & TAG_MASK) == TAG_INT; }
+    bool isFloat() const { return (m_bits & QNAN) != QNAN; }
+    bool isObject() const { return (m_bits & TAG_MASK) == TAG_OBJ; }
+
+    int asInt() const { return static_cast<int>(static_cast<uint32_t>(m_bits)); }
+    bool asBool() const { return (m_bits & 1) != 0; }
+    double asFloat() const { double value; std::memcpy(&value, &m_bits, sizeof(value)); return value; }
+    Object* asObject() const { return reinterpret_cast<Object*>(m_bits & PAYLOAD_MASK); }
+
+    template <typename T>
+    T* as() const { return static_cast<T*>(asObject()); }
+
+    explicit operator bool() const { return !isEmpty(); }
+
+    // Values used to be pointers, so they keep the arrow syntax
+    const Value* operator-> () const { return this; }
+
+    friend bool operator== (const Value& value, std::nullptr_t) { return value.isEmpty(); }
+    friend bool operator!= (const Value& value, std::nullptr_t) { return !value.isEmpty(); }
+
+    const std::string inspect() const;
+    const std::string typeString() const;
+
+    int getType() const;
+    int getSlotCount() const;
+
+    int getIntVal() const;
+    bool getBoolVal() const;
+    double getFloatVal() const;
+    const std::string& getStrVal() const;
+
+    Value getObjValue() const;
+    BlockStatement* getBody() const;
+    EnvPtr getEnv() const;
+
+    // Valid as long as the object is, empty for anything else
+    const std::vector<Identifier>& getParams() const;
+    const PersistentVector& getElements() const;
+    const HashTable& getPairs() const;
+
+    HashKey hashKey() const;
+
+    // Value stored under key in a hash, empty if there is none
+    Value getValueAt(const Value& key) const;
+
+    // Lets the collector follow the reference, if this is one
+    void trace(void (*visit)(HeapCell*)) const;
+};
+
+template <typename T, typename... Args>
+Value makeObject(Args&&... args) {
+    return Value(new T(std::forward<Args>(args)...));
+}
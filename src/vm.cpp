@@ -0,0 +1,443 @@
+#include "vm.h"
+#include "evaluator.h"
+
+VM::VM()
+    : m_stack(STACK_SIZE) {
+}
+
+Value VM::run(const Bytecode& bytecode) {
+    m_constants = bytecode.constants;
+    m_global_names = bytecode.global_names;
+
+    if (m_globals.size() < m_global_names.size())
+        m_globals.resize(m_global_names.size());
+
+    auto main_func = makeObject<CompiledFunction>(bytecode.instructions, 0, std::vector<Identifier>(), nullptr, nullptr);
+    auto main_closure = makeObject<Closure>(main_func, std::vector<Value>());
+
+    m_sp = 0;
+    m_frames.clear();
+    m_frames.push_back({main_closure, 0, 0});
+
+    auto result = execute();
+
+    while (m_sp > 0)
+        pop();
+    m_frames.clear();
+
+    return result;
+}
+
+Value VM::execute() {
+    Value last_popped = nullptr;
+
+    while (true) {
+        Frame& frame = m_frames.back();
+        const Instructions& ins = frame.getClosure()->compiled()->instructions;
+        size_t& ip = frame.ip;
+
+        if (ip >= ins.size())
+            break;
+
+        const uint8_t op = ins[ip];
+
+        switch (op)
+        {
+        case OP_CONSTANT: {
+            const auto index = static_cast<size_t>(code::readUint16(ins, ip + 1));
+            ip += 3;
+            push(m_constants[index]);
+            break;
+        }
+        case OP_POP: {
+            ip += 1;
+            auto value = pop();
+
+            if (evaluator::isError(value)) {
+                if (returnFromFrame(value))
+                    return value;
+                break;
+            }
+            if (m_frames.size() == 1)
+                last_popped = value;
+            break;
+        }
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_EQ:
+        case OP_NOT_EQ:
+        case OP_LT:
+        case OP_GT: {
+            ip += 1;
+            auto right = pop();
+            auto left = pop();
+            push(binaryOp(op, left, right));
+            break;
+        }
+        case OP_MINUS:
+        case OP_BANG: {
+            ip += 1;
+            auto right = pop();
+
+            if (evaluator::isError(right))
+                push(right);
+            else if (op == OP_MINUS)
+                push(evaluator::evalMinusOperator(right));
+            else
+                push(evaluator::evalBangOperator(right));
+            break;
+        }
+        case OP_TRUE:
+            ip += 1;
+            push(Value(true));
+            break;
+        case OP_FALSE:
+            ip += 1;
+            push(Value(false));
+            break;
+        case OP_NIL:
+            ip += 1;
+            push(Value::nil());
+            break;
+        case OP_JUMP:
+            ip = static_cast<size_t>(code::readUint16(ins, ip + 1));
+            break;
+        case OP_JUMP_NOT_TRUTHY: {
+            const auto target = static_cast<size_t>(code::readUint16(ins, ip + 1));
+            ip += 3;
+            auto cond = pop();
+
+            if (evaluator::isError(cond)) {
+                if (returnFromFrame(cond))
+                    return cond;
+                break;
+            }
+            if (!evaluator::isTrue(cond))
+                ip = target;
+            break;
+        }
+        case OP_GET_GLOBAL: {
+            const auto index = static_cast<size_t>(code::readUint16(ins, ip + 1));
+            ip += 3;
+
+            if (m_globals[index])
+                push(m_globals[index]);
+            else
+                push(makeObject<Error>("identifier not found: " + m_global_names[index]));
+            break;
+        }
+        case OP_SET_GLOBAL: {
+            const auto index = static_cast<size_t>(code::readUint16(ins, ip + 1));
+            ip += 3;
+            auto value = pop();
+
+            if (evaluator::isError(value)) {
+                if (returnFromFrame(value))
+                    return value;
+                break;
+            }
+            m_globals[index] = value;
+            break;
+        }
+        case OP_GET_LOCAL: {
+            const auto index = static_cast<size_t>(code::readUint8(ins, ip + 1));
+            ip += 2;
+            const auto& local = m_stack[frame.base + index];
+
+            // A local whose let statement was skipped by an if expression
+            push(local ? local : Value::nil());
+            break;
+        }
+        case OP_SET_LOCAL: {
+            const auto index = static_cast<size_t>(code::readUint8(ins, ip + 1));
+            ip += 2;
+            auto value = pop();
+
+            if (evaluator::isError(value)) {
+                if (returnFromFrame(value))
+                    return value;
+                break;
+            }
+            m_stack[frame.base + index] = value;
+            break;
+        }
+        case OP_GET_FREE: {
+            const auto index = static_cast<size_t>(code::readUint8(ins, ip + 1));
+            ip += 2;
+            push(frame.getClosure()->free[index]);
+            break;
+        }
+        case OP_CURRENT_CLOSURE:
+            ip += 1;
+            push(frame.closure);
+            break;
+        case OP_ARRAY: {
+            const auto n = static_cast<size_t>(code::readUint16(ins, ip + 1));
+            ip += 3;
+            auto array = buildArray(n);
+            push(array);
+            break;
+        }
+        case OP_HASH: {
+            const auto n = static_cast<size_t>(code::readUint16(ins, ip + 1));
+            ip += 3;
+            auto hash = buildHash(n);
+            push(hash);
+            break;
+        }
+        case OP_INDEX: {
+            ip += 1;
+            auto index = pop();
+            auto left = pop();
+
+            if (evaluator::isError(left))
+                push(left);
+            else if (evaluator::isError(index))
+                push(index);
+            else
+                push(evaluator::evalIndexExpr(left, index));
+            break;
+        }
+        case OP_CALL: {
+            const auto n_args = static_cast<size_t>(code::readUint8(ins, ip + 1));
+            ip += 2;
+
+            // Pushing a frame invalidates frame, so it is not used after this
+            auto result = callFunction(n_args);
+            if (result)
+                push(result);
+            break;
+        }
+        case OP_RETURN_VALUE: {
+            auto value = pop();
+
+            if (returnFromFrame(value))
+                return value;
+            break;
+        }
+        case OP_CLOSURE: {
+            const auto index = static_cast<size_t>(code::readUint16(ins, ip + 1));
+            const auto n_free = static_cast<size_t>(code::readUint8(ins, ip + 3));
+            ip += 4;
+
+            std::vector<Value> free(n_free);
+            for (size_t i = 0; i < n_free; i++)
+                free[i] = m_stack[m_sp - n_free + i];
+            for (size_t i = 0; i < n_free; i++)
+                pop();
+
+            push(makeObject<Closure>(m_constants[index], free));
+            break;
+        }
+        default:
+            return makeObject<Error>("unknown opcode: " + std::to_string(op));
+        }
+
+        if (m_sp >= STACK_SIZE - 1)
+            return makeObject<Error>("stack overflow");
+    }
+
+    return last_popped;
+}
+
+// Pops the current frame and pushes value as the result of the call.
+// Returns true when the main frame returned, which ends the program.
+bool VM::returnFromFrame(const Value& value) {
+    if (m_frames.size() == 1)
+        return true;
+
+    const size_t callee_pos = m_frames.back().base - 1;
+    m_frames.pop_back();
+
+    while (m_sp > callee_pos)
+        pop();
+    push(value);
+
+    return false;
+}
+
+// Calls the function below the n_args arguments on the stack. Returns
+// nullptr if a frame was pushed, otherwise the result of the call.
+Value VM::callFunction(size_t n_args) {
+    const size_t callee_pos = m_sp - 1 - n_args;
+    auto callee = m_stack[callee_pos];
+
+    // Mirror evaluator::evalExprs: arguments are cut after the first error,
+    // and only an error in the first argument is returned directly.
+    for (size_t i = 0; i < n_args; i++) {
+        if (!evaluator::isError(m_stack[callee_pos + 1 + i]))
+            continue;
+
+        if (i == 0)
+            callee = m_stack[callee_pos + 1];
+
+        while (m_sp > callee_pos + 2 + i)
+            pop();
+        n_args = i + 1;
+        break;
+    }
+
+    if (evaluator::isError(callee) || callee->getType() != OBJ_CLOSURE) {
+        std::vector<Value> args(n_args);
+        for (size_t i = 0; i < n_args; i++)
+            args[i] = m_stack[callee_pos + 1 + i];
+
+        while (m_sp > callee_pos)
+            pop();
+
+        if (evaluator::isError(callee))
+            return callee;
+
+        return evaluator::applyFunction(callee, args);
+    }
+
+    const auto* func = callee.as<Closure>()->compiled();
+
+    if (static_cast<size_t>(func->n_params) != n_args) {
+        while (m_sp > callee_pos)
+            pop();
+
+        return makeObject<Error>("wrong number of arguments. got=" + std::to_string(n_args) + ", want=" + std::to_string(func->n_params));
+    }
+
+    if (m_frames.size() >= MAX_FRAMES || callee_pos + 1 + static_cast<size_t>(func->n_locals) >= STACK_SIZE) {
+        while (m_sp > callee_pos)
+            pop();
+
+        return makeObject<Error>("stack overflow");
+    }
+
+    const size_t base = callee_pos + 1;
+    const size_t new_sp = base + static_cast<size_t>(func->n_locals);
+    for (size_t i = m_sp; i < new_sp; i++)
+        m_stack[i] = nullptr;
+
+    m_frames.push_back({callee, 0, base});
+    m_sp = new_sp;
+
+    return nullptr;
+}
+
+// Mirrors evaluator::evalExprs: elements after the first error are dropped
+Value VM::buildArray(size_t n_elements) {
+    const size_t start = m_sp - n_elements;
+    std::vector<Value> elements;
+
+    for (size_t i = 0; i < n_elements; i++) {
+        const auto& element = m_stack[start + i];
+        elements.push_back(element);
+
+        if (!evaluator::isError(element))
+            continue;
+
+        if (i == 0)
+            elements = {element};
+        break;
+    }
+
+    while (m_sp > start)
+        pop();
+
+    if (elements.size() == 1 && evaluator::isError(elements[0]))
+        return elements[0];
+
+    return makeObject<Array>(elements);
+}
+
+Value VM::buildHash(size_t n_items) {
+    const size_t start = m_sp - n_items;
+    HashTable pairs;
+    Value result = nullptr;
+
+    for (size_t i = start; i < m_sp; i += 2) {
+        const auto& key = m_stack[i];
+        const auto& value = m_stack[i + 1];
+
+        if (evaluator::isError(key)) {
+            result = key;
+            break;
+        }
+        if (evaluator::isError(value)) {
+            result = value;
+            break;
+        }
+
+        auto hashed = key->hashKey();
+        if (hashed.type == OBJ_NIL) {
+            result = makeObject<Error>("unusable as hash key");
+            break;
+        }
+
+        pairs.set(hashed, key, value);
+    }
+
+    while (m_sp > start)
+        pop();
+
+    if (result)
+        return result;
+
+    return makeObject<Hash>(std::move(pairs));
+}
+
+Value VM::binaryOp(uint8_t op, const Value& left, const Value& right) {
+    if (evaluator::isError(left))
+        return left;
+    if (evaluator::isError(right))
+        return right;
+
+    if (left->getType() == OBJ_INT && right->getType() == OBJ_INT) {
+        const int left_value = left->getIntVal();
+        const int right_value = right->getIntVal();
+
+        switch (op)
+        {
+        case OP_ADD:
+            return Value(left_value + right_value);
+        case OP_SUB:
+            return Value(left_value - right_value);
+        case OP_MUL:
+            return Value(left_value * right_value);
+        case OP_LT:
+            return Value(left_value < right_value);
+        case OP_GT:
+            return Value(left_value > right_value);
+        case OP_EQ:
+            return Value(left_value == right_value);
+        case OP_NOT_EQ:
+            return Value(left_value != right_value);
+        default:
+            break;
+        }
+    }
+
+    switch (op)
+    {
+    case OP_ADD:
+        return evaluator::evalInfixExpr(OPRTR_ADD, left, right);
+    case OP_SUB:
+        return evaluator::evalInfixExpr(OPRTR_SUB, left, right);
+    case OP_MUL:
+        return evaluator::evalInfixExpr(OPRTR_MUL, left, right);
+    case OP_DIV:
+        return evaluator::evalInfixExpr(OPRTR_DIV, left, right);
+    case OP_LT:
+        return evaluator::evalInfixExpr(OPRTR_LT, left, right);
+    case OP_GT:
+        return evaluator::evalInfixExpr(OPRTR_GT, left, right);
+    case OP_EQ:
+        return evaluator::evalInfixExpr(OPRTR_EQ, left, right);
+    default:
+        return evaluator::evalInfixExpr(OPRTR_NOT_EQ, left, right);
+    }
+}
+
+void VM::push(Value obj) {
+    m_stack[m_sp++] = std::move(obj);
+}
+
+Value VM::pop() {
+    return std::move(m_stack[--m_sp]);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "compiler.h"
+
+const size_t STACK_SIZE = 1 << 16;
+const size_t MAX_FRAMES = 1 << 12;
+
+struct Frame {
+    Value closure;
+    size_t ip;
+    size_t base;
+
+    const Closure* getClosure() const { return closure.as<Closure>(); }
+};
+
+// Stack based virtual machine executing the bytecode produced by Compiler.
+// Globals survive between calls to run(), which makes it usable from the REPL.
+class VM {
+    std::vector<Value> m_constants;
+    std::vector<Value> m_globals;
+    std::vector<std::string> m_global_names;
+
+    std::vector<Value> m_stack;
+    size_t m_sp {0};
+
+    std::vector<Frame> m_frames;
+
+public:
+    VM();
+
+    Value run(const Bytecode& bytecode);
+
+    Value execute();
+    Value callFunction(size_t n_args);
+    Value buildArray(size_t n_elements);
+    Value buildHash(size_t n_items);
+    Value binaryOp(uint8_t op, const Value& left, const Value& right);
+
+    bool returnFromFrame(const Value& value);
+
+    void push(Value obj);
+
+    Value pop();
+};
@@ -0,0 +1,41 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+static bool counting = false;
+static size_t n_allocs = 0;
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    if (counting)
+        n_allocs++;
+
+    if (void* ptr = std::malloc(size))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr, size_t size) noexcept {
+    (void)size;
+    std::free(ptr);
+}
+
+namespace alloc_counter {
+
+void start() {
+    n_allocs = 0;
+    counting = true;
+}
+
+size_t stop() {
+    counting = false;
+
+    return n_allocs;
+}
+
+} // alloc_counter
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts calls to the global operator new between start() and stop()
+namespace alloc_counter {
+
+void start();
+size_t stop();
+
+} // alloc_counter
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <unistd.h>
+
+#include "../src/aot.h"
+#include "../src/evaluator.h"
+#include "../src/parser.h"
+#include "../src/thunk.h"
+
+static std::shared_ptr<Program> parse(const std::string& input) {
+    Lexer lexer(input);
+    Parser parser(lexer);
+
+    return parser.parseProgram();
+}
+
+static std::string testCacheDir() {
+    return (std::filesystem::temp_directory_path() / ("toylang_aot_test_" + std::to_string(getpid()))).string();
+}
+
+TEST(AotTest, TestSameResultsAsEvaluator) {
+    // Each program is compiled, so they're few and each covers a lot
+    const std::vector<std::string> tests = {
+        "let fib = func(n) { if (n < 2) { n } else { fib(n-1) + fib(n-2) } }; "
+        "let loop = func(n, acc) { if (n == 0) { acc } else { loop(n - 1, acc + n) } }; "
+        "[fib(20), loop(100000, 0), 2147483647 + 1, -7 / 2, 2.5 * 2, 1 < 2, !true, -(3), \"ab\" + \"c\", 5 / 0.5]",
+        "let add = func(a) { func(b) { a + b } }; let addTwo = add(2); "
+        "let h = {\"a\": 1, 2: addTwo(3), true: [1, 2][1]}; "
+        "[h[\"a\"], h[2], h[true], h[3], \"abc\"[1], [1, 2, 3][5], len([1, 2]), addTwo, push([1], 2)]",
+        "let f = func(x) { if (x > 10) { return x * 2; } x - 1 }; let g = func(x) { 1 + if (x > 0) { return 5; } else { 2 } }; "
+        "[f(11), f(3), g(1), g(0), if (false) { 1 }, [1, 2] + [3, 4], [1, zz, 3]]",
+        "let f = func(x, y) { x + y }; f(1)",
+        "let x = 5; x + true",
+        "let d = func(x) { 7 / x }; [d(2), (-2147483647 - 1) / -1, d(0)]",
+        "{\"a\": 1}[func(x) { x }]",
+        "let f = func() { return 7; 8 }; let x = f(); return x * 2; 99",
+        "let a = 1; let b = {[1]: 2}; 3",
+        ""
+    };
+
+    aot::ModuleCache cache(testCacheDir());
+
+    for (const auto& test : tests) {
+        auto expected = evaluator::eval(parse(test), makeRef<Env>());
+        auto obj = cache.run(parse(test), makeRef<Env>());
+
+        ASSERT_TRUE(cache.errors().empty()) << cache.errors().front();
+        EXPECT_EQ(obj.isEmpty(), expected.isEmpty()) << test;
+        if (!obj.isEmpty() && !expected.isEmpty()) {
+            EXPECT_EQ(obj->inspect(), expected->inspect()) << test;
+            EXPECT_EQ(obj->typeString(), expected->typeString()) << test;
+        }
+    }
+
+    std::filesystem::remove_all(testCacheDir());
+}
+
+TEST(AotTest, TestFunctionsAcrossEngines) {
+    aot::ModuleCache cache(testCacheDir());
+    EnvPtr env = makeRef<Env>();
+
+    cache.run(parse("let twice = func(f, x) { f(f(x)) }; let sq = func(x) { x * x }"), env);
+    ASSERT_TRUE(cache.errors().empty()) << cache.errors().front();
+
+    EXPECT_EQ(evaluator::eval(parse("twice(func(x) { x + 1 }, 5)"), env)->inspect(), "7");
+    EXPECT_EQ(thunk::eval(parse("twice(sq, 3)"), env)->inspect(), "81");
+    EXPECT_EQ(evaluator::eval(parse("sq"), env)->inspect(), "func(x) {\n(x * x)\n}");
+
+    std::filesystem::remove_all(testCacheDir());
+}
+
+TEST(AotTest, TestModuleCache) {
+    namespace fs = std::filesystem;
+
+    const std::string source = aot::emitCpp(parse("let f = func(x) { x * 3 }; f(14)"));
+    fs::remove_all(testCacheDir());
+
+    aot::ModuleCache cache(testCacheDir());
+    auto main = cache.load(source);
+    ASSERT_NE(main, nullptr) << cache.errors().front();
+    EXPECT_EQ(cache.load(source), main);
+
+    std::vector<fs::path> modules;
+    for (const auto& entry : fs::directory_iterator(testCacheDir()))
+        modules.push_back(entry.path());
+
+    ASSERT_EQ(modules.size(), 1);
+    EXPECT_EQ(modules[0].extension(), ".so");
+    const auto compiled_at = fs::last_write_time(modules[0]);
+
+    // Another cache on the same dir loads the module without compiling it
+    aot::ModuleCache other(testCacheDir());
+    EXPECT_NE(other.load(source), nullptr);
+    EXPECT_EQ(fs::last_write_time(modules[0]), compiled_at);
+    EXPECT_EQ(std::distance(fs::directory_iterator(testCacheDir()), fs::directory_iterator()), 1);
+
+    // A compiler that fails
+    aot::ModuleCache failing(testCacheDir(), "false");
+    EXPECT_EQ(failing.load(source), nullptr);
+    EXPECT_FALSE(failing.errors().empty());
+
+    fs::remove_all(testCacheDir());
+}
+
+TEST(AotTest, TestPrivateCacheDir) {
+    namespace fs = std::filesystem;
+
+    const std::string source = aot::emitCpp(parse("1 + 2"));
+    fs::remove_all(testCacheDir());
+
+    aot::ModuleCache cache(testCacheDir());
+    ASSERT_NE(cache.load(source), nullptr) << cache.errors().front();
+    EXPECT_EQ(fs::status(testCacheDir()).permissions(), fs::perms::owner_all);
+
+    // A module others can write to isn't loaded, nor is one in a dir they can write to
+    const fs::path module = fs::directory_iterator(testCacheDir())->path();
+    fs::permissions(module, fs::perms::others_write, fs::perm_options::add);
+
+    aot::ModuleCache planted(testCacheDir());
+    EXPECT_EQ(planted.load(source), nullptr);
+    ASSERT_EQ(planted.errors().size(), 1);
+    EXPECT_EQ(planted.errors()[0], "won't load module: " + module.string() + " can be written by other users");
+
+    fs::permissions(module, fs::perms::others_write, fs::perm_options::remove);
+    fs::permissions(testCacheDir(), fs::perms::group_write, fs::perm_options::add);
+
+    aot::ModuleCache shared(testCacheDir());
+    EXPECT_EQ(shared.load(source), nullptr);
+    ASSERT_EQ(shared.errors().size(), 1);
+    EXPECT_EQ(shared.errors()[0], "won't use cache dir: " + testCacheDir() + " can be written by other users");
+
+    // No cache dir at all rather than a shared one
+    aot::ModuleCache none("");
+    EXPECT_EQ(none.load(source), nullptr);
+    EXPECT_EQ(none.errors()[0], "no private cache dir for modules, set HOME or TOYLANG_CACHE_DIR");
+
+    fs::remove_all(testCacheDir());
+}
@@ -2,6 +2,9 @@
 
 #include "../src/parser.h"
 #include "../src/evaluator.h"
+#include "../src/builtin.h"
+#include "../src/machine.h"
+#include "../src/vm.h"
 
 template <typename T>
 struct BuiltinTest {
@@ -21,7 +24,7 @@ TEST(BuiltinTest, TestBuiltinLen) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -39,7 +42,7 @@ TEST(BuiltinTest, TestBuiltinFirstLast) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -60,7 +63,7 @@ TEST(BuiltinTest, TestBuiltinPush) {
     };
 
     for (const auto& test : tests_a) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -69,7 +72,7 @@ TEST(BuiltinTest, TestBuiltinPush) {
     }
 
     for (const auto& test : tests_b) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -78,6 +81,103 @@ TEST(BuiltinTest, TestBuiltinPush) {
     }
 }
 
+TEST(BuiltinTest, TestBuiltinPushReuse) {
+    // Only the arguments hold the array, so push grows it in place
+    Value unique = makeObject<Array>(std::vector<Value>{Value(1)});
+    Object* const array = unique.asObject();
+    std::vector<Value> args = {std::move(unique), Value(2)};
+
+    auto pushed = push(args);
+    EXPECT_EQ(pushed.asObject(), array);
+    EXPECT_EQ(pushed->inspect(), "[1, 2]");
+
+    // Anyone else holding it must not see the change
+    auto shared = push(args);
+    EXPECT_NE(shared.asObject(), array);
+    EXPECT_EQ(shared->inspect(), "[1, 2, 2]");
+    EXPECT_EQ(pushed->inspect(), "[1, 2]");
+
+    const std::vector<BuiltinTest<std::string>> tests = {
+        {"let build = func(arr, n) { if (n == 0) { arr } else { build(push(arr, n), n - 1) } }; build([], 5)", "[5, 4, 3, 2, 1]"},
+        {"let f = func(x) { let x = push(x, 2); let x = push(x, 3); x }; f([1])", "[1, 2, 3]"},
+        {"let f = func(x) { let y = push(x, 2); x }; f([1])", "[1]"},
+        {"let a = [1]; let f = func(x) { push(x, 2) }; let b = f(a); a", "[1]"},
+        {"let f = func(x) { let g = func() { x }; let y = push(x, 2); g() }; f([1])", "[1]"},
+        {"let f = func(x, c) { let y = if (c) { push(x, 5) } else { x }; [x, y] }; f([1], true)", "[[1], [1, 5]]"},
+        {"let f = func(x, c) { if (c) { return push(x, 5); }; x }; f([1], false)", "[1]"}
+    };
+
+    for (const auto& test : tests) {
+        EnvPtr env = makeRef<Env>();
+        Lexer lexer(test.input);
+        Parser parser(lexer);
+        auto obj = evaluator::eval(parser.parseProgram(), env);
+        EXPECT_EQ(obj->inspect(), test.expected) << test.input;
+    }
+}
+
+TEST(BuiltinTest, TestBuiltinReductions) {
+    const std::vector<BuiltinTest<std::string>> tests = {
+        {"sum([])", "0"},
+        {"sum([1, 2, 3])", "6"},
+        {"sum([1, 2.5])", "3.500000"},
+        {"sum([2147483647, 1])", "-2147483648"},
+        {"min([3, -1, 2])", "-1"},
+        {"max([3, -1, 2])", "3"},
+        {"min([2, 1.5, 1])", "1"},
+        {"max([2, 2.5, 1])", "2.500000"},
+        {"min([])", "nil"},
+        {"mean([1, 2, 3, 4])", "2.500000"},
+        {"mean([2147483647, 2147483647])", "2147483647.000000"},
+        {"mean([])", "nil"},
+        {"dot([1, 2, 3], [4, 5, 6])", "32"},
+        {"dot([1, 2], [0.5, 0.25])", "1.000000"},
+        {"dot([], [])", "0"},
+        {"sum(\"abc\")", "Error: argument to 'sum' must be ARRAY, got=STRING"},
+        {"max([1, true])", "Error: argument to 'max' must be ARRAY of numbers, got element=BOOLEAN"},
+        {"mean([1], [2])", "Error: wrong number of arguments. got=2, want=1"},
+        {"dot([1, 2], [1])", "Error: arguments to 'dot' must have the same length, got=2 and 1"}
+    };
+
+    for (const auto& test : tests) {
+        EnvPtr env = makeRef<Env>();
+        Lexer lexer(test.input);
+        Parser parser(lexer);
+        auto obj = evaluator::eval(parser.parseProgram(), env);
+        EXPECT_EQ(obj->inspect(), test.expected) << test.input;
+    }
+
+    // Long enough for packed leaves and the vector loops, with a mixed leaf
+    std::vector<Value> ints;
+    std::vector<Value> mixed;
+    int int_sum = 0;
+    double mixed_sum = 0;
+
+    for (int i = 0; i < 1000; i++) {
+        ints.push_back(Value(i * 7 % 1001 - 500));
+        int_sum += i * 7 % 1001 - 500;
+
+        mixed.push_back(i == 500 ? Value(0.5) : Value(i));
+        mixed_sum += i == 500 ? 0.5 : i;
+    }
+
+    const Value int_array = makeObject<Array>(ints);
+    const Value mixed_array = makeObject<Array>(mixed);
+
+    EXPECT_EQ(sum({int_array}).getIntVal(), int_sum);
+    EXPECT_EQ(min({int_array}).getIntVal(), -500);
+    EXPECT_EQ(max({int_array}).getIntVal(), 494);
+    EXPECT_DOUBLE_EQ(sum({mixed_array}).getFloatVal(), mixed_sum);
+    EXPECT_DOUBLE_EQ(min({mixed_array}).getFloatVal(), 0);
+    EXPECT_EQ(max({mixed_array}).getIntVal(), 999);
+    EXPECT_DOUBLE_EQ(dot({int_array, mixed_array}).getFloatVal(), [&] {
+        double expected = 0;
+        for (size_t i = 0; i < ints.size(); i++)
+            expected += ints[i].getFloatVal() * mixed[i].getFloatVal();
+        return expected;
+    }());
+}
+
 TEST(BuiltinTest, TestBuiltinType) {
     const std::vector<BuiltinTest<std::string>> tests = {
         {"type(25)", "INTEGER"},
@@ -90,7 +190,7 @@ TEST(BuiltinTest, TestBuiltinType) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -112,7 +212,7 @@ TEST(BuiltinTest, TestBuiltinPrint) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -142,7 +242,7 @@ TEST(BuiltinTest, TestBuiltinFunctionErrors) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -150,3 +250,52 @@ TEST(BuiltinTest, TestBuiltinFunctionErrors) {
         EXPECT_EQ(obj->getType(), OBJ_ERROR);
     }
 }
+
+static Value scale(const std::vector<Value>& args) {
+    return Value(args[0].getIntVal() * args[1].getIntVal());
+}
+
+static Value countArgs(const std::vector<Value>& args) {
+    return Value(static_cast<int>(args.size()));
+}
+
+TEST(BuiltinTest, TestRegisterBuiltin) {
+    registerBuiltin("scale", scale, 2);
+    registerBuiltin("count_args", countArgs);
+
+    EXPECT_TRUE(isBuiltIn("scale"));
+    EXPECT_FALSE(isBuiltIn("not_registered"));
+    EXPECT_FALSE(builtinObject("not_registered"));
+    EXPECT_EQ(builtinObject("scale").asObject(), builtinObject("scale").asObject());
+
+    const std::vector<BuiltinTest<std::string>> tests = {
+        {"scale(6, 7)", "42"},
+        {"let f = func(x) { scale(x, 2) }; f(21)", "42"},
+        {"let g = scale; g(3, 3)", "9"},
+        {"scale(1)", "Error: wrong number of arguments. got=1, want=2"},
+        {"count_args()", "0"},
+        {"count_args(1, true, [])", "3"},
+        {"let scale = func(x) { x }; scale(5)", "5"}
+    };
+
+    for (const auto& test : tests) {
+        Lexer lexer(test.input);
+        Parser parser(lexer);
+        auto program = parser.parseProgram();
+
+        EXPECT_EQ(evaluator::eval(program, makeRef<Env>())->inspect(), test.expected) << test.input;
+
+        Machine machine;
+        EXPECT_EQ(machine.run(program, makeRef<Env>())->inspect(), test.expected) << test.input;
+
+        Compiler compiler;
+        ASSERT_TRUE(compiler.compile(program)) << test.input;
+        VM vm;
+        EXPECT_EQ(vm.run(compiler.bytecode())->inspect(), test.expected) << test.input;
+    }
+
+    // Code already holding the builtin calls the replacement
+    auto held = builtinObject("scale");
+    registerBuiltin("scale", countArgs);
+    EXPECT_EQ(callBuiltin(held, {Value(1), Value(2), Value(3)})->inspect(), "3");
+}
@@ -2,6 +2,7 @@
 
 #include "../src/parser.h"
 #include "../src/evaluator.h"
+#include "alloc_counter.h"
 
 template <typename T>
 struct BuiltinTest {
@@ -29,7 +30,7 @@ TEST(EvaluatorTest, TestEvalIntegerExpr) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -57,7 +58,7 @@ TEST(EvaluatorTest, TestEvalFloatExpr) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -69,7 +70,7 @@ TEST(EvaluatorTest, TestEvalFloatExpr) {
 
 TEST(EvaluatorTest, TestEvalStringLiteral) {
     const std::string input = "\"Some string blaa\"";
-    EnvPtr env = std::make_shared<Env>();
+    EnvPtr env = makeRef<Env>();
     Lexer lexer(input);
     Parser parser(lexer);
 
@@ -108,7 +109,7 @@ TEST(EvaluatorTest, TestEvalBoolExpr) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -129,7 +130,7 @@ TEST(EvaluatorTest, TestEvalBangOperator) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -154,7 +155,7 @@ TEST(EvaluatorTest, TestEvalIfElseExpr) {
     };
 
     for (const auto& test : int_out_tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -164,7 +165,7 @@ TEST(EvaluatorTest, TestEvalIfElseExpr) {
     }
 
     for (const auto& test : nil_out_tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -185,7 +186,7 @@ TEST(EvaluatorTest, TestEvalReturnStatements) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -203,12 +204,14 @@ TEST(EvaluatorTest, TestErrorHandling) {
         {"if (10 > 1) { true + false; }","Error: unknown operator: BOOLEAN+BOOLEAN"},
         {"if (10 > 1) { if (10 > 1) { return true + false; } return 1; }", "Error: unknown operator: BOOLEAN+BOOLEAN"},
         {"some_var", "Error: identifier not found: some_var"},
+        {"1 / 0", "Error: division by zero"},
+        {"let f = func(x) { 5 / x }; f(0)", "Error: division by zero"},
         {"\"first str\" - \"second str\"", "Error: unknown operator: STRING-STRING"},
         {"{\"key\": \"hello\"}[func(x){ x+1 }]", "Error: unusable as hash key: FUNC"}
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -227,7 +230,7 @@ TEST(EvaluatorTest, TestEvalLetStatements) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -264,11 +267,11 @@ TEST(EvaluatorTest, TestEvalFunctionApp) {
         {"let fac = func(n) { if (n==0) { return 1; } else { return n*fac(n-1) } }; fac(5)", 120},
         {"let fib = func(n) { if (n==0) { 0 } else { if (n==1) { 1 } else { fib(n-1)+fib(n-2) } } }; fib(7)", 13},
         {"let callTwice = func(x, f) { f(f(x)) }; let addTwo = func(x) { return x + 2 }; callTwice(1, addTwo)", 5},
-        // {"let newAdder = func(x) { func(y) { x + y }; }; let addTwo = newAdder(2); addTwo(2);", 4}, // FIX: Closures doesn't seem to work now...
+        {"let newAdder = func(x) { func(y) { x + y }; }; let addTwo = newAdder(2); addTwo(2);", 4},
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -285,7 +288,7 @@ TEST(EvaluatorTest, TestEvalFunctioErrors) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -308,7 +311,7 @@ TEST(EvaluatorTest, TestStringConcatenation) {
 TEST(EvaluatorTest, TestEvalArrayLiterals) {
     const std::string input = "[1, 2*3, 4.25+0.25, false, \"a some_str\"]";
 
-    EnvPtr env = std::make_shared<Env>();
+    EnvPtr env = makeRef<Env>();
     Lexer lexer(input);
     Parser parser(lexer);
     auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -336,7 +339,7 @@ TEST(EvaluatorTest, TestEvalArrayIndexExpressions) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -353,7 +356,7 @@ TEST(EvaluatorTest, TestEvalArrayIndexExpressionsError) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -363,6 +366,68 @@ TEST(EvaluatorTest, TestEvalArrayIndexExpressionsError) {
     }
 }
 
+TEST(EvaluatorTest, TestArrayBroadcast) {
+    const std::vector<BuiltinTest<std::string>> tests = {
+        {"[1, 2, 3] + [10, 20, 30]", "[11, 22, 33]"},
+        {"[1, 2, 3] * 2", "[2, 4, 6]"},
+        {"10 - [1, 2, 3]", "[9, 8, 7]"},
+        {"[7, 8] / 2", "[3, 4]"},
+        {"[1, 2] + 0.5", "[1.500000, 2.500000]"},
+        {"[1.5, 2.5] * [2, 4]", "[3.000000, 10.000000]"},
+        {"[1, 2.5, 3] - 1", "[0, 1.500000, 2]"},
+        {"[1, 5, 3] > 2", "[false, true, true]"},
+        {"[1, 2] == [1, 3]", "[true, false]"},
+        {"[1.0, 2] != 1", "[false, true]"},
+        {"[2147483647] + 1", "[-2147483648]"},
+        {"[\"a\", \"b\"] + \"c\"", "['ac', 'bc']"},
+        {"[[1, 2], [3]] * 2", "[[2, 4], [6]]"},
+        {"[] + 1", "[]"},
+        {"[1, 2] + [1]", "Error: arrays must have the same length, got=2 and 1"},
+        {"[4, 2] / [2, 0]", "Error: division by zero"},
+        {"[1] / 0", "Error: division by zero"},
+        {"1 / [0]", "Error: division by zero"},
+        {"[-2147483647 - 1, 6] / -1", "[-2147483648, -6]"},
+        {"[-2147483647 - 1] / [-1]", "[-2147483648]"},
+        {"[1, true] + 1", "Error: unknown operator: BOOLEAN+INTEGER"},
+        {"[\"a\"] - \"b\"", "Error: unknown operator: STRING-STRING"}
+    };
+
+    for (const auto& test : tests) {
+        EnvPtr env = makeRef<Env>();
+        Lexer lexer(test.input);
+        Parser parser(lexer);
+        auto obj = evaluator::eval(parser.parseProgram(), env);
+        EXPECT_EQ(obj->inspect(), test.expected) << test.input;
+    }
+
+    // Enough elements for a trie of two levels, with a mixed leaf in it
+    std::vector<Value> ints;
+    std::vector<Value> mixed;
+
+    for (int i = 0; i < 2000; i++) {
+        ints.push_back(Value(i - 1000));
+        mixed.push_back(i == 1500 ? Value(0.5) : Value(i));
+    }
+
+    const Value int_array = makeObject<Array>(ints);
+    const Value mixed_array = makeObject<Array>(mixed);
+
+    for (const int oprtr : {OPRTR_ADD, OPRTR_SUB, OPRTR_MUL, OPRTR_LT, OPRTR_GT, OPRTR_EQ, OPRTR_NOT_EQ}) {
+        auto result = evaluator::evalInfixExpr(oprtr, int_array, mixed_array);
+        ASSERT_EQ(result->getType(), OBJ_ARRAY) << oprtr_lut[oprtr];
+        ASSERT_EQ(result->getElements().size(), 2000u) << oprtr_lut[oprtr];
+
+        for (size_t i = 0; i < ints.size(); i++) {
+            auto expected = evaluator::evalInfixExpr(oprtr, ints[i], mixed[i]);
+            ASSERT_EQ(result->getElements()[i]->inspect(), expected->inspect()) << oprtr_lut[oprtr] << " " << i;
+        }
+    }
+
+    auto scaled = evaluator::evalInfixExpr(OPRTR_DIV, mixed_array, Value(4));
+    EXPECT_EQ(scaled->getElements()[1999].getIntVal(), 499);
+    EXPECT_EQ(scaled->getElements()[1500].getFloatVal(), 0.125);
+}
+
 TEST(EvaluatorTest, TestEvalStringIndexExpressions) {
     const std::vector<BuiltinTest<std::string>> tests = {
         {"\"hello\"[0]", "h"},
@@ -373,7 +438,7 @@ TEST(EvaluatorTest, TestEvalStringIndexExpressions) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -390,7 +455,7 @@ TEST(EvaluatorTest, TestEvalStringIndexExpressionsError) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -402,28 +467,25 @@ TEST(EvaluatorTest, TestEvalStringIndexExpressionsError) {
 
 TEST(EvaluatorTest, TestEvalHashLiterals) {
     const std::string input = "let str = \"two\"; {\"one\": 10 - 9, str: 1+1, \"thr\" + \"ee\": 9/3, 4: 4, true: 5, false: 6}";
-    const std::map<HashKey, int> expected = {
-        {std::make_shared<String>("one")->hashKey(), 1},
-        {std::make_shared<String>("two")->hashKey(), 2},
-        {std::make_shared<String>("three")->hashKey(), 3},
-        {std::make_shared<Integer>(4)->hashKey(), 4},
-        {std::make_shared<Bool>(true)->hashKey(), 5},
-        {std::make_shared<Bool>(false)->hashKey(), 6}
+    const std::vector<std::pair<Value, int>> expected = {
+        {makeObject<String>("one"), 1},
+        {makeObject<String>("two"), 2},
+        {makeObject<String>("three"), 3},
+        {Value(4), 4},
+        {Value(true), 5},
+        {Value(false), 6}
     };
 
-    EnvPtr env = std::make_shared<Env>();
+    EnvPtr env = makeRef<Env>();
     Lexer lexer(input);
     Parser parser(lexer);
     auto hash = evaluator::eval(parser.parseProgram(), env);
-    auto pairs = hash->getPairs();
 
     EXPECT_EQ(hash->getType(), OBJ_HASH);
-    EXPECT_EQ(pairs.size(), expected.size());
+    EXPECT_EQ(hash->getPairs().size(), expected.size());
 
-    for (const auto& [hash_key, value] : expected) {
-        auto pair = pairs[hash_key];
-        EXPECT_EQ(pair->value->getIntVal(), value);
-    }
+    for (const auto& [key, value] : expected)
+        EXPECT_EQ(hash->getValueAt(key)->getIntVal(), value);
 }
 
 TEST(EvaluatorTest, TestEvalHashIndexing) {
@@ -432,11 +494,13 @@ TEST(EvaluatorTest, TestEvalHashIndexing) {
         {"let key = \"foo\"; {\"foo\": 5}[key]", 5},
         {"{42: 5}[42]", 5},
         {"{true: 5}[true]", 5},
-        {"{false: 5}[false]", 5}
+        {"{false: 5}[false]", 5},
+        {"{1: 5, true: 6}[1]", 5},
+        {"{1: 5, true: 6}[true]", 6}
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -454,7 +518,7 @@ TEST(EvaluatorTest, TestEvalHashIndexExpressionsError) {
     };
 
     for (const auto& test : tests) {
-        EnvPtr env = std::make_shared<Env>();
+        EnvPtr env = makeRef<Env>();
         Lexer lexer(test.input);
         Parser parser(lexer);
         auto obj = evaluator::eval(parser.parseProgram(), env);
@@ -463,3 +527,125 @@ TEST(EvaluatorTest, TestEvalHashIndexExpressionsError) {
         EXPECT_EQ(obj->getType(), OBJ_NIL);
     }
 }
+
+TEST(EvaluatorTest, TestNumericExprDoesNotAllocate) {
+    const std::vector<std::string> tests = {
+        "(5 + 10 * 2 + 15 / 3) * 2 + -10",
+        "1.5 * 2.0 - 0.25",
+        "1 < 2 == true",
+        "!(3 > 4)",
+    };
+
+    for (const auto& test : tests) {
+        EnvPtr env = makeRef<Env>();
+        Lexer lexer(test);
+        Parser parser(lexer);
+        auto program = parser.parseProgram();
+        auto expr = program->getStatementAt(0)->getExpr();
+
+        alloc_counter::start();
+        auto obj = evaluator::eval(expr, env);
+        const size_t n_allocs = alloc_counter::stop();
+
+        EXPECT_EQ(n_allocs, 0u) << test;
+        EXPECT_NE(obj->getType(), OBJ_ERROR);
+    }
+}
+
+TEST(EvaluatorTest, TestSharedObjectsDoNotAllocate) {
+    EnvPtr env = makeRef<Env>();
+    Lexer setup_lexer("let s = \"abc\"; let n = 3;");
+    Parser setup_parser(setup_lexer);
+    evaluator::eval(setup_parser.parseProgram(), env);
+
+    const std::vector<std::string> tests = {
+        "(n > 2) == !(n < 1)",
+        "s[1]",
+        "len",
+    };
+
+    for (const auto& test : tests) {
+        Lexer lexer(test);
+        Parser parser(lexer);
+        auto program = parser.parseProgram();
+        auto expr = program->getStatementAt(0)->getExpr();
+
+        // The first run may create the shared objects
+        evaluator::eval(expr, env);
+
+        alloc_counter::start();
+        auto obj = evaluator::eval(expr, env);
+        const size_t n_allocs = alloc_counter::stop();
+
+        EXPECT_EQ(n_allocs, 0u) << test;
+        if (obj.isObject()) {
+            EXPECT_EQ(obj.asObject(), evaluator::eval(expr, env).asObject()) << test;
+        }
+    }
+}
+
+TEST(EvaluatorTest, TestIndexingAndBlocksDoNotCopy) {
+    EnvPtr env = makeRef<Env>();
+    Lexer setup_lexer("let arr = [1, 2, 3, [4, 5], {1: 6}]; let n = 3;");
+    Parser setup_parser(setup_lexer);
+    evaluator::eval(setup_parser.parseProgram(), env);
+
+    const std::vector<std::pair<std::string, std::string>> tests = {
+        {"arr[2]", "3"},
+        {"arr[3][1]", "5"},
+        {"arr[4][1]", "6"},
+        {"if (n > 2) { n < 5 } else { false }", "true"},
+        {"if (n == 3) { if (n != 4) { arr[0] } }", "1"},
+    };
+
+    for (const auto& [input, expected] : tests) {
+        Lexer lexer(input);
+        Parser parser(lexer);
+        auto program = parser.parseProgram();
+        auto expr = program->getStatementAt(0)->getExpr();
+
+        alloc_counter::start();
+        auto obj = evaluator::eval(expr, env);
+        const size_t n_allocs = alloc_counter::stop();
+
+        EXPECT_EQ(n_allocs, 0u) << input;
+        EXPECT_EQ(obj->inspect(), expected) << input;
+    }
+}
+
+TEST(EvaluatorTest, TestFunctionKeepsArenaAlive) {
+    EnvPtr env = makeRef<Env>();
+    Value func;
+
+    {
+        Lexer lexer("func(x) { x * 2 }");
+        Parser parser(lexer);
+        func = evaluator::eval(parser.parseProgram(), env);
+    }
+
+    EXPECT_EQ(func->getBody()->toString(), "(x * 2)");
+    EXPECT_EQ(evaluator::applyFunction(func, {Value(21)})->getIntVal(), 42);
+}
+
+TEST(EvaluatorTest, TestTailCalls) {
+    const std::vector<BuiltinTest<int>> tests = {
+        {"let loop = func(n, acc) { if (n == 0) { acc } else { loop(n - 1, acc + 2) } }; loop(100000, 0)", 200000},
+        {"let loop = func(n) { if (n == 0) { return 7; }; return loop(n - 1); }; loop(100000)", 7},
+        {"let even = func(n) { if (n == 0) { true } else { odd(n - 1) } }; let odd = func(n) { if (n == 0) { false } else { even(n - 1) } }; if (even(100001)) { 1 } else { 0 }", 0},
+        {"let loop = func(n) { let m = n - 1; if (m < 0) { 3 } else { loop(m) } }; loop(100000)", 3},
+        // Closures made during the loop keep the env of their own iteration
+        {"let f = func(n, g) { if (n == 0) { g() } else { f(n - 1, func() { n }) } }; f(10, func() { 0 })", 1},
+        {"let f = func(n, acc) { if (n == 0) { acc() } else { let m = n; f(n - 1, func() { m + 100 }) } }; f(5, func() { 0 })", 101},
+        {"let f = func(n) { if (n == 0) { len([1, 2]) } else { f(n - 1) } }; f(10)", 2}
+    };
+
+    for (const auto& test : tests) {
+        EnvPtr env = makeRef<Env>();
+        Lexer lexer(test.input);
+        Parser parser(lexer);
+        auto obj = evaluator::eval(parser.parseProgram(), env);
+
+        EXPECT_EQ(obj->getIntVal(), test.expected) << test.input;
+        EXPECT_EQ(obj->getType(), OBJ_INT) << test.input;
+    }
+}
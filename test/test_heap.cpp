@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include "../src/parser.h"
+#include "../src/evaluator.h"
+
+static Value evalInput(const std::string& input, EnvPtr env) {
+    Lexer lexer(input);
+    Parser parser(lexer);
+
+    return evaluator::eval(parser.parseProgram(), env);
+}
+
+TEST(HeapTest, TestCollectFunctionEnvCycle) {
+    gc::collect();
+    const size_t n_before = gc::tracked();
+
+    {
+        // f is stored in the env it closes over
+        EnvPtr env = makeRef<Env>();
+        evalInput("let f = func(n) { if (n == 0) { 0 } else { f(n - 1) } }; f(3)", env);
+        EXPECT_GT(gc::tracked(), n_before);
+    }
+
+    EXPECT_GT(gc::collect(), 0u);
+    EXPECT_EQ(gc::tracked(), n_before);
+}
+
+TEST(HeapTest, TestCollectArraysSharingNodes) {
+    gc::collect();
+    const size_t n_before = gc::tracked();
+
+    {
+        // Both arrays share the nodes holding f, whose env holds both
+        EnvPtr env = makeRef<Env>();
+        evalInput("let f = func() { [a, b] }; let build = func(arr, n) { if (n == 0) { arr } else { build(push(arr, f), n - 1) } }; let a = build([], 100); let b = push(a, 1);", env);
+        EXPECT_EQ(evalInput("len(b)", env)->getIntVal(), 101);
+    }
+
+    EXPECT_GT(gc::collect(), 0u);
+    EXPECT_EQ(gc::tracked(), n_before);
+}
+
+TEST(HeapTest, TestCollectKeepsReachableCells) {
+    EnvPtr env = makeRef<Env>();
+    evalInput("let newAdder = func(x) { func(y) { x + y } }; let addTwo = newAdder(2); let arr = [addTwo, \"str\"];", env);
+
+    gc::collect();
+
+    EXPECT_EQ(evalInput("addTwo(3)", env)->getIntVal(), 5);
+    EXPECT_EQ(evalInput("arr[0](8)", env)->getIntVal(), 10);
+    EXPECT_EQ(evalInput("arr[1]", env)->getStrVal(), "str");
+}
+
+TEST(HeapTest, TestCollectKeepsValuesOutsideHeap) {
+    Value func;
+
+    {
+        EnvPtr env = makeRef<Env>();
+        func = evalInput("let newAdder = func(x) { func(y) { x + y } }; newAdder(4)", env);
+    }
+
+    gc::collect();
+
+    EXPECT_EQ(evaluator::applyFunction(func, {Value(1)})->getIntVal(), 5);
+}
+
+TEST(HeapTest, TestThresholdTriggersCollection) {
+    const size_t old_threshold = gc::threshold();
+    gc::setThreshold(64);
+
+    EnvPtr env = makeRef<Env>();
+    evalInput("let leak = func() { let g = func() { g }; 0 }; let loop = func(n) { leak(); if (n == 0) { 0 } else { loop(n - 1) } };", env);
+    gc::collect();
+    const size_t n_before = gc::tracked();
+
+    // Every call to leak leaves a g <-> env cycle behind
+    evalInput("loop(500)", env);
+    EXPECT_LT(gc::tracked(), n_before + 100);
+
+    gc::setThreshold(old_threshold);
+}
+
+TEST(HeapTest, TestImmortalCells) {
+    const size_t n_before = gc::tracked();
+    Value str = makeObject<String>("forever");
+    Object* obj = str.asObject();
+
+    gc::makeImmortal(obj);
+    EXPECT_EQ(gc::tracked(), n_before);
+
+    {
+        Value copy = str;
+        EXPECT_EQ(copy.asObject(), obj);
+    }
+
+    str = nullptr;
+    gc::collect();
+
+    // Still alive with nothing pointing to it
+    EXPECT_EQ(Value(obj)->getStrVal(), "forever");
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include "../src/parser.h"
+#include "../src/evaluator.h"
+#include "../src/jit.h"
+#include "../src/thunk.h"
+
+static Value runWithThreshold(const std::string& input, size_t threshold, bool use_thunks = false) {
+    EnvPtr env = makeRef<Env>();
+    Lexer lexer(input);
+    Parser parser(lexer);
+    auto program = parser.parseProgram();
+
+    jit::setThreshold(threshold);
+    auto result = use_thunks ? thunk::eval(program, env) : evaluator::eval(program, env);
+    jit::setThreshold(DEFAULT_JIT_THRESHOLD);
+
+    return result;
+}
+
+// Function bound to name after running input
+static Value functionAfter(const std::string& input, const std::string& name, EnvPtr env) {
+    Lexer lexer(input);
+    Parser parser(lexer);
+    evaluator::eval(parser.parseProgram(), env);
+
+    return env->get(name);
+}
+
+TEST(JitTest, TestSameResultsAsInterpreter) {
+    const std::vector<std::string> tests = {
+        "let fib = func(n) { if (n < 2) { n } else { fib(n-1) + fib(n-2) } }; fib(20)",
+        "let min = func(a, b) { if (a < b) { a } else { b } }; [min(5, 1), min(-3, 7), min(2, 2)]",
+        "let score = func(a, b, c) { a * 3 - b / 2 + -c }; [score(7, 9, 2), score(-7, 9, 0), score(0, 0, 0)]",
+        "let f = func(x) { if (x > 10) { return x * 2; } x - 1 }; [f(11), f(3), f(10)]",
+        "let f = func(x) { if (x == 0) { return true; } x < 0 }; [f(0), f(-1), f(1)]",
+        "let f = func(x) { !(x > 1) == !true }; [f(0), f(2)]",
+        "let f = func(x) { !x }; [f(0), f(1)]",
+        "let f = func(x) { (x == true) != (x != false) }; [f(0), f(1), f(-5)]",
+        "let f = func(x) { if (x) { 1 } else { 2 } }; [f(0), f(3)]",
+        "let f = func(x) { 2147483647 + x }; [f(1), f(-1)]",
+        "let f = func(x) { x * 65536 * 65536 + x }; f(3)",
+        "let f = func(x) { -7 / x }; [f(2), f(-2), f(7)]",
+        "let f = func(x) { 7 / x }; [f(1), f(0)]",
+        "let f = func(x) { x / 2 + x / -3 }; [f(7), f(-2147483647 - 1)]",
+        "let loop = func(n, acc) { if (n == 0) { acc } else { loop(n - 1, acc + n) } }; loop(100000, 0)",
+        "let count = func(n) { if (n == 0) { 0 } else { 1 + count(n - 1) } }; count(200)",
+        "let even = func(n) { if (n == 0) { true } else { if (n == 1) { false } else { even(n - 2) } } }; [even(10), even(7)]",
+        "let f = func(x) { if (x > 0) { f(x - 1); 7 } else { 0 } }; [f(0), f(3)]",
+        "let f = func(x) { if (x > 0) { true } else { 1 } }; [f(1), f(0)]",
+        "let f = func(x) { if (x > 0) { x } }; [f(1), f(0)]",
+        "let f = func(x) { x * 2 }; [f(1), f(2.5), f(true), f(\"a\")]",
+        "let f = func(x, y) { x + y }; [f(1, 2), f(1)]",
+        "let g = func(x) { x + 1 }; let f = func(x) { g(x) * 2 }; f(4)",
+        "let f = func(x) { let y = x + 1; y * 2 }; f(4)",
+        "let f = func(x) { 1 + if (x > 0) { return 5; } else { 2 } }; [f(1), f(0)]",
+        "let f = func(n) { if (n == 0) { 0 } else { f(n - 1) } }; let g = f; let f = func(n) { 42 }; g(5)"
+    };
+
+    for (const auto& test : tests) {
+        auto expected = runWithThreshold(test, 0);
+
+        for (const bool use_thunks : {false, true}) {
+            auto obj = runWithThreshold(test, 1, use_thunks);
+            EXPECT_EQ(obj->inspect(), expected->inspect()) << test;
+            EXPECT_EQ(obj->typeString(), expected->typeString()) << test;
+        }
+    }
+}
+
+// Self tail calls of compiled code jump back to the start of the body, so
+// they keep running long after the function got hot
+TEST(JitTest, TestTailCalls) {
+    const std::vector<std::pair<std::string, std::string>> tests = {
+        {"let loop = func(n, acc) { if (n == 0) { acc } else { loop(n - 1, acc + 1) } }; loop(1000000, 0)", "1000000"},
+        {"let loop = func(n) { if (n > 0) { return loop(n - 1); } n == 0 }; loop(1000000)", "true"}
+    };
+
+    for (const auto& [input, expected] : tests) {
+        for (const bool use_thunks : {false, true}) {
+            EXPECT_EQ(runWithThreshold(input, DEFAULT_JIT_THRESHOLD, use_thunks)->inspect(), expected) << input;
+            EXPECT_EQ(runWithThreshold(input, 1, use_thunks)->inspect(), expected) << input;
+        }
+    }
+}
+
+TEST(JitTest, TestCompiledFunctions) {
+    const std::vector<std::pair<std::string, bool>> tests = {
+        {"let f = func(n) { if (n < 2) { n } else { f(n-1) + f(n-2) } }", true},
+        {"let f = func(a, b) { if (a < b) { a } else { b } }", true},
+        {"let f = func(x) { x > 0 }", true},
+        {"let f = func(n, acc) { if (n == 0) { acc } else { f(n - 1, acc + n) } }", true},
+        {"let f = func(x) { x / 3 }", true},
+        {"let f = func(x) { 3 / x }", false},
+        {"let f = func(x) { x / 0 }", false},
+        {"let f = func(x) { x / -1 }", false},
+        {"let f = func(x) { x + 0.5 }", false},
+        {"let f = func(x) { let y = x; y }", false},
+        {"let f = func(x) { len(x) }", false},
+        {"let f = func(x) { if (x > 0) { x } }", false},
+        {"let f = func(x) { if (x > 0) { true } else { 1 } }", false},
+        {"let f = func(x) { f(x, 1) }", false},
+        {"let f = func(x) { \"a\" }", false}
+    };
+
+    for (const auto& [input, expected] : tests) {
+        EnvPtr env = makeRef<Env>();
+        auto func = functionAfter(input, "f", env);
+
+        ASSERT_EQ(func->getType(), OBJ_FUNC) << input;
+#if defined(__x86_64__) && defined(__linux__)
+        EXPECT_EQ(jit::compile(*func.as<Function>()) != nullptr, expected) << input;
+#endif
+    }
+}
+
+TEST(JitTest, TestGuards) {
+    EnvPtr env = makeRef<Env>();
+    auto func = functionAfter("let f = func(n) { if (n < 1) { 0 } else { 1 + f(n - 1) } }", "f", env);
+    auto function = func.as<Function>();
+    Value result = nullptr;
+
+    jit::setThreshold(2);
+
+    EXPECT_FALSE(jit::tryCall(function, {Value(3)}, result));
+    const bool is_jitted = jit::tryCall(function, {Value(3)}, result);
+    EXPECT_EQ(is_jitted, function->jit != nullptr);
+    if (is_jitted) {
+        EXPECT_EQ(result->inspect(), "3");
+
+        // Arguments that aren't ints, or a name no longer bound to it
+        EXPECT_FALSE(jit::tryCall(function, {Value(2.5)}, result));
+        EXPECT_FALSE(jit::tryCall(function, {Value(1), Value(2)}, result));
+        env->set("f", Value(1));
+        EXPECT_FALSE(jit::tryCall(function, {Value(3)}, result));
+        env->set("f", func);
+        EXPECT_TRUE(jit::tryCall(function, {Value(4)}, result));
+        EXPECT_EQ(result->inspect(), "4");
+    }
+
+    jit::setThreshold(0);
+    EXPECT_FALSE(jit::tryCall(function, {Value(3)}, result));
+
+    jit::setThreshold(DEFAULT_JIT_THRESHOLD);
+}
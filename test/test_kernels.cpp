@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "../src/kernels.h"
+
+TEST(KernelsTest, TestMatchScalarLoops) {
+    // Every length up to a few vectors wide, so the tails get covered too
+    for (size_t n = 1; n < 40; n++) {
+        std::vector<int32_t> ints;
+        std::vector<double> floats;
+
+        for (size_t i = 0; i < n; i++) {
+            ints.push_back(static_cast<int32_t>(i * 37 % 23) - 11);
+            floats.push_back(static_cast<double>(i * 13 % 17) * 0.5 - 4);
+        }
+
+        int64_t int_sum = 0;
+        double float_sum = 0;
+        uint32_t int_dot = 0;
+        double float_dot = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            int_sum += ints[i];
+            float_sum += floats[i];
+            int_dot += static_cast<uint32_t>(ints[i]) * static_cast<uint32_t>(ints[i]);
+            float_dot += floats[i] * floats[i];
+        }
+
+        EXPECT_EQ(kernels::sumInts(ints.data(), n), int_sum) << n;
+        EXPECT_DOUBLE_EQ(kernels::sumFloats(floats.data(), n), float_sum) << n;
+        EXPECT_EQ(kernels::minInts(ints.data(), n), *std::min_element(ints.begin(), ints.end())) << n;
+        EXPECT_EQ(kernels::maxInts(ints.data(), n), *std::max_element(ints.begin(), ints.end())) << n;
+        EXPECT_EQ(kernels::minFloats(floats.data(), n), *std::min_element(floats.begin(), floats.end())) << n;
+        EXPECT_EQ(kernels::maxFloats(floats.data(), n), *std::max_element(floats.begin(), floats.end())) << n;
+        EXPECT_EQ(kernels::dotInts(ints.data(), ints.data(), n), static_cast<int32_t>(int_dot)) << n;
+        EXPECT_DOUBLE_EQ(kernels::dotFloats(floats.data(), floats.data(), n), float_dot) << n;
+    }
+}
+
+TEST(KernelsTest, TestElementwise) {
+    for (size_t n = 1; n < 40; n++) {
+        std::vector<int32_t> a, b, ints(n);
+        std::vector<double> x, y, floats(n);
+        bool bools[40];
+
+        for (size_t i = 0; i < n; i++) {
+            a.push_back(static_cast<int32_t>(i * 37 % 23) - 11);
+            b.push_back(i % 3 == 0 ? 2147483647 : static_cast<int32_t>(i % 5) - 2);
+            x.push_back(static_cast<double>(a[i]) * 0.5);
+            y.push_back(static_cast<double>(i % 5) - 2.5);
+        }
+
+        kernels::mapInts(KERNEL_ADD, a.data(), b.data(), ints.data(), n);
+        for (size_t i = 0; i < n; i++)
+            ASSERT_EQ(ints[i], static_cast<int32_t>(static_cast<uint32_t>(a[i]) + static_cast<uint32_t>(b[i]))) << n;
+
+        kernels::mapInts(KERNEL_MUL, a.data(), b.data(), ints.data(), n);
+        for (size_t i = 0; i < n; i++)
+            ASSERT_EQ(ints[i], static_cast<int32_t>(static_cast<uint32_t>(a[i]) * static_cast<uint32_t>(b[i]))) << n;
+
+        kernels::mapFloats(KERNEL_DIV, x.data(), y.data(), floats.data(), n);
+        for (size_t i = 0; i < n; i++)
+            ASSERT_EQ(floats[i], x[i] / y[i]) << n;
+
+        kernels::compareInts(KERNEL_LT, a.data(), b.data(), bools, n);
+        for (size_t i = 0; i < n; i++)
+            ASSERT_EQ(bools[i], a[i] < b[i]) << n;
+
+        kernels::compareFloats(KERNEL_NOT_EQ, x.data(), y.data(), bools, n);
+        for (size_t i = 0; i < n; i++)
+            ASSERT_EQ(bools[i], x[i] != y[i]) << n;
+    }
+}
+
+TEST(KernelsTest, TestEdgeValues) {
+    const std::vector<int32_t> big = {2147483647, 2147483647, 2147483647, 2147483647, 2147483647, 2147483647, 2147483647, 2147483647, 1};
+    EXPECT_EQ(kernels::sumInts(big.data(), big.size()), 8 * 2147483647LL + 1);
+    EXPECT_EQ(kernels::dotInts(big.data(), big.data(), big.size()), 9);
+
+    // A NaN is never picked over another value
+    const double nan = std::nan("");
+    const std::vector<double> floats = {3, nan, 1, 2, nan, 5, 4, nan, 0.5};
+    EXPECT_EQ(kernels::minFloats(floats.data(), floats.size()), 0.5);
+    EXPECT_EQ(kernels::maxFloats(floats.data(), floats.size()), 5);
+}
@@ -2,6 +2,7 @@
 #include <vector>
 
 #include "../src/lexer.h"
+#include "alloc_counter.h"
 
 TEST(LexerTest, TestNextToken) {
     const std::string input = "let x = 10; \"blaah\"; let y = 3.52; let foo = func(x, y) { x + y * 3/2 - 4;}; if (x > 5) return true else return false a == b a != b 2 < !z \"some string\" \"hello\" [2.1, 3] {\"a\":3}";
@@ -157,3 +158,48 @@ TEST(LexerTest, TestIgnoreCommentEndingInEOF) {
     EXPECT_EQ(tok.type, expected_tok.type);
     EXPECT_EQ(tok.literal, expected_tok.literal);
 }
+
+TEST(LexerTest, TestTokensPointIntoSource) {
+    auto source = std::make_shared<const std::string>("let some_name = \"a longer string literal\"; 12345;");
+    Lexer lexer(source);
+
+    const char* begin = source->data();
+    const char* end = begin + source->size();
+
+    for (Token tok = lexer.nextToken(); tok.type != TOK_EOF; tok = lexer.nextToken()) {
+        EXPECT_GE(tok.literal.data(), begin);
+        EXPECT_LE(tok.literal.data() + tok.literal.size(), end);
+    }
+
+    EXPECT_EQ(lexer.source(), source);
+}
+
+TEST(LexerTest, TestLookupIdent) {
+    static_assert(lookupIdent("func") == TOK_FUNC);
+    static_assert(lookupIdent("let") == TOK_LET);
+    static_assert(lookupIdent("true") == TOK_TRUE);
+    static_assert(lookupIdent("false") == TOK_FALSE);
+    static_assert(lookupIdent("if") == TOK_IF);
+    static_assert(lookupIdent("else") == TOK_ELSE);
+    static_assert(lookupIdent("return") == TOK_RETURN);
+
+    const std::vector<std::string> idents = {"f", "fun", "funcs", "lets", "If", "tru", "elsa", "returns", "x", ""};
+
+    for (const auto& ident : idents)
+        EXPECT_EQ(lookupIdent(ident), TOK_IDENT) << ident;
+}
+
+TEST(LexerTest, TestIdentifiersDoNotAllocate) {
+    std::string input;
+    for (int i = 0; i < 100; i++)
+        input += "let a_rather_long_identifier = func(if_not_keyword, return_value) { if (x) { true } else { false } };";
+
+    Lexer lexer(input);
+
+    alloc_counter::start();
+    while (lexer.nextToken().type != TOK_EOF) {
+    }
+    const size_t n_allocs = alloc_counter::stop();
+
+    EXPECT_EQ(n_allocs, 0u);
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include "../src/parser.h"
+#include "../src/evaluator.h"
+#include "../src/machine.h"
+
+static Value runMachine(const std::string& input, size_t max_depth = DEFAULT_MAX_DEPTH) {
+    EnvPtr env = makeRef<Env>();
+    Lexer lexer(input);
+    Parser parser(lexer);
+    Machine machine(max_depth);
+
+    return machine.run(parser.parseProgram(), env);
+}
+
+static Value runRecursive(const std::string& input) {
+    EnvPtr env = makeRef<Env>();
+    Lexer lexer(input);
+    Parser parser(lexer);
+
+    return evaluator::eval(parser.parseProgram(), env);
+}
+
+TEST(MachineTest, TestSameResultsAsEvaluator) {
+    const std::vector<std::string> tests = {
+        "", "5", "-99", "5 + 5 + 3 + 5 - 10", "(5 + 10 * 2 + 15 / 3) * 2 + -10", "20 + 2 * -10.25",
+        "\"How are\" + \" you?\"", "(11 < 55) == true", "11.0 != 11.2", "!!7",
+        "if (true) { 1 }", "if (3 > 5) { 10 } else { 30 }", "if (false) { 10 }", "if (true) { }", "if (zz) { 1 }",
+        "return 88; 2;", "5; return 7 * 7; 3;", "if (9 > 3) { if (8 > 2) { return 10; } return 2; }",
+        "-true", "5; true + false; 5", "if (10 > 1) { if (10 > 1) { return true + false; } return 1; }",
+        "some_var", "-some_var", "some_var + 1", "1 + some_var", "\"first str\" - \"second str\"", "1 / 0", "(-2147483647 - 1) / -1",
+        "let x = 12; let y = x; let z = x + y + 1; z;", "let x = 5", "let x = zz; 1", "let x = 5; let x = x + 1; x",
+        "func(a) { a + 21; };", "let echo = func(x) { x; }; echo(7);", "func() { }()", "func() { let a = 1; }()",
+        "let add = func(a, b) { a + b; }; add(5 + 4, add(1, 2));",
+        "let fib = func(n) { if (n < 2) { n } else { fib(n-1) + fib(n-2) } }; fib(15)",
+        "let callTwice = func(x, f) { f(f(x)) }; let addTwo = func(x) { return x + 2 }; callTwice(1, addTwo)",
+        "let newAdder = func(x) { func(y) { x + y }; }; let addTwo = newAdder(2); addTwo(2);",
+        "let f = func(a) { let g = func(b) { func(c) { a + b + c } }; g(2) }; f(1)(3)",
+        "let foo = func(x) { return 2*x; }; foo();", "let foo = func(x) { return 2*x; }; foo(4, 5);",
+        "let f = func(a, b) { a }; f(1, zz)", "let f = func(a, b) { a }; f(zz, 1)", "zz(1)", "5(1)",
+        "let f = func(x) { x + nope }; f(1) + 2",
+        "let loop = func(n, acc) { if (n == 0) { acc } else { loop(n - 1, acc + n) } }; loop(100, 0)",
+        "let loop = func(n) { if (n == 0) { return zz; } loop(n - 1) }; loop(5)",
+        "let loop = func(n) { if (n == 0) { 0 } else { loop(n - 1, 1) } }; loop(5)",
+        "[1, 2*3, 4.25+0.25, false, \"a some_str\"]", "[]", "[1, zz, 3]", "[zz, 3]",
+        "[12, 7, -5][2]", "[1, 2, 5][3]", "zz[1]", "[1][zz]", "let arr = [1, [2, 3, 4], 5]; arr[1][2]", "\"hello\"[2]",
+        "let str = \"two\"; {\"one\": 10 - 9, str: 1+1, \"thr\" + \"ee\": 9/3, 4: 4, true: 5, false: 6}",
+        "{\"foo\": 5}[\"foo\"]", "{}", "{zz: 1}", "{1: zz}", "{[1]: 2}", "{\"key\": \"hello\"}[func(x){ x+1 }]",
+        "len(\"test\")", "len([])", "let a = [2*2, \"hello\", true, [4, 5]]; push(a, 9)", "len(4)", "len",
+        "let build = func(arr, n) { if (n == 0) { arr } else { build(push(arr, n), n - 1) } }; build([], 40)",
+        "let f = func(x) { let y = push(x, 2); [x, y] }; f([1])",
+        "[1, 2, 3] * [2, 0.5, 1] - 1", "[\"a\"] + \"b\"", "[1, 2] / [1, 0]"
+    };
+
+    for (const auto& test : tests) {
+        auto expected = runRecursive(test);
+        auto obj = runMachine(test);
+
+        if (!expected) {
+            EXPECT_TRUE(obj == nullptr) << test;
+            continue;
+        }
+
+        ASSERT_TRUE(obj != nullptr) << test;
+        EXPECT_EQ(obj->inspect(), expected->inspect()) << test;
+        EXPECT_EQ(obj->typeString(), expected->typeString()) << test;
+    }
+}
+
+TEST(MachineTest, TestDeepRecursion) {
+    const std::string count = "let count = func(n) { if (n == 0) { 0 } else { 1 + count(n - 1) } }; ";
+
+    auto obj = runMachine(count + "count(200000)");
+    EXPECT_EQ(obj->getType(), OBJ_INT);
+    EXPECT_EQ(obj->getIntVal(), 200000);
+
+    obj = runMachine(count + "count(100)", 100);
+    EXPECT_EQ(obj->inspect(), "Error: maximum call depth exceeded: 100");
+
+    obj = runMachine(count + "count(99)", 100);
+    EXPECT_EQ(obj->getIntVal(), 99);
+
+    // Tail calls don't add to the depth
+    obj = runMachine("let loop = func(n) { if (n == 0) { 0 } else { loop(n - 1) } }; loop(1000)", 10);
+    EXPECT_EQ(obj->getIntVal(), 0);
+}
+
+TEST(MachineTest, TestMachineReuse) {
+    EnvPtr env = makeRef<Env>();
+    Machine machine(50);
+
+    for (const auto& [input, expected] : std::vector<std::pair<std::string, std::string>>{
+        {"let f = func(n) { if (n == 0) { 0 } else { 1 + f(n - 1) } }", "nil"},
+        {"f(60)", "Error: maximum call depth exceeded: 50"},
+        {"f(40)", "40"}
+    }) {
+        Lexer lexer(input);
+        Parser parser(lexer);
+
+        EXPECT_EQ(machine.run(parser.parseProgram(), env)->inspect(), expected) << input;
+    }
+}
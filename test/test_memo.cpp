@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+
+#include "../src/parser.h"
+#include "../src/evaluator.h"
+#include "../src/builtin.h"
+#include "../src/machine.h"
+#include "../src/purity.h"
+#include "../src/thunk.h"
+#include "../src/vm.h"
+
+static std::shared_ptr<Program> parse(const std::string& input) {
+    Lexer lexer(input);
+    Parser parser(lexer);
+
+    return parser.parseProgram();
+}
+
+TEST(MemoTest, TestPurity) {
+    const std::vector<std::pair<std::string, std::string>> tests = {
+        {"func(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }", ""},
+        {"func(arr) { len(arr) + sum(arr) }", ""},
+        {"func(x) { let sq = func(y) { y * y }; sq(x) + 1 }", ""},
+        {"func(x) { let add = func(a) { func(b) { a + b } }; add(x) }", ""},
+        {"func(x) { double(x) }", ""},
+        {"func(x) { print(x) }", "uses impure builtin 'print'"},
+        {"func(x) { let f = func() { print(x) }; 1 }", "uses impure builtin 'print'"},
+        {"func(x) { k * x }", "captures 'k'"},
+        {"func(f, x) { f(x) }", "calls 'f', which it can't check"},
+        {"func(x) { let g = x; g(1) }", "calls 'g', which it can't check"},
+        {"func(x) { [double][0](x) }", "calls a function value it can't check"},
+        {"func(x) { noisy(x) }", "uses 'noisy', which uses impure builtin 'print'"},
+        {"func(x) { memostats(x) }", "uses impure builtin 'memostats'"}
+    };
+
+    EnvPtr env = makeRef<Env>();
+    evaluator::eval(parse("let k = 3; let double = func(x) { x * 2 }; let noisy = func(x) { print(x) }"), env);
+
+    for (const auto& [input, expected] : tests) {
+        auto func = evaluator::eval(parse(input), env);
+
+        ASSERT_EQ(func->getType(), OBJ_FUNC) << input;
+        EXPECT_EQ(purity::impurity(func), expected) << input;
+    }
+}
+
+TEST(MemoTest, TestMemoErrors) {
+    const std::vector<std::pair<std::string, std::string>> tests = {
+        {"memo()", "Error: wrong number of arguments. got=0, want=1 or 2"},
+        {"memo(5)", "Error: argument to 'memo' must be FUNC, got=INTEGER"},
+        {"memo(len)", "Error: argument to 'memo' must be FUNC, got=BUILTIN"},
+        {"memo(func(x) { x }, -1)", "Error: capacity of 'memo' must be a non-negative INT, got=-1"},
+        {"memo(func(x) { print(x) })", "Error: can't memoize impure function: it uses impure builtin 'print'"},
+        {"memostats(func(x) { x })", "Error: argument to 'memostats' must be a memoized FUNC, got=FUNC"}
+    };
+
+    for (const auto& [input, expected] : tests)
+        EXPECT_EQ(evaluator::eval(parse(input), makeRef<Env>())->inspect(), expected) << input;
+
+    Compiler compiler;
+    ASSERT_TRUE(compiler.compile(parse("memo(func(x) { x })")));
+    VM vm;
+    EXPECT_EQ(vm.run(compiler.bytecode())->inspect(), "Error: memo isn't supported by the bytecode VM");
+}
+
+// Names the purity check relied on, bound again after memo
+TEST(MemoTest, TestRebinding) {
+    const std::vector<std::pair<std::string, std::string>> tests = {
+        {"let f = memo(func(n) { n + k }); let k = 5; let a = f(1); let k = 10; [a, f(1)]", "[6, 11]"},
+        {"let g = func(x) { x }; let m = memo(func(n) { g(n) }); let a = m(1); let g = func(x) { x * 100 }; [a, m(1)]", "[1, 100]"},
+        {"let h = func(x) { g(x) }; let g = func(x) { x }; let m = memo(func(n) { h(n) }); let a = m(2); "
+         "let g = func(x) { x * 3 }; [a, m(2)]", "[2, 6]"},
+        {"let m = memo(func(n) { len(n) }); let a = m(\"ab\"); let len = func(x) { 0 }; [a, m(\"ab\")]", "[2, 0]"},
+        {"let fib = memo(func(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }); let a = fib(10); "
+         "let slow = fib; let fib = func(n) { 0 }; [a, slow(10)]", "[55, 0]"}
+    };
+
+    for (const auto& [input, expected] : tests) {
+        EXPECT_EQ(evaluator::eval(parse(input), makeRef<Env>())->inspect(), expected) << input;
+        EXPECT_EQ(thunk::eval(parse(input), makeRef<Env>())->inspect(), expected) << input;
+
+        Machine machine;
+        EXPECT_EQ(machine.run(parse(input), makeRef<Env>())->inspect(), expected) << input;
+    }
+
+    // The table is used again only while the names hold what they did
+    EnvPtr env = makeRef<Env>();
+    evaluator::eval(parse("let g = func(x) { x }; let m = memo(func(n) { g(n) }); m(1); m(1); let g = func(x) { x * 2 }; m(1)"), env);
+    auto stats = evaluator::eval(parse("let s = memostats(m); [s[\"hits\"], s[\"misses\"]]"), env);
+    EXPECT_EQ(stats->inspect(), "[1, 2]");
+}
+
+TEST(MemoTest, TestSameResults) {
+    const std::vector<std::string> tests = {
+        "let fib = memo(func(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }); fib(40)",
+        "let f = memo(func(a, b) { a * 10 + b }); [f(1, 2), f(2, 1), f(1, 2), f(\"a\", \"b\"), f(true, 1)]",
+        "let f = memo(func(arr) { len(arr) }); [f([1, 2]), f([1, 2, 3])]",
+        "let f = memo(func(x) { x + 1 }); [f(1), f(1, 2), f(1.5), f(\"a\")]",
+        "let f = memo(func(x) { if (x > 0) { return x; } 0 }); [f(5), f(5), f(-1)]",
+        "let f = memo(func(x) { x }, 0); [f(1), f(1)]",
+        "let f = memo(func(x) { x * 2 }); type(f)"
+    };
+
+    for (const auto& test : tests) {
+        auto expected = evaluator::eval(parse(test), makeRef<Env>());
+
+        EXPECT_EQ(thunk::eval(parse(test), makeRef<Env>())->inspect(), expected->inspect()) << test;
+
+        Machine machine;
+        EXPECT_EQ(machine.run(parse(test), makeRef<Env>())->inspect(), expected->inspect()) << test;
+    }
+
+    EXPECT_EQ(evaluator::eval(parse(tests[0]), makeRef<Env>())->inspect(), "102334155");
+}
+
+TEST(MemoTest, TestCounters) {
+    EnvPtr env = makeRef<Env>();
+
+    evaluator::eval(parse("let fib = memo(func(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }); fib(30)"), env);
+
+    // Each n misses once, and fib(n - 2) then hits for every n from 3 up
+    auto stats = evaluator::eval(parse("let s = memostats(fib); [s[\"hits\"], s[\"misses\"], s[\"size\"], s[\"capacity\"]]"), env);
+    EXPECT_EQ(stats->inspect(), "[28, 31, 31, 4096]");
+
+    // Args that can't be keys, and errors, aren't kept
+    evaluator::eval(parse("fib(30); len([fib([1])]); fib(\"x\")"), env);
+    stats = evaluator::eval(parse("let s = memostats(fib); [s[\"hits\"], s[\"misses\"], s[\"size\"]]"), env);
+    EXPECT_EQ(stats->inspect(), "[29, 33, 31]");
+}
+
+TEST(MemoTest, TestLeastRecentlyUsed) {
+    EnvPtr env = makeRef<Env>();
+
+    evaluator::eval(parse("let f = memo(func(x) { x * x }, 2); f(1); f(2); f(1); f(3)"), env);
+
+    // f(2) was used least recently, so f(3) took its place
+    evaluator::eval(parse("f(1); f(3); f(2)"), env);
+    auto stats = evaluator::eval(parse("let s = memostats(f); [s[\"hits\"], s[\"misses\"], s[\"size\"]]"), env);
+    EXPECT_EQ(stats->inspect(), "[3, 4, 2]");
+}
@@ -12,3 +12,154 @@ TEST(ObjectTest, TestHashKeys) {
     EXPECT_EQ(str3->hashKey().value, str4->hashKey().value);
     EXPECT_NE(str1->hashKey().value, str3->hashKey().value);
 }
+
+TEST(ObjectTest, TestValueRoundTrip) {
+    EXPECT_EQ(Value(42).getIntVal(), 42);
+    EXPECT_EQ(Value(-7).getIntVal(), -7);
+    EXPECT_EQ(Value(2147483647).getIntVal(), 2147483647);
+    EXPECT_EQ(Value(3.5).getFloatVal(), 3.5);
+    EXPECT_EQ(Value(-0.25).getFloatVal(), -0.25);
+    EXPECT_TRUE(Value(true).getBoolVal());
+    EXPECT_FALSE(Value(false).getBoolVal());
+    EXPECT_FALSE(Value::nil().getBoolVal());
+
+    EXPECT_EQ(Value(1).getType(), OBJ_INT);
+    EXPECT_EQ(Value(1.0).getType(), OBJ_FLOAT);
+    EXPECT_EQ(Value(true).getType(), OBJ_BOOL);
+    EXPECT_EQ(Value::nil().getType(), OBJ_NIL);
+    EXPECT_EQ(makeObject<String>("abc").getType(), OBJ_STR);
+
+    // NaNs must not be mistaken for boxed values
+    Value nan(0.0 / 0.0);
+    EXPECT_EQ(nan.getType(), OBJ_FLOAT);
+    EXPECT_NE(nan.getFloatVal(), nan.getFloatVal());
+
+    EXPECT_TRUE(Value().isEmpty());
+    EXPECT_FALSE(Value::nil().isEmpty());
+
+    EXPECT_EQ(Value(5).hashKey(), Value(5).hashKey());
+    EXPECT_EQ(Value(true).hashKey(), Value(true).hashKey());
+}
+
+TEST(ObjectTest, TestValueRefCount) {
+    auto str = new String("counted");
+
+    {
+        Value a(str);
+        EXPECT_EQ(str->refs, 1u);
+
+        Value b = a;
+        EXPECT_EQ(str->refs, 2u);
+
+        Value c = std::move(b);
+        EXPECT_EQ(str->refs, 2u);
+
+        c = Value(1);
+        EXPECT_EQ(str->refs, 1u);
+        EXPECT_EQ(a->getStrVal(), "counted");
+    }
+}
+
+TEST(ObjectTest, TestHashTable) {
+    HashTable table;
+    const Value one(1);
+    const Value yes(true);
+
+    // Same hash value, different types
+    table.set(one.hashKey(), one, Value(10));
+    table.set(yes.hashKey(), yes, Value(20));
+    EXPECT_EQ(table.size(), 2u);
+    EXPECT_EQ(table.get(one.hashKey(), one)->getIntVal(), 10);
+    EXPECT_EQ(table.get(yes.hashKey(), yes)->getIntVal(), 20);
+
+    table.set(one.hashKey(), one, Value(11));
+    EXPECT_EQ(table.size(), 2u);
+    EXPECT_EQ(table.get(one.hashKey(), one)->getIntVal(), 11);
+
+    for (int i = 0; i < 10000; i++) {
+        const Value key = makeObject<String>("key" + std::to_string(i));
+        table.set(key.hashKey(), key, Value(i));
+    }
+
+    EXPECT_EQ(table.size(), 10002u);
+
+    for (int i = 0; i < 10000; i += 7) {
+        const Value key = makeObject<String>("key" + std::to_string(i));
+        ASSERT_TRUE(table.get(key.hashKey(), key) != nullptr) << i;
+        EXPECT_EQ(table.get(key.hashKey(), key)->getIntVal(), i);
+    }
+
+    const Value missing = makeObject<String>("key10000");
+    EXPECT_EQ(table.get(missing.hashKey(), missing), nullptr);
+    EXPECT_EQ(table.get(Value(2).hashKey(), Value(2)), nullptr);
+
+    // Entries keep their insertion order
+    EXPECT_EQ(table.begin()->key.getIntVal(), 1);
+    EXPECT_EQ((table.end() - 1)->key.getStrVal(), "key9999");
+}
+
+TEST(ObjectTest, TestPersistentVector) {
+    std::vector<PersistentVector> versions = {PersistentVector()};
+
+    // Enough values for a trie three levels deep
+    for (int i = 0; i < 40000; i++)
+        versions.push_back(versions.back().push(Value(i)));
+
+    for (size_t n : {0u, 1u, 31u, 32u, 33u, 1024u, 1056u, 1057u, 32800u, 40000u}) {
+        const auto& vector = versions[n];
+        ASSERT_EQ(vector.size(), n);
+
+        for (size_t i = 0; i < n; i++)
+            ASSERT_EQ(vector[i].getIntVal(), static_cast<int>(i)) << n;
+
+        size_t i = 0;
+        for (const auto& value : vector)
+            ASSERT_EQ(value.getIntVal(), static_cast<int>(i++)) << n;
+        EXPECT_EQ(i, n);
+    }
+
+    // Appending to a copy leaves the vectors it shares nodes with alone
+    PersistentVector copy = versions[1056];
+    copy.append(Value(-1));
+    versions[1056].append(Value(-2));
+
+    EXPECT_EQ(copy.back().getIntVal(), -1);
+    EXPECT_EQ(versions[1056].back().getIntVal(), -2);
+    EXPECT_EQ(versions[1057].back().getIntVal(), 1056);
+    EXPECT_EQ(versions[40000][1056].getIntVal(), 1056);
+}
+
+TEST(ObjectTest, TestPackedVectorLeaves) {
+    const Value str = makeObject<String>("str");
+    PersistentVector vector;
+
+    // Ints, then a float and a string in the middle of packed blocks
+    for (int i = 0; i < 100; i++)
+        vector.append(Value(-i));
+    const PersistentVector ints = vector;
+
+    vector.append(Value(0.5));
+    vector.append(str);
+    for (int i = 0; i < 40; i++)
+        vector.append(Value(i * 0.25));
+    vector.append(Value(true));
+
+    ASSERT_EQ(vector.size(), 143u);
+    for (size_t i = 0; i < 100; i++) {
+        EXPECT_EQ(vector[i].getType(), OBJ_INT);
+        EXPECT_EQ(vector[i].getIntVal(), -static_cast<int>(i));
+    }
+
+    EXPECT_EQ(vector[100].getFloatVal(), 0.5);
+    EXPECT_EQ(vector[101].asObject(), str.asObject());
+    EXPECT_EQ(vector[141].getFloatVal(), 9.75);
+    EXPECT_EQ(vector[142].getType(), OBJ_BOOL);
+
+    // Unpacking the shared tail doesn't change the vector it came from
+    EXPECT_EQ(ints.size(), 100u);
+    EXPECT_EQ(ints.back().getType(), OBJ_INT);
+    EXPECT_EQ(ints.back().getIntVal(), -99);
+
+    const Value arr = makeObject<Array>(vector);
+    EXPECT_EQ(arr->getElements()[101]->inspect(), "'str'");
+}
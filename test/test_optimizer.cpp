@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+
+#include "../src/parser.h"
+#include "../src/evaluator.h"
+#include "../src/optimizer.h"
+#include "../src/resolver.h"
+#include "../src/thunk.h"
+
+static std::shared_ptr<Program> parse(const std::string& input, bool optimize) {
+    Lexer lexer(input);
+    Parser parser(lexer);
+    auto program = parser.parseProgram();
+
+    if (optimize) {
+        Optimizer optimizer;
+        optimizer.optimize(program);
+    }
+
+    return program;
+}
+
+TEST(OptimizerTest, TestFolding) {
+    const std::vector<std::pair<std::string, std::string>> tests = {
+        {"60 * 60 * 24", "86400"},
+        {"-(2 + 3)", "-5"},
+        {"!(1 < 2)", "false"},
+        {"\"prefix\" + \"-\" + \"suffix\"", "prefix-suffix"},
+        {"x * (2 + 3)", "(x * 5)"},
+        {"1 + 2 * x", "(1 + (2 * x))"},
+        {"1.5 * 2", "3.000000"},
+        {"1 / 0", "(1 / 0)"},
+        {"(-2147483647 - 1) / -1", "-2147483648"},
+        {"1 + true", "(1 + true)"},
+        {"-true", "(-true)"},
+        {"[1 + 1, f(2 * 2)][0 + 1]", "([2, f(4)][1])"},
+        {"if (1 > 2) { 3 * 3 } else { 4 - 1 }", "if false 9 else 3"}
+    };
+
+    for (const auto& [input, expected] : tests)
+        EXPECT_EQ(parse(input, true)->toString(), expected) << input;
+}
+
+TEST(OptimizerTest, TestPropagation) {
+    const std::vector<std::pair<std::string, std::string>> tests = {
+        {"let day = 60 * 60 * 24; day * 7", "let day = 86400604800"},
+        {"let a = 2; let b = a * 3; b + a", "let a = 2let b = 68"},
+        {"let a = 2; a + 1; let a = 3; a", "let a = 2(a + 1)let a = 33"},
+        {"let a = 2; if (x) { let a = 3; }; a", "let a = 2if x let a = 3a"},
+        {"let a = [1]; a", "let a = [1]a"},
+        {"let a = 2; let f = func(x) { x * a }", "let a = 2let f = func(x) (x * a)"},
+        {"let f = func(x) { let a = 2; let g = func(y) { a + y }; g(x * a) }",
+         "let f = func(x) let a = 2let g = func(y) (2 + y)g((x * 2))"},
+        {"let f = func(x) { let a = 2; let g = func() { a }; let a = 3; g() }",
+         "let f = func(x) let a = 2let g = func() alet a = 3g()"},
+        {"let f = func(a) { let g = func(a) { a }; g(a) }", "let f = func(a) let g = func(a) ag(a)"}
+    };
+
+    for (const auto& [input, expected] : tests)
+        EXPECT_EQ(parse(input, true)->toString(), expected) << input;
+}
+
+TEST(OptimizerTest, TestSameResults) {
+    const std::vector<std::string> tests = {
+        "let day = 60 * 60 * 24; day * 7",
+        "let s = \"a\" + \"b\"; let f = func(x) { s + x }; f(\"c\")",
+        "let f = func(x) { let k = 3 * 4; let g = func(y) { k + y }; g(x) }; f(1)",
+        "let f = func(x) { let k = 1; if (x) { let k = 2; }; k }; [f(true), f(false)]",
+        "let f = func(x) { let k = 1; let g = func() { k }; let k = 2; g() }; f(0)",
+        "let f = func(n) { let one = 1; if (n < one) { 0 } else { one + f(n - one) } }; f(10)",
+        "let x = 1 + true; 5",
+        "-true + 1",
+        "2147483647 + 1",
+        "let f = func(x) { 1 / 0 }; f(1)",
+        "{1 + 1: 2 * 2, \"a\" + \"b\": 3}[2]",
+        "let a = 2; let h = {a: a * a}; h[2]",
+        "let a = 5; return a * 2; 3",
+        "if (1 < 2) { 10 } else { 20 }"
+    };
+
+    for (const auto& test : tests) {
+        auto expected = evaluator::eval(parse(test, false), makeRef<Env>());
+        auto obj = evaluator::eval(parse(test, true), makeRef<Env>());
+
+        EXPECT_EQ(obj->inspect(), expected->inspect()) << test;
+        EXPECT_EQ(obj->typeString(), expected->typeString()) << test;
+    }
+}
+
+static int countInlined(const ASTNodePtr& node) {
+    if (!node)
+        return 0;
+
+    int n_inlined = node->nodeType() == NODE_INLINED_CALL ? 1 : 0;
+    for (const auto& child : childNodes(node))
+        n_inlined += countInlined(child);
+
+    return n_inlined;
+}
+
+TEST(OptimizerTest, TestInlining) {
+    const std::vector<std::pair<std::string, int>> tests = {
+        {"let add = func(a, b) { a + b }; add(1, 2)", 1},
+        {"let add = func(a, b) { a + b }; let f = func(x, y) { add(x * 2, y) }; f(1, 2)", 1},
+        {"let sq = func(x) { x * x }; sq(3)", 0},
+        {"let add = func(a, b) { b + a }; add(1, 2)", 0},
+        {"let add = func(a, b) { a + b + c }; add(1, 2)", 0},
+        {"let add = func(a, b) { let c = a; c + b }; add(1, 2)", 0},
+        {"let add = func(a, b) { a + b }; add(1, x)", 0},
+        {"let add = func(a, b) { a + b }; add(1)", 0},
+        {"let neg = func(a) { -a }; let add = func(a, b) { a + b }; add(neg(1), 2)", 2},
+        {"let one = func() { 1 }; one() + one()", 2}
+    };
+
+    for (const auto& [input, expected] : tests) {
+        auto program = parse(input, true);
+
+        EXPECT_EQ(countInlined(program.get()), expected) << input;
+        EXPECT_EQ(program->toString(), parse(input, false)->toString()) << input;
+    }
+}
+
+TEST(OptimizerTest, TestInlinedSameResults) {
+    const std::vector<std::string> tests = {
+        "let add = func(a, b) { a + b }; add(1, 2)",
+        "let add = func(a, b) { a + b }; let add = func(a, b) { a * b }; add(2, 3)",
+        "let add = func(a, b) { a + b }; add(1)",
+        "let add = func(a, b) { a + b }; add(true, 1)",
+        "let add = func(a, b) { a + b }; add(zz, 1)",
+        "let add = func(a, b) { a + b }; add(\"a\", \"b\")",
+        "let neg = func(a) { -a }; let add = func(a, b) { a + b }; add(neg(1), 2)",
+        "let neg = func(a) { -a }; let add = func(a, b) { a + b }; add(neg(true), 2)",
+        "let add = func(a, b) { a + b }; let f = func(x) { let add = 5; add(x, 1) }; f(1)",
+        "let mad = func(a, b, c) { a * b + c }; let f = func(x, y) { mad(x, y, 3) }; f(4, 5)",
+        "let add = func(a, b) { a + b }; let loop = func(n, acc) { if (n == 0) { acc } else { loop(n - 1, add(acc, n)) } }; loop(100, 0)",
+        "let add = func(a, b) { a + b }; let f = func(n) { add(n, 1) }; f(2147483647)"
+    };
+
+    for (const auto& test : tests) {
+        auto expected = evaluator::eval(parse(test, false), makeRef<Env>());
+        auto obj = evaluator::eval(parse(test, true), makeRef<Env>());
+        auto thunk_obj = thunk::eval(parse(test, true), makeRef<Env>());
+
+        EXPECT_EQ(obj->inspect(), expected->inspect()) << test;
+        EXPECT_EQ(obj->typeString(), expected->typeString()) << test;
+        EXPECT_EQ(thunk_obj->inspect(), expected->inspect()) << test;
+    }
+}
+
+TEST(OptimizerTest, TestInlinedRebinding) {
+    EnvPtr env = makeRef<Env>();
+
+    evaluator::eval(parse("let add = func(a, b) { a + b }; let f = func(x) { add(x, 1) }", true), env);
+    EXPECT_EQ(evaluator::eval(parse("f(1)", true), env)->inspect(), "2");
+
+    // A later program binds the name again
+    evaluator::eval(parse("let add = func(a, b) { a * b }", true), env);
+    EXPECT_EQ(evaluator::eval(parse("f(5)", true), env)->inspect(), "5");
+    EXPECT_EQ(thunk::eval(parse("f(6)", true), env)->inspect(), "6");
+}
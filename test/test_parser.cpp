@@ -65,14 +65,14 @@ TEST(ParserTest, TestToString) {
     const Token first_ident_tok = Token(TOK_IDENT, "test");
     const Token second_ident_tok = Token(TOK_IDENT, "x");
 
-    auto let_stmnt = std::make_shared<LetStatement>(let_tok);
+    auto program = std::make_shared<Program>();
+    auto let_stmnt = program->arena().make<LetStatement>(let_tok);
     auto first_ident_stmnt = Identifier(first_ident_tok, "test");
-    auto second_ident_stmnt = std::make_shared<Identifier>(second_ident_tok, "x");
+    auto second_ident_stmnt = program->arena().make<Identifier>(second_ident_tok, "x");
 
     let_stmnt->setName(first_ident_stmnt);
     let_stmnt->setValue((second_ident_stmnt));
 
-    auto program = std::make_shared<Program>();
     program->pushStatement((let_stmnt));
 
     EXPECT_EQ(program->toString(), expected_str);
@@ -147,11 +147,12 @@ TEST(ParserTest, TestParsingPrefixExpr) {
         std::string input;
         std::string oprtr;
         int value;
+        oprtr_type resolved;
     };
 
     const std::vector<PrefixTest> tests = {
-        {"!3", "!", 3},
-        {"-66", "-", 66}
+        {"!3", "!", 3, OPRTR_BANG},
+        {"-66", "-", 66, OPRTR_SUB}
     };
 
     for (const auto& test : tests) {
@@ -168,6 +169,7 @@ TEST(ParserTest, TestParsingPrefixExpr) {
 
         EXPECT_EQ(statement->tokenLiteral(), test.oprtr);
         EXPECT_EQ(statement->getExpr()->getRight()->getIntValue(), test.value);
+        EXPECT_EQ(statement->getExpr()->getOprtr(), test.resolved);
     }
 }
 
@@ -177,17 +179,18 @@ TEST(ParserTest, TestParsingInfixExpr) {
         int left_val;
         std::string oprtr;
         int right_val;
+        oprtr_type resolved;
     };
 
     const std::vector<InfixTest> tests = {
-        {"1 + 2", 1, "+", 2},
-        {"3 - 4", 3, "-", 4},
-        {"9 * 5", 9, "*", 5},
-        {"5 / 5", 5, "/", 5},
-        {"1 > 2", 1, ">", 2},
-        {"3 < 2", 3, "<", 2},
-        {"1 == 2", 1, "==", 2},
-        {"7 != 8", 7, "!=", 8},
+        {"1 + 2", 1, "+", 2, OPRTR_ADD},
+        {"3 - 4", 3, "-", 4, OPRTR_SUB},
+        {"9 * 5", 9, "*", 5, OPRTR_MUL},
+        {"5 / 5", 5, "/", 5, OPRTR_DIV},
+        {"1 > 2", 1, ">", 2, OPRTR_GT},
+        {"3 < 2", 3, "<", 2, OPRTR_LT},
+        {"1 == 2", 1, "==", 2, OPRTR_EQ},
+        {"7 != 8", 7, "!=", 8, OPRTR_NOT_EQ},
     };
 
     for (const auto& test : tests) {
@@ -205,6 +208,7 @@ TEST(ParserTest, TestParsingInfixExpr) {
         EXPECT_EQ(expr->getLeft()->getIntValue(), test.left_val);
         EXPECT_EQ(expr->getRight()->getIntValue(), test.right_val);
         EXPECT_EQ(expr->tokenLiteral(), test.oprtr);
+        EXPECT_EQ(expr->getOprtr(), test.resolved);
     }
 }
 
@@ -489,3 +493,18 @@ TEST(ParserTest, ParseEmptyHash) {
 
     EXPECT_EQ(pairs.size(), 0);
 }
+
+TEST(ParserTest, TestNodesLiveInProgramArena) {
+    Lexer lexer("let add = func(a, b) { a + b }; add(1, 2);");
+    Parser parser(lexer);
+    auto program = parser.parseProgram();
+
+    EXPECT_GT(program->arena().bytesUsed(), 0u);
+
+    Lexer other_lexer("1");
+    Parser other_parser(other_lexer);
+    auto other = other_parser.parseProgram();
+
+    EXPECT_NE(&program->arena(), &other->arena());
+    EXPECT_EQ(program->toString(), "let add = func(ab) (a + b)add(1, 2)");
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include "../src/parser.h"
+#include "../src/evaluator.h"
+
+template <typename T>
+struct ResolverTest {
+    std::string input;
+    T expected;
+};
+
+TEST(ResolverTest, TestLexicalAddresses) {
+    const std::string input = "let f = func(a, b) { let c = a + b; func(d) { c + d + e } }";
+    Lexer lexer(input);
+    Parser parser(lexer);
+    auto program = parser.parseProgram();
+
+    auto outer = program->getStatementAt(0)->getExpr();
+    EXPECT_EQ(outer->getSlotCount(), 3);
+    EXPECT_EQ(program->getStatementAt(0)->getSlot(), -1);
+
+    auto let_c = outer->getBody()->getStatementAt(0);
+    EXPECT_EQ(let_c->getSlot(), 2);
+    EXPECT_EQ(let_c->getExpr()->getLeft()->getDepth(), 0);
+    EXPECT_EQ(let_c->getExpr()->getLeft()->getSlot(), 0);
+    EXPECT_EQ(let_c->getExpr()->getRight()->getDepth(), 0);
+    EXPECT_EQ(let_c->getExpr()->getRight()->getSlot(), 1);
+
+    auto inner = outer->getBody()->getStatementAt(1)->getExpr();
+    EXPECT_EQ(inner->getSlotCount(), 1);
+
+    // ((c + d) + e)
+    auto sum = inner->getBody()->getStatementAt(0)->getExpr();
+    auto c = sum->getLeft()->getLeft();
+    auto d = sum->getLeft()->getRight();
+    auto e = sum->getRight();
+
+    EXPECT_EQ(c->getDepth(), 1);
+    EXPECT_EQ(c->getSlot(), 2);
+    EXPECT_EQ(d->getDepth(), 0);
+    EXPECT_EQ(d->getSlot(), 0);
+    EXPECT_EQ(e->getDepth(), -1);
+    EXPECT_EQ(e->getSlot(), -1);
+}
+
+TEST(ResolverTest, TestResolvedScoping) {
+    const std::vector<ResolverTest<int>> tests = {
+        {"let f = func() { let g = func() { h() }; let h = func() { 5 }; g() }; f()", 5},
+        {"let x = 10; let f = func(c) { if (c) { let x = 1; }; x }; f(false)", 10},
+        {"let x = 10; let f = func(c) { if (c) { let x = 1; }; x }; f(true)", 1},
+        {"let x = 3; let f = func() { let y = x; let x = 4; y + x }; f()", 7},
+        {"let f = func(x) { let x = x + 1; x }; f(1)", 2},
+        {"let f = func() { let count = func(n) { if (n == 0) { 0 } else { 1 + count(n - 1) } }; count(5) }; f()", 5},
+        {"let f = func(len) { len }; f(2)", 2},
+        {"let f = func() { len(\"abc\") }; f()", 3}
+    };
+
+    for (const auto& test : tests) {
+        EnvPtr env = makeRef<Env>();
+        Lexer lexer(test.input);
+        Parser parser(lexer);
+        auto obj = evaluator::eval(parser.parseProgram(), env);
+
+        EXPECT_EQ(obj->getIntVal(), test.expected) << test.input;
+        EXPECT_EQ(obj->getType(), OBJ_INT) << test.input;
+    }
+}
+
+TEST(ResolverTest, TestTailCalls) {
+    const std::string input = "let f = func(n) { if (n > 0) { return g(n) + 1; }; let x = h(n); if (n) { f(n) } else { g(h(n)) } }; f(1)";
+    Lexer lexer(input);
+    Parser parser(lexer);
+    auto program = parser.parseProgram();
+
+    auto body = program->getStatementAt(0)->getExpr()->getBody();
+
+    // return g(n) + 1
+    auto early_return = body->getStatementAt(0)->getExpr()->getConsequence()->getStatementAt(0)->getExpr();
+    EXPECT_FALSE(early_return->getLeft()->isTailCall());
+
+    // let x = h(n)
+    EXPECT_FALSE(body->getStatementAt(1)->getExpr()->isTailCall());
+
+    // if (n) { f(n) } else { g(h(n)) }
+    auto last_if = body->getStatementAt(2)->getExpr();
+    EXPECT_TRUE(last_if->getConsequence()->getStatementAt(0)->getExpr()->isTailCall());
+
+    auto g_call = last_if->getAlternative()->getStatementAt(0)->getExpr();
+    EXPECT_TRUE(g_call->isTailCall());
+    EXPECT_FALSE(g_call->getArgAt(0)->isTailCall());
+
+    // Top level calls are never tail calls
+    EXPECT_FALSE(program->getStatementAt(1)->getExpr()->isTailCall());
+}
+
+TEST(ResolverTest, TestLastUses) {
+    const std::string input = "let f = func(a, b, c) { let d = a + b; let g = func() { c }; if (d) { return b; }; let a = push(a, d); a }";
+    Lexer lexer(input);
+    Parser parser(lexer);
+    auto program = parser.parseProgram();
+
+    auto body = program->getStatementAt(0)->getExpr()->getBody();
+
+    // let d = a + b, both are read again later
+    auto sum = body->getStatementAt(0)->getExpr();
+    EXPECT_FALSE(sum->getLeft()->isLastUse());
+    EXPECT_FALSE(sum->getRight()->isLastUse());
+
+    // c is read by g, which may run at any time
+    auto g_body = body->getStatementAt(1)->getExpr()->getBody();
+    EXPECT_FALSE(g_body->getStatementAt(0)->getExpr()->isLastUse());
+
+    // if (d) { return b; }
+    auto early_if = body->getStatementAt(2)->getExpr();
+    EXPECT_FALSE(early_if->getCondition()->isLastUse());
+    EXPECT_TRUE(early_if->getConsequence()->getStatementAt(0)->getExpr()->isLastUse());
+
+    // let a = push(a, d); a
+    auto push_call = body->getStatementAt(3)->getExpr();
+    EXPECT_TRUE(push_call->getArgAt(0)->isLastUse());
+    EXPECT_TRUE(push_call->getArgAt(1)->isLastUse());
+    EXPECT_TRUE(body->getStatementAt(4)->getExpr()->isLastUse());
+
+    // Top level names are never moved
+    Lexer top_lexer("let a = [1]; a");
+    Parser top_parser(top_lexer);
+    EXPECT_FALSE(top_parser.parseProgram()->getStatementAt(1)->getExpr()->isLastUse());
+}
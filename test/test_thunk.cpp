@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include "../src/parser.h"
+#include "../src/evaluator.h"
+#include "../src/thunk.h"
+
+static Value runThunk(const std::string& input) {
+    EnvPtr env = makeRef<Env>();
+    Lexer lexer(input);
+    Parser parser(lexer);
+
+    return thunk::eval(parser.parseProgram(), env);
+}
+
+static Value runTreeWalker(const std::string& input) {
+    EnvPtr env = makeRef<Env>();
+    Lexer lexer(input);
+    Parser parser(lexer);
+
+    return evaluator::eval(parser.parseProgram(), env);
+}
+
+TEST(ThunkTest, TestSameResultsAsEvaluator) {
+    const std::vector<std::string> tests = {
+        "", "5", "-99", "5 + 5 + 3 + 5 - 10", "(5 + 10 * 2 + 15 / 3) * 2 + -10", "20 + 2 * -10.25",
+        "\"How are\" + \" you?\"", "(11 < 55) == true", "11.0 != 11.2", "!!7",
+        "if (true) { 1 }", "if (3 > 5) { 10 } else { 30 }", "if (false) { 10 }", "if (true) { }", "if (zz) { 1 }",
+        "return 88; 2;", "5; return 7 * 7; 3;", "if (9 > 3) { if (8 > 2) { return 10; } return 2; }",
+        "-true", "5; true + false; 5", "if (10 > 1) { if (10 > 1) { return true + false; } return 1; }",
+        "some_var", "-some_var", "some_var + 1", "1 + some_var", "\"first str\" - \"second str\"", "1 / 0", "(-2147483647 - 1) / -1",
+        "let x = 12; let y = x; let z = x + y + 1; z;", "let x = 5", "let x = zz; 1", "let x = 5; let x = x + 1; x",
+        "func(a) { a + 21; };", "let echo = func(x) { x; }; echo(7);", "func() { }()", "func() { let a = 1; }()",
+        "let add = func(a, b) { a + b; }; add(5 + 4, add(1, 2));",
+        "let fib = func(n) { if (n < 2) { n } else { fib(n-1) + fib(n-2) } }; fib(15)",
+        "let callTwice = func(x, f) { f(f(x)) }; let addTwo = func(x) { return x + 2 }; callTwice(1, addTwo)",
+        "let newAdder = func(x) { func(y) { x + y }; }; let addTwo = newAdder(2); addTwo(2);",
+        "let f = func(a) { let g = func(b) { func(c) { a + b + c } }; g(2) }; f(1)(3)",
+        "let foo = func(x) { return 2*x; }; foo();", "let foo = func(x) { return 2*x; }; foo(4, 5);",
+        "let f = func(a, b) { a }; f(1, zz)", "let f = func(a, b) { a }; f(zz, 1)", "zz(1)", "5(1)",
+        "let f = func(x) { x + nope }; f(1) + 2",
+        "let loop = func(n, acc) { if (n == 0) { acc } else { loop(n - 1, acc + n) } }; loop(100, 0)",
+        "let loop = func(n) { if (n == 0) { return zz; } loop(n - 1) }; loop(5)",
+        "let loop = func(n) { if (n == 0) { 0 } else { loop(n - 1, 1) } }; loop(5)",
+        "[1, 2*3, 4.25+0.25, false, \"a some_str\"]", "[]", "[1, zz, 3]", "[zz, 3]",
+        "[12, 7, -5][2]", "[1, 2, 5][3]", "zz[1]", "[1][zz]", "let arr = [1, [2, 3, 4], 5]; arr[1][2]", "\"hello\"[2]",
+        "let str = \"two\"; {\"one\": 10 - 9, str: 1+1, \"thr\" + \"ee\": 9/3, 4: 4, true: 5, false: 6}",
+        "{\"foo\": 5}[\"foo\"]", "{}", "{zz: 1}", "{1: zz}", "{[1]: 2}", "{\"key\": \"hello\"}[func(x){ x+1 }]",
+        "len(\"test\")", "len([])", "let a = [2*2, \"hello\", true, [4, 5]]; push(a, 9)", "len(4)", "len",
+        "let build = func(arr, n) { if (n == 0) { arr } else { build(push(arr, n), n - 1) } }; build([], 40)",
+        "let f = func(x) { let y = push(x, 2); [x, y] }; f([1])",
+        "[1, 2, 3] * [2, 0.5, 1] - 1", "[\"a\"] + \"b\"", "[1, 2] / [1, 0]",
+        "let s = func() { \"abc\" }; s() + s()", "let f = func(x) { let y = x; let z = y; z + x }; f(3)",
+        "let a = 1; let f = func() { a + b }; let b = 2; f()", "let f = func(x) { if (x) { return 1; } 2 }; [f(true), f(false)]"
+    };
+
+    for (const auto& test : tests) {
+        auto expected = runTreeWalker(test);
+        auto obj = runThunk(test);
+
+        if (!expected) {
+            EXPECT_TRUE(obj == nullptr) << test;
+            continue;
+        }
+
+        ASSERT_TRUE(obj != nullptr) << test;
+        EXPECT_EQ(obj->inspect(), expected->inspect()) << test;
+        EXPECT_EQ(obj->typeString(), expected->typeString()) << test;
+    }
+}
+
+TEST(ThunkTest, TestCompileOnce) {
+    Lexer lexer("let add = func(a, b) { a + b }; add(add(1, 2), len(\"x\"))");
+    Parser parser(lexer);
+    auto program = parser.parseProgram();
+    const Thunk* code = thunk::compile(program);
+
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(thunk::run(code, makeRef<Env>())->inspect(), "4");
+}
+
+TEST(ThunkTest, TestFunctionsAcrossEngines) {
+    EnvPtr env = makeRef<Env>();
+
+    for (const auto& [input, use_thunks, expected] : std::vector<std::tuple<std::string, bool, std::string>>{
+        {"let twice = func(f, x) { f(f(x)) }", true, "nil"},
+        {"let inc = func(x) { x + 1 }", false, "nil"},
+        {"twice(inc, 1)", true, "3"},
+        {"twice(inc, 5)", false, "7"},
+        {"let loop = func(n) { if (n == 0) { 0 } else { loop(n - 1) } }; loop(100000)", true, "0"}
+    }) {
+        Lexer lexer(input);
+        Parser parser(lexer);
+        auto program = parser.parseProgram();
+
+        auto obj = use_thunks ? thunk::eval(program, env) : evaluator::eval(program, env);
+        EXPECT_EQ(obj->inspect(), expected) << input;
+    }
+}
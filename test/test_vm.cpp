@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+
+#include "../src/parser.h"
+#include "../src/evaluator.h"
+#include "../src/vm.h"
+
+template <typename T>
+struct VMTest {
+    std::string input;
+    T expected;
+};
+
+Value runVM(const std::string& input) {
+    Lexer lexer(input);
+    Parser parser(lexer);
+    Compiler compiler;
+
+    EXPECT_TRUE(compiler.compile(parser.parseProgram()));
+
+    VM vm;
+    return vm.run(compiler.bytecode());
+}
+
+Value runEval(const std::string& input) {
+    EnvPtr env = makeRef<Env>();
+    Lexer lexer(input);
+    Parser parser(lexer);
+
+    return evaluator::eval(parser.parseProgram(), env);
+}
+
+TEST(CodeTest, TestMake) {
+    EXPECT_EQ(code::make(OP_CONSTANT, {65534}), Instructions({OP_CONSTANT, 255, 254}));
+    EXPECT_EQ(code::make(OP_ADD), Instructions({OP_ADD}));
+    EXPECT_EQ(code::make(OP_GET_LOCAL, {255}), Instructions({OP_GET_LOCAL, 255}));
+    EXPECT_EQ(code::make(OP_CLOSURE, {65534, 255}), Instructions({OP_CLOSURE, 255, 254, 255}));
+}
+
+TEST(CodeTest, TestInstructionsString) {
+    Instructions ins;
+    for (const auto& part : {code::make(OP_ADD), code::make(OP_GET_LOCAL, {1}), code::make(OP_CONSTANT, {2}), code::make(OP_CLOSURE, {65535, 255})})
+        ins.insert(ins.end(), part.begin(), part.end());
+
+    EXPECT_EQ(code::toString(ins), "0 OP_ADD\n1 OP_GET_LOCAL 1\n3 OP_CONSTANT 2\n6 OP_CLOSURE 65535 255\n");
+}
+
+TEST(CompilerTest, TestGlobalLetStatements) {
+    Lexer lexer("let one = 1; let two = one; two");
+    Parser parser(lexer);
+    Compiler compiler;
+
+    EXPECT_TRUE(compiler.compile(parser.parseProgram()));
+    EXPECT_EQ(code::toString(compiler.bytecode().instructions),
+        "0 OP_CONSTANT 0\n"
+        "3 OP_SET_GLOBAL 0\n"
+        "6 OP_GET_GLOBAL 0\n"
+        "9 OP_SET_GLOBAL 1\n"
+        "12 OP_GET_GLOBAL 1\n"
+        "15 OP_POP\n");
+}
+
+TEST(CompilerTest, TestClosures) {
+    Lexer lexer("func(a) { func(b) { a + b } }");
+    Parser parser(lexer);
+    Compiler compiler;
+
+    EXPECT_TRUE(compiler.compile(parser.parseProgram()));
+
+    const auto constants = compiler.bytecode().constants;
+    EXPECT_EQ(constants.size(), 2);
+    EXPECT_EQ(code::toString(constants[0].as<CompiledFunction>()->instructions),
+        "0 OP_GET_FREE 0\n"
+        "2 OP_GET_LOCAL 0\n"
+        "4 OP_ADD\n"
+        "5 OP_RETURN_VALUE\n");
+    EXPECT_EQ(code::toString(constants[1].as<CompiledFunction>()->instructions),
+        "0 OP_GET_LOCAL 0\n"
+        "2 OP_CLOSURE 0 1\n"
+        "6 OP_RETURN_VALUE\n");
+}
+
+// Identifiers can't have digits, so n is written in letters
+static std::string letterName(size_t n) {
+    std::string name = "v";
+
+    for (; n > 0; n /= 26)
+        name += static_cast<char>('a' + n % 26);
+
+    return name;
+}
+
+TEST(CompilerTest, TestOperandsOutOfRange) {
+    std::string long_body = "if (true) { ";
+    for (int i = 0; i < 33000; i++)
+        long_body += "true; ";
+    long_body += "}";
+
+    std::string many_globals;
+    for (size_t i = 0; i <= 0x10000; i++)
+        many_globals += "let " + letterName(i) + " = true; ";
+
+    for (const auto& input : {long_body, many_globals}) {
+        Lexer lexer(input);
+        Parser parser(lexer);
+        Compiler compiler;
+
+        EXPECT_FALSE(compiler.compile(parser.parseProgram()));
+        ASSERT_FALSE(compiler.errors().empty());
+        EXPECT_NE(compiler.errors().front().find("out of range"), std::string::npos) << compiler.errors().front();
+    }
+}
+
+// Every program here must give the same result with the VM as with the
+// tree-walking evaluator.
+TEST(VMTest, TestSameResultsAsEvaluator) {
+    const std::vector<std::string> tests = {
+        "5", "-99", "5 + 5 + 3 + 5 - 10", "2 * 2 * 2 * 2 * 2", "50 / 2 * 2 + 10",
+        "(5 + 10 * 2 + 15 / 3) * 2 + -10",
+        "17.11", "5 + 5.25 + 3 + 5 - 10", "-50 + 100 + -49.5", "20 + 2 * -10.25", "50.0 / 2.0 * 2 + 10.11",
+        "\"Some string blaa\"", "\"How are\" + \" you?\"",
+        "true", "false", "0 < 2", "2 > 4", "1 == 1", "5 != 5", "true == false", "true != false",
+        "(11 < 55) == true", "(5 > 2) == true", "4.52 == 4.52", "11.5 > 4", "11.0 != 11.2",
+        "!false", "!2", "!!true", "!!!true", "!!7",
+        "if (true) { 1 }", "if (25) { 2 }", "if (3 > 5) { 10 } else { 30 }", "if (false) { 10 }", "if (1 > 2) { 10 }",
+        "if (true) { }", "if (true) { let x = 2; }",
+        "return 1;", "return 88; 2;", "5; return 7 * 7; 3;",
+        "if (9 > 3) { if (8 > 2) { return 10; } return 2; }",
+        "if (3 > 54) { if (8 > 2) { return 10; }} else {return 2; }",
+        "-true", "true + false;", "5; true + false; 5", "if (10 > 1) { true + false; }",
+        "if (10 > 1) { if (10 > 1) { return true + false; } return 1; }",
+        "some_var", "\"first str\" - \"second str\"", "1 / 0", "(-2147483647 - 1) / -1", "{\"key\": \"hello\"}[func(x){ x+1 }]",
+        "let x = 4; x;", "let x = 2*3; x;", "let foo = 3;  let bar = foo; bar;",
+        "let x = 12; let y = x; let z = x + y + 1; z;", "let x = 5", "let x = 5; let x = x + 1; x",
+        "func(a) { a + 21; };",
+        "let test = func() { return -12; }; test();", "let echo = func(x) { x; }; echo(7);",
+        "let twice = func(x) { return x*2; }; twice(7);", "let add = func(a, b) { a + b; }; add(5 + 4, add(1, 2));",
+        "func(x) { x; }(8);", "func() { }()", "func() { let a = 1; }()",
+        "let a = func(x) { x*x; }; let b = func(x) { if (x > 10) { return 1; } else {  return 0; } }; b(a(3));",
+        "let fac = func(n) { if (n==0) { return 1; } else { return n*fac(n-1) } }; fac(5)",
+        "let fib = func(n) { if (n==0) { 0 } else { if (n==1) { 1 } else { fib(n-1)+fib(n-2) } } }; fib(7)",
+        "let callTwice = func(x, f) { f(f(x)) }; let addTwo = func(x) { return x + 2 }; callTwice(1, addTwo)",
+        "let f = func() { g() }; let g = func() { 3 }; f()",
+        "let f = func(x) { let y = x * 2; let z = y + 1; z }; f(4)",
+        "let foo = func(x) { return 2*x; }; foo();", "let foo = func(x) { return 2*x; }; foo(4, 5);",
+        "let f = func(a, b) { a }; f(1, zz)", "5(1)", "let f = func(x) { x + nope }; f(1) + 2",
+        "[1, 2*3, 4.25+0.25, false, \"a some_str\"]", "[]", "[1, zz, 3]", "[zz, 3]",
+        "[12, 7, -5][2]", "let i = 0; [6, 3][i]", "let arr = [1, [2, 3, 4], 5]; arr[1][2]",
+        "[1, 2, 5][3]", "[1, 2, 5][-1]", "\"hello\"[2]", "let str = \"just test\" let i = 1; str[i]", "\"ok\"[3]",
+        "let str = \"two\"; {\"one\": 10 - 9, str: 1+1, \"thr\" + \"ee\": 9/3, 4: 4, true: 5, false: 6}",
+        "{\"foo\": 5}[\"foo\"]", "{42: 5}[42]", "{true: 5}[true]", "{2: true, \"str\": false}[\"hi\"]", "{}",
+        "len(\"test\")", "let arr = [1, 3, true, 5]; len(arr)", "len([])", "first([3, 5, 9])", "last([3, 5, 9])",
+        "let a = [2*2, \"hello\", true, [4, 5]]; let b = push(a, 9); b", "type(func() { return 1; })",
+        "type([25, 1.2, \"hi\"])", "print(5.4, \" \", false, \" \", [1, 2])", "print(len([1, 2, 3, 4]))",
+        "len(4)", "len(\"first\", \"second\")", "first(15+2)", "push(5.2, a)", "push([1, 2, true], 2, 4)",
+        "print(func() { return 1; })", "len", "sum([1, 2.5, 3])", "max([4, 9, 2])", "dot([1, 2], [3, 4])",
+        "mean([\"a\"])", "[1, 2, 3] * [2, 0.5, 1] - 1", "[1, 5] > 2", "[1] + [1, 2]"
+    };
+
+    for (const auto& test : tests) {
+        auto expected = runEval(test);
+        auto obj = runVM(test);
+
+        ASSERT_TRUE(obj != nullptr) << test;
+        EXPECT_EQ(obj->inspect(), expected->inspect()) << test;
+        EXPECT_EQ(obj->typeString(), expected->typeString()) << test;
+    }
+}
+
+TEST(VMTest, TestClosures) {
+    const std::vector<VMTest<int>> tests = {
+        {"let newAdder = func(x) { func(y) { x + y }; }; let addTwo = newAdder(2); addTwo(2);", 4},
+        {"let newAdder = func(a, b) { let c = a + b; func(d) { c + d } }; newAdder(1, 2)(8);", 11},
+        {"let f = func(a) { let g = func(b) { func(c) { a + b + c } }; g(2) }; f(1)(3)", 6},
+        {"let f = func() { let count = func(n) { if (n == 0) { 0 } else { 1 + count(n - 1) } }; count(5) }; f()", 5}
+    };
+
+    for (const auto& test : tests) {
+        auto obj = runVM(test.input);
+
+        EXPECT_EQ(obj->getIntVal(), test.expected) << test.input;
+        EXPECT_EQ(obj->getType(), OBJ_INT) << test.input;
+    }
+}
+
+TEST(VMTest, TestGlobalsAcrossRuns) {
+    Compiler compiler;
+    VM vm;
+
+    for (const auto& [input, expected] : std::vector<std::pair<std::string, std::string>>{
+        {"let a = 5", "nil"},
+        {"let f = func(x) { x * a }", "nil"},
+        {"f(3)", "15"},
+        {"let a = 2; f(3)", "6"},
+        {"b", "Error: identifier not found: b"}
+    }) {
+        Lexer lexer(input);
+        Parser parser(lexer);
+
+        EXPECT_TRUE(compiler.compile(parser.parseProgram()));
+        EXPECT_EQ(vm.run(compiler.bytecode())->inspect(), expected) << input;
+    }
+}
+
+TEST(VMTest, TestStackOverflow) {
+    auto obj = runVM("let f = func(n) { f(n + 1) }; f(0)");
+
+    EXPECT_EQ(obj->getType(), OBJ_ERROR);
+    EXPECT_EQ(obj->inspect(), "Error: stack overflow");
+}